@@ -8,6 +8,7 @@
 #include "../program/setup.h"
 #include "../program/playutils.h"
 #include "../program/play.h"
+#include "../vcfsolver/VCFsolver.h"
 #include "../command/commandline.h"
 #include "../main.h"
 
@@ -41,16 +42,287 @@ struct AnalyzeRequest {
 
   //Starts with STATUS_IN_QUEUE.
   //Thread that grabs it from queue it changes it to STATUS_POPPED
-  //Once search is fully started thread sticks in its own thread index
+  //Once search is fully started thread sticks in its own thread index, tiny request threads after the analysis threads
   //At any point it may change to STATUS_TERMINATED.
   //If it ever gets to STATUS_POPPED or later, then the analysis thread is reponsible for writing the result, else the api thread is
   static constexpr int STATUS_IN_QUEUE = -1;
   static constexpr int STATUS_POPPED = -2;
   static constexpr int STATUS_TERMINATED = -3;
   std::atomic<int> status;
+
+  //Only with the result cache. Everything the result depends on, see getResultCacheKey,
+  //and the identical requests waiting for this one to be analyzed, mutexed by the cache's mutex.
+  string resultCacheKey;
+  vector<AnalyzeRequest*> followers;
+};
+
+//A search tree can be continued with different limits on the search, but nothing else may differ
+static SearchParams withoutSearchBudget(SearchParams params) {
+  params.maxVisits = 0;
+  params.maxPlayouts = 0;
+  params.maxTime = 0;
+  return params;
+}
+
+//Everything the search tree of a request depends on, which is all of the result cache key except the search budget
+static string getTreeCacheKey(const AnalyzeRequest* request) {
+  const BoardHistory& hist = request->hist;
+  ostringstream out;
+  out.precision(17);
+  out << hist.initialBoard.x_size << " " << hist.initialBoard.y_size << " " << hist.initialBoard.pos_hash << " " << (int)hist.initialPla;
+  for(const Move& move: hist.moveHistory)
+    out << " " << move.loc << (int)move.pla;
+  out << " " << request->board.pos_hash << " " << (int)request->nextPla;
+  out << " " << hist.rules.toJsonString();
+  out << " " << withoutSearchBudget(request->params).changeableParametersToJson().dump();
+  out << " b";
+  for(size_t i = 0; i<request->avoidMoveUntilByLocBlack.size(); i++)
+    if(request->avoidMoveUntilByLocBlack[i] != 0)
+      out << " " << i << ":" << request->avoidMoveUntilByLocBlack[i];
+  out << " w";
+  for(size_t i = 0; i<request->avoidMoveUntilByLocWhite.size(); i++)
+    if(request->avoidMoveUntilByLocWhite[i] != 0)
+      out << " " << i << ":" << request->avoidMoveUntilByLocWhite[i];
+  return out.str();
+}
+
+static string getResultCacheKey(const AnalyzeRequest* request) {
+  ostringstream out;
+  out.precision(17);
+  out << getTreeCacheKey(request);
+  out << " " << request->params.maxVisits << " " << request->params.maxPlayouts << " " << request->params.maxTime;
+  out << " " << (int)request->perspective << " " << request->analysisPVLen << " " << request->includePolicy << request->includePVVisits;
+  return out.str();
+}
+
+//Final results of completed analyses, dropping the least recently used ones past the capacity, and the request being analyzed
+//for each key, so that identical requests coming in meanwhile wait for its result instead of searching again.
+//Everything here is mutexed by mutex.
+struct AnalysisResultCache {
+  struct Entry {
+    SearchParams params;
+    json result;
+    std::list<string>::iterator lruPos;
+  };
+
+  std::mutex mutex;
+  const size_t capacity;
+  std::list<string> lru; //Most recently used first
+  std::map<string,Entry> entries;
+  std::map<string,AnalyzeRequest*> running;
+
+  int64_t numHits;
+  int64_t numCoalesced;
+  int64_t numMisses;
+
+  AnalysisResultCache(size_t cap)
+    :mutex(),capacity(cap),lru(),entries(),running(),numHits(0),numCoalesced(0),numMisses(0)
+  {}
+
+  //The key already includes the parameters that can be overridden per query, they are compared too just to be safe
+  bool get(const string& key, const SearchParams& params, json& result) {
+    auto it = entries.find(key);
+    if(it == entries.end() || !(it->second.params == params))
+      return false;
+    lru.splice(lru.begin(), lru, it->second.lruPos);
+    result = it->second.result;
+    return true;
+  }
+
+  void put(const string& key, const SearchParams& params, const json& result) {
+    auto it = entries.find(key);
+    if(it != entries.end()) {
+      lru.splice(lru.begin(), lru, it->second.lruPos);
+      it->second.params = params;
+      it->second.result = result;
+      return;
+    }
+    lru.push_front(key);
+    Entry& entry = entries[key];
+    entry.params = params;
+    entry.result = result;
+    entry.lruPos = lru.begin();
+    while(entries.size() > capacity) {
+      entries.erase(lru.back());
+      lru.pop_back();
+    }
+  }
+
+  void clear() {
+    lru.clear();
+    entries.clear();
+  }
+
+  json getStats() const {
+    json ret;
+    ret["capacity"] = capacity;
+    ret["size"] = entries.size();
+    ret["running"] = running.size();
+    ret["hits"] = numHits;
+    ret["coalesced"] = numCoalesced;
+    ret["misses"] = numMisses;
+    return ret;
+  }
 };
 
 
+//Search trees of recent analyses, so that a request for the same position and parameters with a larger visit budget,
+//such as the next step of a progressively deepening analysis, continues from the earlier tree instead of searching from scratch.
+//Trees are dropped least recently used first once there are more than capacity of them or they take more than maxBytes in total.
+//Dropped trees are cleared by the caller and kept as spares, to be swapped into the bots in place of the trees that get stored.
+//Everything here is mutexed by mutex.
+struct AnalysisTreeCache {
+  struct Entry {
+    SearchParams params; //See withoutSearchBudget
+    Search* search;
+    double bytes;
+    std::list<string>::iterator lruPos;
+  };
+
+  std::mutex mutex;
+  const size_t capacity;
+  const double maxBytes;
+  const size_t maxSpares;
+  std::list<string> lru; //Most recently used first
+  std::map<string,Entry> entries;
+  double totalBytes;
+  vector<Search*> spares;
+
+  int64_t numHits;
+  int64_t numMisses;
+  int64_t numEvicted;
+
+  AnalysisTreeCache(size_t cap, double maxB, size_t maxS)
+    :mutex(),capacity(cap),maxBytes(maxB),maxSpares(maxS),lru(),entries(),totalBytes(0.0),spares(),
+     numHits(0),numMisses(0),numEvicted(0)
+  {}
+  ~AnalysisTreeCache() {
+    for(auto& it: entries)
+      delete it.second.search;
+    for(Search* search: spares)
+      delete search;
+  }
+
+  //Remove and return the tree for key if there is one that hasn't already searched past the visit budget of params, else NULL
+  Search* take(const string& key, const SearchParams& params) {
+    auto it = entries.find(key);
+    if(it == entries.end() || !(it->second.params == withoutSearchBudget(params)) || it->second.search->getRootVisits() > params.maxVisits) {
+      numMisses++;
+      return NULL;
+    }
+    numHits++;
+    Search* search = it->second.search;
+    totalBytes -= it->second.bytes;
+    lru.erase(it->second.lruPos);
+    entries.erase(it);
+    return search;
+  }
+
+  //Store the tree of a finished search, replacing any other tree for key. Trees that no longer fit are appended to evicted.
+  void put(const string& key, const SearchParams& params, Search* search, vector<Search*>& evicted) {
+    auto it = entries.find(key);
+    if(it != entries.end()) {
+      evicted.push_back(it->second.search);
+      totalBytes -= it->second.bytes;
+      lru.erase(it->second.lruPos);
+      entries.erase(it);
+    }
+    lru.push_front(key);
+    Entry& entry = entries[key];
+    entry.params = withoutSearchBudget(params);
+    entry.search = search;
+    entry.bytes = search->getApproxTreeBytes() + search->getApproxFixedBytes();
+    entry.lruPos = lru.begin();
+    totalBytes += entry.bytes;
+    while(entries.size() > capacity || (totalBytes > maxBytes && entries.size() > 0)) {
+      auto lastIt = entries.find(lru.back());
+      evicted.push_back(lastIt->second.search);
+      totalBytes -= lastIt->second.bytes;
+      entries.erase(lastIt);
+      lru.pop_back();
+      numEvicted++;
+    }
+  }
+
+  void clear(vector<Search*>& evicted) {
+    for(auto& it: entries)
+      evicted.push_back(it.second.search);
+    lru.clear();
+    entries.clear();
+    totalBytes = 0.0;
+  }
+
+  //Returns a cleared search to use, or NULL if there is none
+  Search* takeSpare() {
+    if(spares.size() <= 0)
+      return NULL;
+    Search* search = spares.back();
+    spares.pop_back();
+    return search;
+  }
+
+  //Keep a cleared search for later use. Returns false if there are enough of them already, then the caller should delete it.
+  bool addSpare(Search* search) {
+    if(spares.size() >= maxSpares)
+      return false;
+    spares.push_back(search);
+    return true;
+  }
+
+  json getStats() const {
+    json ret;
+    ret["capacity"] = capacity;
+    ret["maxBytes"] = maxBytes;
+    ret["size"] = entries.size();
+    ret["bytes"] = totalBytes;
+    ret["hits"] = numHits;
+    ret["misses"] = numMisses;
+    ret["evicted"] = numEvicted;
+    return ret;
+  }
+};
+
+//Limits how many tiny requests, see analysisTinyRequestMaxVisits, are evaluated at once. The limit is adjusted over time so that
+//they fill the neural net batches without taking over the evaluator from the regular searches.
+//Everything here is mutexed by mutex.
+struct TinyRequestGate {
+  std::mutex mutex;
+  std::condition_variable slotFreed;
+  std::condition_variable shutdownSignaled;
+  const int maxLimit;
+  int limit;
+  int numActive;
+  bool shuttingDown;
+
+  TinyRequestGate(int initialLimit, int maxL)
+    :mutex(),slotFreed(),shutdownSignaled(),maxLimit(maxL),limit(std::min(initialLimit,maxL)),numActive(0),shuttingDown(false)
+  {}
+
+  void acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while(numActive >= limit)
+      slotFreed.wait(lock);
+    numActive++;
+  }
+  void release() {
+    std::lock_guard<std::mutex> lock(mutex);
+    numActive--;
+    slotFreed.notify_one();
+  }
+
+  //Called periodically with the average size of the batches recently processed by the evaluator. Returns the new limit.
+  //Evaluates more at once while batches are underfilled and tiny requests are waiting, and fewer once the batches are full.
+  int adjustLimit(double recentBatchSize, int targetBatchSize, bool hasBacklog) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(hasBacklog && recentBatchSize < 0.9 * targetBatchSize)
+      limit = std::min(maxLimit, limit + std::max(1, limit / 2));
+    else if(recentBatchSize >= targetBatchSize)
+      limit = std::max(1, limit - std::max(1, limit / 8));
+    slotFreed.notify_all();
+    return limit;
+  }
+};
+
 int MainCmds::analysis(const vector<string>& args) {
   Board::initHash();
   //ScoreValue::initTables();
@@ -141,6 +413,18 @@ int MainCmds::analysis(const vector<string>& args) {
   }
 
   const int analysisPVLen = cfg.contains("analysisPVLen") ? cfg.getInt("analysisPVLen",1,100) : 15;
+  //Number of final results kept to answer identical requests with, 0 to search every request
+  const int analysisResultCacheSize = cfg.contains("analysisResultCacheSize") ? cfg.getInt("analysisResultCacheSize",0,1000000) : 0;
+  std::unique_ptr<AnalysisResultCache> resultCache = nullptr;
+  if(analysisResultCacheSize > 0)
+    resultCache = std::make_unique<AnalysisResultCache>(analysisResultCacheSize);
+  //Number of search trees kept to continue from when a position is analyzed again with a larger budget, 0 to always search from scratch
+  const int analysisTreeCacheSize = cfg.contains("analysisTreeCacheSize") ? cfg.getInt("analysisTreeCacheSize",0,1000) : 0;
+  const double analysisTreeCacheMaxBytes =
+    cfg.contains("analysisTreeCacheMaxBytes") ? cfg.getDouble("analysisTreeCacheMaxBytes",1.0e6,1.0e20) : 2.0e9;
+  std::unique_ptr<AnalysisTreeCache> treeCache = nullptr;
+  if(analysisTreeCacheSize > 0)
+    treeCache = std::make_unique<AnalysisTreeCache>(analysisTreeCacheSize, analysisTreeCacheMaxBytes, numAnalysisThreads);
   //const bool assumeMultipleStartingBlackMovesAreHandicap =
   //  cfg.contains("assumeMultipleStartingBlackMovesAreHandicap") ? cfg.getBool("assumeMultipleStartingBlackMovesAreHandicap") : true;
   //const bool preventEncore = cfg.contains("preventCleanupPhase") ? cfg.getBool("preventCleanupPhase") : true;
@@ -192,6 +476,16 @@ int MainCmds::analysis(const vector<string>& args) {
   }
 #endif
 
+  //Requests with at most this many visits and no reports during the search skip the analysis threads. They are searched by a separate
+  //pool of threads instead, each running a whole search inline on one thread. Many of them can then be evaluated at once, which keeps
+  //the neural net batches full, such as when reviewing every turn of a game with 1 visit each. 0 to disable.
+  const int64_t analysisTinyRequestMaxVisits =
+    cfg.contains("analysisTinyRequestMaxVisits") ? cfg.getInt64("analysisTinyRequestMaxVisits",0,(int64_t)1 << 20) : 0;
+  //Maximum number of tiny requests evaluated at once. Each has its own Search, so the default is only enough to fill the batches.
+  const int analysisTinyRequestThreads =
+    cfg.contains("analysisTinyRequestThreads") ? cfg.getInt("analysisTinyRequestThreads",1,16384) :
+    std::min(1024, nnEval->getMaxBatchSize() * nnEval->getNumGpus());
+
   //Check for unused config keys
   cfg.warnUnusedKeys(cerr,&logger);
   Setup::maybeWarnHumanSLParams(defaultParams,nnEval,humanEval,cerr,&logger);
@@ -261,6 +555,16 @@ int MainCmds::analysis(const vector<string>& args) {
   };
 
   ThreadSafePriorityQueue<std::pair<int64_t,int64_t>, AnalyzeRequest*> toAnalyzeQueue;
+  ThreadSafePriorityQueue<std::pair<int64_t,int64_t>, AnalyzeRequest*> toAnalyzeTinyQueue;
+  auto isTinyRequest = [&analysisTinyRequestMaxVisits](const AnalyzeRequest* request) {
+    return request->params.maxVisits <= analysisTinyRequestMaxVisits && !request->reportDuringSearch;
+  };
+  //Compare first by user-provided priority, and next breaks ties by preferring earlier requests.
+  auto pushToAnalyze = [&toAnalyzeQueue,&toAnalyzeTinyQueue,&isTinyRequest](AnalyzeRequest* request, std::pair<int64_t,int64_t> priorityKey) {
+    if(isTinyRequest(request))
+      return toAnalyzeTinyQueue.forcePush(std::make_pair(priorityKey, request));
+    return toAnalyzeQueue.forcePush(std::make_pair(priorityKey, request));
+  };
   int64_t numRequestsSoFar = 0; // Used as tie breaker for requests with same priority
   int64_t internalIdCounter = 0; // Counter for internalId on requests.
 
@@ -306,7 +610,8 @@ int MainCmds::analysis(const vector<string>& args) {
   };
 
   //Returns false if no analysis was reportable due to there being no root node or search results.
-  auto reportAnalysis = [&pushToWrite](const AnalyzeRequest* request, const Search* search, bool isDuringSearch) {
+  //If resultBuf is not NULL, the reported json is also stored there.
+  auto reportAnalysis = [&pushToWrite](const AnalyzeRequest* request, const Search* search, bool isDuringSearch, json* resultBuf) {
     json ret;
     ret["id"] = request->id;
     ret["turnNumber"] = request->turnNumber;
@@ -320,20 +625,140 @@ int MainCmds::analysis(const vector<string>& args) {
       ret
     );
 
-    if(success)
+    if(success) {
       pushToWrite(new string(ret.dump()));
+      if(resultBuf != NULL)
+        *resultBuf = ret;
+    }
     return success;
   };
 
+  //Report the final result of an identical request for this one
+  auto reportCachedAnalysis = [&pushToWrite](const AnalyzeRequest* request, const json& result) {
+    json ret = result;
+    ret["id"] = request->id;
+    ret["turnNumber"] = request->turnNumber;
+    ret["isDuringSearch"] = false;
+    pushToWrite(new string(ret.dump()));
+  };
+
+  //This request is no longer open
+  auto closeRequest = [&openRequestsMutex,&openRequests](AnalyzeRequest* request) {
+    {
+      std::lock_guard<std::mutex> lock(openRequestsMutex);
+      openRequests.erase(request->internalId);
+    }
+    delete request;
+  };
+
+  //Called once a request from the result cache is done, with its full result if it has one.
+  //Hands the result to the requests waiting for it, or if there is none, queues the first of them in its place.
+  auto finishCachedRequest = [&resultCache,&pushToAnalyze,&reportCachedAnalysis,&reportNoAnalysis,&closeRequest](
+    AnalyzeRequest* request, bool hasResult, const json& result
+  ) {
+    vector<AnalyzeRequest*> followers;
+    AnalyzeRequest* newLeader = NULL;
+    {
+      std::lock_guard<std::mutex> lock(resultCache->mutex);
+      const string& key = request->resultCacheKey;
+      auto it = resultCache->running.find(key);
+      bool isLeader = it != resultCache->running.end() && it->second == request;
+      if(isLeader)
+        resultCache->running.erase(it);
+      if(hasResult)
+        resultCache->put(key, request->params, result);
+      followers.swap(request->followers);
+      if(!hasResult && followers.size() > 0) {
+        newLeader = followers[0];
+        newLeader->followers.assign(followers.begin() + 1, followers.end());
+        followers.clear();
+        if(isLeader)
+          resultCache->running[key] = newLeader;
+      }
+    }
+
+    for(AnalyzeRequest* follower: followers) {
+      //If it was terminated in the meantime, the termination already reported it
+      int expected = AnalyzeRequest::STATUS_IN_QUEUE;
+      if(follower->status.compare_exchange_strong(expected, AnalyzeRequest::STATUS_POPPED, std::memory_order_acq_rel))
+        reportCachedAnalysis(follower, result);
+      closeRequest(follower);
+    }
+
+    if(newLeader != NULL) {
+      std::pair<int64_t,int64_t> priorityKey = std::make_pair(newLeader->priority, -newLeader->internalId);
+      bool suc = pushToAnalyze(newLeader, priorityKey);
+      //Only fails once we are shutting down
+      if(!suc) {
+        {
+          std::lock_guard<std::mutex> lock(resultCache->mutex);
+          auto it = resultCache->running.find(newLeader->resultCacheKey);
+          if(it != resultCache->running.end() && it->second == newLeader)
+            resultCache->running.erase(it);
+          followers.swap(newLeader->followers);
+        }
+        followers.push_back(newLeader);
+        for(AnalyzeRequest* follower: followers) {
+          int expected = AnalyzeRequest::STATUS_IN_QUEUE;
+          if(follower->status.compare_exchange_strong(expected, AnalyzeRequest::STATUS_POPPED, std::memory_order_acq_rel))
+            reportNoAnalysis(follower);
+          closeRequest(follower);
+        }
+      }
+    }
+  };
+
+  //Report the result of a finished search. Returns whether it is a complete result that the result cache can share, in which case
+  //it is stored in result if there is a result cache.
+  auto reportFinalAnalysis = [&logger,&reportAnalysis,&reportNoAnalysis,&resultCache](
+    const AnalyzeRequest* request, const Search* search, json& result
+  ) {
+    const bool isDuringSearch = false;
+    bool analysisWritten = reportAnalysis(request,search,isDuringSearch,resultCache != nullptr ? &result : NULL);
+    //If the search didn't have any root or root neural net output, it must have been interrupted and we must be quitting imminently
+    if(!analysisWritten) {
+      //If the reason we stopped was because we noticed a terminate, then we will write out a dummy response even if we didn't have
+      //enough info to generate a real one, to fulfill a promise in the API docs that we always write something.
+      if(request->status.load(std::memory_order_acquire) == AnalyzeRequest::STATUS_TERMINATED)
+        reportNoAnalysis(request);
+      //Otherwise, this case is only possible if we're just shutting down
+      else
+        logger.write("Note: Search quitting due to no visits - this is normal and possible when shutting down but a bug under any other situation.");
+    }
+    //A terminated search is only partial, so it isn't shared
+    return analysisWritten && request->status.load(std::memory_order_acquire) != AnalyzeRequest::STATUS_TERMINATED;
+  };
+
+  //Clear searches dropped from the tree cache and keep them as spares
+  auto releaseTrees = [&treeCache](const vector<Search*>& searches) {
+    for(Search* search: searches) {
+      search->clearSearch();
+      //Clearing runs on the search's thread pool, which idle spares don't need
+      search->releaseThreads();
+      bool kept;
+      {
+        std::lock_guard<std::mutex> lock(treeCache->mutex);
+        kept = treeCache->addSpare(search);
+      }
+      if(!kept)
+        delete search;
+    }
+  };
+
   auto analysisLoop = [
-    &logger,&toAnalyzeQueue,&reportAnalysis,&reportNoAnalysis,&logSearchInfo,&nnEval,&openRequestsMutex,&openRequests
-  ](AsyncBot* bot, int threadIdx) {
+    &logger,&toAnalyzeQueue,&reportAnalysis,&reportFinalAnalysis,&logSearchInfo,&nnEval,&resultCache,&finishCachedRequest,&closeRequest,
+    &treeCache,&releaseTrees,&defaultParams,&humanEval,&patternBonusTable
+  ](AsyncBot* bot, int threadIdx, const string& botRandSeed) {
+    int64_t numSearchesCreated = 0;
     while(true) {
       std::pair<std::pair<int64_t,int64_t>,AnalyzeRequest*> analysisItem;
       bool suc = toAnalyzeQueue.waitPop(analysisItem);
       if(!suc)
         break;
       AnalyzeRequest* request = analysisItem.second;
+      bool hasResult = false;
+      json result;
+      string treeCacheKey;
       int expected = AnalyzeRequest::STATUS_IN_QUEUE;
       //If it's already terminated, then there's nothing for us to do
       if(!request->status.compare_exchange_strong(expected, AnalyzeRequest::STATUS_POPPED, std::memory_order_acq_rel)) {
@@ -341,9 +766,22 @@ int MainCmds::analysis(const vector<string>& args) {
       }
       //Else, the request is live and we marked it as popped
       else {
-        bot->setPosition(request->nextPla,request->board,request->hist);
-        bot->setParams(request->params);
-        bot->setAvoidMoveUntilByLoc(request->avoidMoveUntilByLocBlack,request->avoidMoveUntilByLocWhite);
+        Search* cachedTree = NULL;
+        if(treeCache != nullptr) {
+          treeCacheKey = getTreeCacheKey(request);
+          std::lock_guard<std::mutex> lock(treeCache->mutex);
+          cachedTree = treeCache->take(treeCacheKey, request->params);
+        }
+        //Continue the earlier search, everything but the budget already matches
+        if(cachedTree != NULL) {
+          releaseTrees({bot->swapSearch(cachedTree)});
+          bot->setParamsNoClearing(request->params);
+        }
+        else {
+          bot->setPosition(request->nextPla,request->board,request->hist);
+          bot->setParams(request->params);
+          bot->setAvoidMoveUntilByLoc(request->avoidMoveUntilByLocBlack,request->avoidMoveUntilByLocWhite);
+        }
 
         Player pla = request->nextPla;
         double searchFactor = 1.0;
@@ -362,7 +800,7 @@ int MainCmds::analysis(const vector<string>& args) {
         if(request->reportDuringSearch) {
           std::function<void(const Search* search)> callback = [&request,&reportAnalysis](const Search* search) {
             const bool isDuringSearch = true;
-            reportAnalysis(request,search,isDuringSearch);
+            reportAnalysis(request,search,isDuringSearch,NULL);
           };
           bot->genMoveSynchronousAnalyze(
             pla, TimeControls(), searchFactor,
@@ -380,37 +818,148 @@ int MainCmds::analysis(const vector<string>& args) {
           logger.write(sout.str());
         }
 
+        hasResult = reportFinalAnalysis(request,bot->getSearch(),result);
+      }
+
+      //Keep the tree for a later request to continue, swapping in a cleared search for the bot
+      if(treeCache != nullptr && bot->getSearch()->getRootVisits() > 0) {
+        Search* spare;
+        {
+          std::lock_guard<std::mutex> lock(treeCache->mutex);
+          spare = treeCache->takeSpare();
+        }
+        if(spare == NULL) {
+          string searchRandSeed = botRandSeed + "-" + Global::int64ToString(numSearchesCreated++);
+          spare = new Search(defaultParams, nnEval, humanEval, &logger, searchRandSeed);
+          spare->setCopyOfExternalPatternBonusTable(patternBonusTable);
+        }
+        vector<Search*> evicted;
+        Search* finished = bot->swapSearch(spare);
+        //Parked trees may wait a long time to be continued, don't keep their threads meanwhile
+        finished->releaseThreads();
         {
-          const bool isDuringSearch = false;
-          const Search* search = bot->getSearch();
-          bool analysisWritten = reportAnalysis(request,search,isDuringSearch);
-          //If the search didn't have any root or root neural net output, it must have been interrupted and we must be quitting imminently
-          if(!analysisWritten) {
-            //If the reason we stopped was because we noticed a terminate, then we will write out a dummy response even if we didn't have
-            //enough info to generate a real one, to fulfill a promise in the API docs that we always write something.
-            if(request->status.load(std::memory_order_acquire) == AnalyzeRequest::STATUS_TERMINATED)
-              reportNoAnalysis(request);
-            //Otherwise, this case is only possible if we're just shutting down
-            else
-              logger.write("Note: Search quitting due to no visits - this is normal and possible when shutting down but a bug under any other situation.");
+          std::lock_guard<std::mutex> lock(treeCache->mutex);
+          treeCache->put(treeCacheKey, request->params, finished, evicted);
+        }
+        releaseTrees(evicted);
+      }
+      //Free up bot resources in case it's a while before we do more search
+      else {
+        bot->clearSearch();
+      }
+
+      if(resultCache != nullptr)
+        finishCachedRequest(request, hasResult, result);
+      closeRequest(request);
+    }
+  };
+  auto analysisLoopProtected = [&logger,&analysisLoop](AsyncBot* bot, int threadIdx, string botRandSeed) {
+    Logger::logThreadUncaught("analysis loop", &logger, [&](){ analysisLoop(bot, threadIdx, botRandSeed); });
+  };
+
+  //Tiny requests have no use for more than one search thread, or for the asynchronous control of an AsyncBot, since they are over
+  //right after the first few evaluations. Each thread here just reuses one Search for all of its requests.
+  TinyRequestGate tinyRequestGate(nnEval->getMaxBatchSize() * nnEval->getNumGpus(), analysisTinyRequestThreads);
+  //A tiny search only ever has a handful of nodes, so with many of them around, keep their tables small
+  auto getTinyRequestParams = [](const SearchParams& params) {
+    SearchParams ret = params;
+    ret.numThreads = 1;
+    ret.nodeTableShardsPowerOfTwo = std::min(ret.nodeTableShardsPowerOfTwo, 8);
+    ret.subtreeValueBiasTableNumShards = std::min(ret.subtreeValueBiasTableNumShards, (int32_t)256);
+    return ret;
+  };
+  //Set by a terminate to stop the search of the tiny request thread whose index is in the request's status
+  std::unique_ptr<std::atomic<bool>[]> tinyRequestShouldStop(new std::atomic<bool>[std::max(analysisTinyRequestThreads,1)]);
+  auto tinyRequestLoop = [
+    &logger,&toAnalyzeTinyQueue,&tinyRequestGate,&reportNoAnalysis,&reportFinalAnalysis,&logSearchInfo,&nnEval,&resultCache,
+    &finishCachedRequest,&closeRequest,&defaultParams,&humanEval,&patternBonusTable,&getTinyRequestParams,&tinyRequestShouldStop,
+    &numAnalysisThreads
+  ](int tinyThreadIdx, const string& searchRandSeed) {
+    std::atomic<bool>& shouldStopNow = tinyRequestShouldStop[tinyThreadIdx];
+    const int threadStatus = numAnalysisThreads + tinyThreadIdx;
+    SearchParams searchParams = getTinyRequestParams(defaultParams);
+    std::unique_ptr<Search> search = std::make_unique<Search>(searchParams, nnEval, humanEval, &logger, searchRandSeed);
+    search->setCopyOfExternalPatternBonusTable(patternBonusTable);
+    while(true) {
+      tinyRequestGate.acquire();
+      std::pair<std::pair<int64_t,int64_t>,AnalyzeRequest*> analysisItem;
+      bool suc = toAnalyzeTinyQueue.waitPop(analysisItem);
+      if(!suc) {
+        tinyRequestGate.release();
+        break;
+      }
+      AnalyzeRequest* request = analysisItem.second;
+      bool hasResult = false;
+      json result;
+      int expected = AnalyzeRequest::STATUS_IN_QUEUE;
+      if(request->status.compare_exchange_strong(expected, AnalyzeRequest::STATUS_POPPED, std::memory_order_acq_rel)) {
+        searchParams = getTinyRequestParams(request->params);
+        search->setPosition(request->nextPla,request->board,request->hist);
+        search->setParams(searchParams);
+        search->setAvoidMoveUntilByLoc(request->avoidMoveUntilByLocBlack,request->avoidMoveUntilByLocWhite);
+        //Put our index in the request so that a terminate from here on stops our search, as with the analysis threads
+        shouldStopNow.store(false);
+        int expected2 = AnalyzeRequest::STATUS_POPPED;
+        if(!request->status.compare_exchange_strong(expected2, threadStatus, std::memory_order_acq_rel)) {
+          assert(expected2 == AnalyzeRequest::STATUS_TERMINATED);
+          reportNoAnalysis(request);
+        }
+        else {
+          search->runWholeSearch(shouldStopNow);
+          if(logSearchInfo) {
+            ostringstream sout;
+            PlayUtils::printGenmoveLog(sout,search.get(),nnEval,Board::NULL_LOC,NAN,request->perspective,false);
+            logger.write(sout.str());
           }
+          hasResult = reportFinalAnalysis(request,search.get(),result);
         }
+        search->clearSearch();
       }
+      tinyRequestGate.release();
 
-      //Free up bot resources in case it's a while before we do more search
-      bot->clearSearch();
+      if(resultCache != nullptr)
+        finishCachedRequest(request, hasResult, result);
+      closeRequest(request);
+    }
+  };
+  auto tinyRequestLoopProtected = [&logger,&tinyRequestLoop](int tinyThreadIdx, string searchRandSeed) {
+    Logger::logThreadUncaught("tiny request loop", &logger, [&](){ tinyRequestLoop(tinyThreadIdx, searchRandSeed); });
+  };
 
-      //This request is no longer open
+  //Periodically adjust how many tiny requests are evaluated at once, based on how full the recent batches of the evaluator were
+  auto tinyRequestControlLoop = [&logger,&toAnalyzeTinyQueue,&tinyRequestGate,&nnEval]() {
+    const double adjustPeriod = 1.0;
+    uint64_t lastRows = nnEval->numRowsProcessed();
+    uint64_t lastBatches = nnEval->numBatchesProcessed();
+    int lastLimit = tinyRequestGate.limit;
+    while(true) {
       {
-        std::lock_guard<std::mutex> lock(openRequestsMutex);
-        openRequests.erase(request->internalId);
+        std::unique_lock<std::mutex> lock(tinyRequestGate.mutex);
+        tinyRequestGate.shutdownSignaled.wait_for(
+          lock, std::chrono::duration<double>(adjustPeriod), [&tinyRequestGate](){ return tinyRequestGate.shuttingDown; }
+        );
+        if(tinyRequestGate.shuttingDown)
+          break;
+      }
+      uint64_t rows = nnEval->numRowsProcessed();
+      uint64_t batches = nnEval->numBatchesProcessed();
+      if(batches <= lastBatches)
+        continue;
+      double recentBatchSize = (double)(rows - lastRows) / (double)(batches - lastBatches);
+      lastRows = rows;
+      lastBatches = batches;
+      int limit = tinyRequestGate.adjustLimit(recentBatchSize, nnEval->getMaxBatchSize(), toAnalyzeTinyQueue.size() > 0);
+      if(limit != lastLimit) {
+        logger.write(
+          Global::strprintf(
+            "Tiny requests: evaluating up to %d at once, recent NN avg batch size %.2f, overall %.2f",
+            limit, recentBatchSize, nnEval->averageProcessedBatchSize()
+          )
+        );
+        lastLimit = limit;
       }
-      delete request;
     }
   };
-  auto analysisLoopProtected = [&logger,&analysisLoop](AsyncBot* bot, int threadIdx) {
-    Logger::logThreadUncaught("analysis loop", &logger, [&](){ analysisLoop(bot, threadIdx); });
-  };
 
   vector<std::thread> threads;
   std::thread write_thread = std::thread(writeLoop);
@@ -419,17 +968,30 @@ int MainCmds::analysis(const vector<string>& args) {
     string searchRandSeed = Global::uint64ToHexString(seedRand.nextUInt64()) + Global::uint64ToHexString(seedRand.nextUInt64());
     AsyncBot* bot = new AsyncBot(defaultParams, nnEval, humanEval, &logger, searchRandSeed);
     bot->setCopyOfExternalPatternBonusTable(patternBonusTable);
-    threads.push_back(std::thread(analysisLoopProtected,bot,threadIdx));
+    threads.push_back(std::thread(analysisLoopProtected,bot,threadIdx,searchRandSeed));
     bots.push_back(bot);
   }
 
   logger.write("Analyzing up to " + Global::intToString(numAnalysisThreads) + " positions at a time in parallel");
+  vector<std::thread> tinyRequestThreads;
+  std::thread tinyRequestControlThread;
+  if(analysisTinyRequestMaxVisits > 0) {
+    for(int i = 0; i<analysisTinyRequestThreads; i++) {
+      string searchRandSeed = Global::uint64ToHexString(seedRand.nextUInt64()) + Global::uint64ToHexString(seedRand.nextUInt64());
+      tinyRequestThreads.push_back(std::thread(tinyRequestLoopProtected,i,searchRandSeed));
+    }
+    tinyRequestControlThread = std::thread(tinyRequestControlLoop);
+    logger.write(
+      "Analyzing requests with up to " + Global::int64ToString(analysisTinyRequestMaxVisits) + " visits separately, up to " +
+      Global::intToString(analysisTinyRequestThreads) + " at a time"
+    );
+  }
   logger.write("Started, ready to begin handling requests");
   if(!logToStderr) {
     cerr << "Started, ready to begin handling requests" << endl;
   }
 
-  auto terminateRequest = [&bots,&reportNoAnalysis](AnalyzeRequest* request) {
+  auto terminateRequest = [&bots,&reportNoAnalysis,&tinyRequestShouldStop](AnalyzeRequest* request) {
     //Firstly, flag the request as terminated
     int prevStatus = request->status.exchange(AnalyzeRequest::STATUS_TERMINATED,std::memory_order_acq_rel);
     //Already terminated? Nothing to do.
@@ -449,7 +1011,10 @@ int MainCmds::analysis(const vector<string>& args) {
       //Or else the thread has already done so, in which case it's already properly written a result, also fine.
       int threadIdx = prevStatus;
       //Terminate it by thread index
-      bots[threadIdx]->stopWithoutWait();
+      if(threadIdx < (int)bots.size())
+        bots[threadIdx]->stopWithoutWait();
+      else
+        tinyRequestShouldStop[threadIdx - (int)bots.size()].store(true);
     }
   };
 
@@ -522,6 +1087,33 @@ int MainCmds::analysis(const vector<string>& args) {
           nnEval->clearCache();
           if(humanEval != NULL)
             humanEval->clearCache();
+          if(resultCache != nullptr) {
+            std::lock_guard<std::mutex> lock(resultCache->mutex);
+            resultCache->clear();
+          }
+          if(treeCache != nullptr) {
+            vector<Search*> evicted;
+            {
+              std::lock_guard<std::mutex> lock(treeCache->mutex);
+              treeCache->clear(evicted);
+            }
+            releaseTrees(evicted);
+          }
+          pushToWrite(new string(input.dump()));
+        }
+        else if(action == "query_cache_stats") {
+          if(resultCache != nullptr) {
+            std::lock_guard<std::mutex> lock(resultCache->mutex);
+            input["resultCache"] = resultCache->getStats();
+          }
+          else
+            input["resultCache"] = nullptr;
+          if(treeCache != nullptr) {
+            std::lock_guard<std::mutex> lock(treeCache->mutex);
+            input["treeCache"] = treeCache->getStats();
+          }
+          else
+            input["treeCache"] = nullptr;
           pushToWrite(new string(input.dump()));
         }
         else if(action == "terminate") {
@@ -587,7 +1179,7 @@ int MainCmds::analysis(const vector<string>& args) {
           pushToWrite(new string(input.dump()));
         }
         else {
-          reportError("'action' field must be 'query_version' or 'query_models' or 'clear_cache' or 'terminate' or 'terminate_all'");
+          reportError("'action' field must be 'query_version' or 'query_models' or 'clear_cache' or 'query_cache_stats' or 'terminate' or 'terminate_all'");
         }
 
         continue;
@@ -1194,6 +1786,37 @@ int MainCmds::analysis(const vector<string>& args) {
         continue;
       }
 
+      //Answer the requests that the result cache already has, and attach the ones identical to a request being analyzed to it
+      if(resultCache != nullptr) {
+        vector<AnalyzeRequest*> requestsToQueue;
+        for(int i = 0; i<newRequests.size(); i++) {
+          AnalyzeRequest* request = newRequests[i];
+          request->resultCacheKey = getResultCacheKey(request);
+          std::lock_guard<std::mutex> lock(resultCache->mutex);
+          json result;
+          if(resultCache->get(request->resultCacheKey, request->params, result)) {
+            resultCache->numHits++;
+            reportCachedAnalysis(request, result);
+            delete request;
+            continue;
+          }
+          auto it = resultCache->running.find(request->resultCacheKey);
+          //Requests that want reports during the search get their own search
+          if(it != resultCache->running.end() && !request->reportDuringSearch && it->second->params == request->params) {
+            resultCache->numCoalesced++;
+            it->second->followers.push_back(request);
+            std::lock_guard<std::mutex> openLock(openRequestsMutex);
+            openRequests[request->internalId] = request;
+            continue;
+          }
+          resultCache->numMisses++;
+          if(it == resultCache->running.end())
+            resultCache->running[request->resultCacheKey] = request;
+          requestsToQueue.push_back(request);
+        }
+        newRequests.swap(requestsToQueue);
+      }
+
       //Add all requests to open requests
       {
         std::lock_guard<std::mutex> lock(openRequestsMutex);
@@ -1203,9 +1826,8 @@ int MainCmds::analysis(const vector<string>& args) {
       }
       //Push into queue for processing
       for(int i = 0; i<newRequests.size(); i++) {
-        //Compare first by user-provided priority, and next breaks ties by preferring earlier requests.
         std::pair<int64_t,int64_t> priorityKey = std::make_pair(newRequests[i]->priority, -numRequestsSoFar);
-        bool suc = toAnalyzeQueue.forcePush( std::make_pair(priorityKey, newRequests[i]) );
+        bool suc = pushToAnalyze(newRequests[i], priorityKey);
         assert(suc);
         (void)suc;
         numRequestsSoFar++;
@@ -1224,6 +1846,7 @@ int MainCmds::analysis(const vector<string>& args) {
     toWriteQueue.setReadOnly();
     //Making this readOnly should signal the analysis loop threads to terminate once they have nothing left.
     toAnalyzeQueue.setReadOnly();
+    toAnalyzeTinyQueue.setReadOnly();
     //Interrupt any searches going on to help the analysis threads realize to terminate faster.
     for(int i = 0; i<bots.size(); i++)
       bots[i]->stopWithoutWait();
@@ -1231,21 +1854,36 @@ int MainCmds::analysis(const vector<string>& args) {
       bots[i]->setKilled();
     for(int i = 0; i<threads.size(); i++)
       threads[i].join();
+    for(int i = 0; i<tinyRequestThreads.size(); i++)
+      tinyRequestThreads[i].join();
     write_thread.join();
   }
   else {
     //Making this readOnly should signal the analysis loop threads to terminate once they have nothing left.
     toAnalyzeQueue.setReadOnly();
+    toAnalyzeTinyQueue.setReadOnly();
     //Wait patiently for everything to finish
     for(int i = 0; i<threads.size(); i++)
       threads[i].join();
+    for(int i = 0; i<tinyRequestThreads.size(); i++)
+      tinyRequestThreads[i].join();
     //Signal the write loop thread to terminate
     toWriteQueue.setReadOnly();
     write_thread.join();
   }
 
+  if(tinyRequestControlThread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(tinyRequestGate.mutex);
+      tinyRequestGate.shuttingDown = true;
+      tinyRequestGate.shutdownSignaled.notify_all();
+    }
+    tinyRequestControlThread.join();
+  }
+
   for(int i = 0; i<bots.size(); i++)
     delete bots[i];
+  treeCache = nullptr;
 
   logger.write(nnEval->getModelFileName());
   logger.write("NN rows: " + Global::int64ToString(nnEval->numRowsProcessed()));
@@ -1257,6 +1895,9 @@ int MainCmds::analysis(const vector<string>& args) {
     logger.write("NN batches: " + Global::int64ToString(humanEval->numBatchesProcessed()));
     logger.write("NN avg batch size: " + Global::doubleToString(humanEval->averageProcessedBatchSize()));
   }
+#ifdef USE_VCF
+  logger.write(VCFsolver::getStatsString());
+#endif
   delete nnEval;
   delete humanEval;
   NeuralNet::globalCleanup();
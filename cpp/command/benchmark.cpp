@@ -3,11 +3,13 @@
 #include "../core/fileutils.h"
 #include "../core/timer.h"
 #include "../dataio/sgf.h"
+#include "../neuralnet/nnprofiler.h"
 #include "../search/asyncbot.h"
 #include "../program/setup.h"
 #include "../program/playutils.h"
 #include "../program/gtpconfig.h"
 #include "../tests/tests.h"
+#include "../vcfsolver/VCFsolver.h"
 #include "../command/commandline.h"
 #include "../main.h"
 
@@ -31,6 +33,19 @@ static vector<PlayUtils::BenchmarkResults> doFixedTuneThreads(
   bool printElo,
   std::function<int(int)> getDesiredBatchSize
 );
+static void doEigenIntraOpThreads(
+  const SearchParams& params,
+  const CompactSgf* sgf,
+  int numPositionsPerGame,
+  NNEvaluator*& nnEval,
+  Logger& logger,
+  ConfigParser& cfg,
+  double secondsPerGameMove,
+  const vector<int>& numThreadsToTest,
+  const vector<int>& numIntraOpThreadsToTest,
+  std::function<void()> reallocateNNEval,
+  std::function<int(int)> getDesiredBatchSize
+);
 static vector<PlayUtils::BenchmarkResults> doAutoTuneThreads(
   const SearchParams& params,
   const CompactSgf* sgf,
@@ -65,6 +80,10 @@ int MainCmds::benchmark(const vector<string>& args) {
   int fixedBatchSize;
   bool useHalfBatchSize;
   double secondsPerGameMove;
+  vector<int> numIntraOpThreadsToTest;
+  bool profile;
+  string profileJsonFile;
+  string profileTraceFile;
   try {
     KataGoCommandLine cmd("Benchmark with gtp config to test speed with different numbers of threads.");
     cmd.addConfigFileArg(KataGoCommandLine::defaultGtpConfigFileName(),"gtp_example.cfg");
@@ -88,6 +107,23 @@ int MainCmds::benchmark(const vector<string>& args) {
       Global::doubleToString(defaultSecondsPerGameMove) + ")",
       false,defaultSecondsPerGameMove,"SECONDS"
     );
+    TCLAP::ValueArg<string> intraOpThreadsArg(
+      "","intra-op-threads",
+      "Eigen backend only: compare these numbers of threads splitting each neural net batch (numEigenIntraOpThreads), comma-separated, e.g. '1,2,4'. "
+      "Reports the latency of single evaluations and the search speed for each of them. Requires -threads",
+      false,"","THREADS"
+    );
+    TCLAP::SwitchArg profileArg(
+      "","profile",
+      "Time the phases of neural net evaluation (input filling, queueing, backend, postprocessing) and, for the Eigen backend, "
+      "each layer, and print a breakdown at the end. Slows down evaluation somewhat"
+    );
+    TCLAP::ValueArg<string> profileJsonArg("","profile-json","Also write the profile breakdown as json to this file, implies -profile",false,string(),"FILE");
+    TCLAP::ValueArg<string> profileTraceArg(
+      "","profile-trace",
+      "Also write every profiled section as a chrome trace (chrome://tracing, ui.perfetto.dev) to this file, implies -profile",
+      false,string(),"FILE"
+    );
 
     cmd.add(visitsArg);
     cmd.add(threadsArg);
@@ -102,6 +138,10 @@ int MainCmds::benchmark(const vector<string>& args) {
     cmd.add(fixedBatchSizeArg);
     cmd.add(halfBatchSizeArg);
     cmd.add(secondsPerGameMoveArg);
+    cmd.add(intraOpThreadsArg);
+    cmd.add(profileArg);
+    cmd.add(profileJsonArg);
+    cmd.add(profileTraceArg);
     cmd.parseArgs(args);
 
     modelFile = cmd.getModelFile();
@@ -114,6 +154,10 @@ int MainCmds::benchmark(const vector<string>& args) {
     fixedBatchSize = fixedBatchSizeArg.getValue();
     useHalfBatchSize = halfBatchSizeArg.getValue();
     secondsPerGameMove = secondsPerGameMoveArg.getValue();
+    string desiredIntraOpThreadsStr = intraOpThreadsArg.getValue();
+    profileJsonFile = profileJsonArg.getValue();
+    profileTraceFile = profileTraceArg.getValue();
+    profile = profileArg.getValue() || profileJsonFile != "" || profileTraceFile != "";
 
     if(boardSize != -1 && sgfFile != "")
       throw StringError("Cannot specify both -sgf and -boardsize at the same time");
@@ -131,6 +175,26 @@ int MainCmds::benchmark(const vector<string>& args) {
       throw StringError("Invalid value for fixed batch size");
     if(fixedBatchSize != -1 && useHalfBatchSize)
       throw StringError("Cannot specify both fixed batch size and use half batch size");
+    if(desiredIntraOpThreadsStr != "") {
+#ifndef USE_EIGEN_BACKEND
+      throw StringError("-intra-op-threads is only supported by the Eigen backend");
+#endif
+      if(desiredThreadsStr == "")
+        throw StringError("-intra-op-threads requires specifying the numbers of search threads to test with -threads");
+      vector<string> pieces = Global::split(desiredIntraOpThreadsStr,',');
+      for(int i = 0; i<pieces.size(); i++) {
+        string s = Global::trim(pieces[i]);
+        if(s == "")
+          continue;
+        int numIntraOpThreads;
+        bool suc = Global::tryStringToInt(s,numIntraOpThreads);
+        if(!suc || numIntraOpThreads <= 0 || numIntraOpThreads > 1024)
+          throw StringError("Number of intra-op threads to use: invalid value: " + s);
+        numIntraOpThreadsToTest.push_back(numIntraOpThreads);
+      }
+      if(numIntraOpThreadsToTest.size() <= 0)
+        throw StringError("Must specify at least one valid value for -intra-op-threads");
+    }
 
     //Apply default
     if(desiredThreadsStr == "")
@@ -272,15 +336,26 @@ int MainCmds::benchmark(const vector<string>& args) {
   cout << endl;
   cout << "Your GTP config is currently set to use numSearchThreads = " << params.numThreads << endl;
 
+  if(profile)
+    NNProfiler::setEnabled(true, profileTraceFile != "");
+
   vector<PlayUtils::BenchmarkResults> results;
-  if(!autoTuneThreads) {
+  if(numIntraOpThreadsToTest.size() > 0) {
+    int maxThreads = *std::max_element(numThreadsToTest.begin(),numThreadsToTest.end());
+    auto reallocateNNEval = [&]() { reallocateNNEvalWithEnoughBatchSize(maxThreads); };
+    doEigenIntraOpThreads(
+      params,sgf,numPositionsPerGame,nnEval,logger,cfg,secondsPerGameMove,
+      numThreadsToTest,numIntraOpThreadsToTest,reallocateNNEval,getDesiredBatchSize
+    );
+  }
+  else if(!autoTuneThreads) {
     results = doFixedTuneThreads(params,sgf,numPositionsPerGame,nnEval,logger,secondsPerGameMove,numThreadsToTest,true,getDesiredBatchSize);
   }
   else {
     results = doAutoTuneThreads(params,sgf,numPositionsPerGame,nnEval,logger,secondsPerGameMove,reallocateNNEvalWithEnoughBatchSize,getDesiredBatchSize);
   }
 
-  if(numThreadsToTest.size() > 1 || autoTuneThreads) {
+  if(numIntraOpThreadsToTest.size() <= 0 && (numThreadsToTest.size() > 1 || autoTuneThreads)) {
     PlayUtils::BenchmarkResults::printEloComparison(results,secondsPerGameMove);
 
     cout << "If you care about performance, you may want to edit numSearchThreads in " << cfg.getFileName() << " based on the above results!" << endl;
@@ -299,6 +374,28 @@ int MainCmds::benchmark(const vector<string>& args) {
     cout << endl;
   }
 
+#ifdef USE_VCF
+  cout << VCFsolver::getStatsString() << endl;
+  logger.write(VCFsolver::getStatsString());
+#endif
+
+  if(profile) {
+    NNProfiler::setEnabled(false, false);
+    cout << "Neural net evaluation profile, summed over all the thread counts tested and over all threads." << endl;
+    cout << "Client times are per search thread, server times per server thread, the backend's layers are nested within getOutput." << endl;
+    cout << NNProfiler::getTableString() << endl;
+    cout << "Neural net batches for the last thread count tested:" << endl;
+    cout << nnEval->getBatchLatencyHistogramString() << endl;
+    if(profileJsonFile != "") {
+      NNProfiler::writeJson(profileJsonFile);
+      cout << "Wrote profile to " << profileJsonFile << endl;
+    }
+    if(profileTraceFile != "") {
+      NNProfiler::writeChromeTrace(profileTraceFile);
+      cout << "Wrote profile trace to " << profileTraceFile << endl;
+    }
+  }
+
   delete nnEval;
   NeuralNet::globalCleanup();
   delete sgf;
@@ -365,7 +462,7 @@ static void setNumThreads(SearchParams& params, NNEvaluator* nnEval, Logger& log
   //Also, disable the logger to suppress the kill and respawn messages.
   logger.setDisabled(true);
   nnEval->killServerThreads();
-  nnEval->setNumThreads(vector<int>(Setup::computeDefaultEigenBackendThreads(numThreads, logger), -1));
+  nnEval->setNumThreads(vector<int>(Setup::computeDefaultEigenBackendThreads(numThreads, nnEval->getNumEigenIntraOpThreads(), logger), -1));
   nnEval->setCurrentBatchSize(desiredBatchSize);
   // Also since we killed and respawned all the threads, re-warm them
   Rand seedRand;
@@ -418,6 +515,80 @@ static vector<PlayUtils::BenchmarkResults> doFixedTuneThreads(
   return results;
 }
 
+//Average seconds for a single unbatched, uncached nn evaluation, over the first positions of the sgf
+static double measureNNLatency(const CompactSgf* sgf, NNEvaluator* nnEval, int numPositions) {
+  Rules initialRules = Rules::getTrompTaylorish();
+  Board board;
+  Player nextPla;
+  BoardHistory hist;
+  sgf->setupInitialBoardAndHist(initialRules, board, nextPla, hist);
+
+  MiscNNInputParams nnInputParams;
+  NNResultBuf buf;
+  double totalSeconds = 0.0;
+  int numEvals = 0;
+  for(int i = 0; i<numPositions; i++) {
+    ClockTimer timer;
+    nnEval->evaluate(board,hist,nextPla,nnInputParams,buf,true);
+    totalSeconds += timer.getSeconds();
+    numEvals += 1;
+    if(i >= sgf->moves.size() || !hist.makeBoardMoveTolerant(board,sgf->moves[i].loc,sgf->moves[i].pla))
+      break;
+    nextPla = getOpp(sgf->moves[i].pla);
+  }
+  return totalSeconds / numEvals;
+}
+
+static void doEigenIntraOpThreads(
+  const SearchParams& params,
+  const CompactSgf* sgf,
+  int numPositionsPerGame,
+  NNEvaluator*& nnEval,
+  Logger& logger,
+  ConfigParser& cfg,
+  double secondsPerGameMove,
+  const vector<int>& numThreadsToTest,
+  const vector<int>& numIntraOpThreadsToTest,
+  std::function<void()> reallocateNNEval,
+  std::function<int(int)> getDesiredBatchSize
+) {
+  vector<double> latencies;
+  vector<PlayUtils::BenchmarkResults> bestResults;
+  for(int i = 0; i<numIntraOpThreadsToTest.size(); i++) {
+    int numIntraOpThreads = numIntraOpThreadsToTest[i];
+    cfg.overrideKey("numEigenIntraOpThreads",Global::intToString(numIntraOpThreads));
+    reallocateNNEval();
+
+    cout << "numEigenIntraOpThreads = " << numIntraOpThreads << endl;
+    double latency = measureNNLatency(sgf,nnEval,20);
+    cout << "Single neural net evaluation latency: " << Global::strprintf("%.2f",latency * 1000.0) << " ms" << endl;
+    vector<PlayUtils::BenchmarkResults> results =
+      doFixedTuneThreads(params,sgf,numPositionsPerGame,nnEval,logger,secondsPerGameMove,numThreadsToTest,false,getDesiredBatchSize);
+    cout << endl;
+
+    PlayUtils::BenchmarkResults best = results[0];
+    for(const PlayUtils::BenchmarkResults& result: results) {
+      if(result.totalVisits / result.totalSeconds > best.totalVisits / best.totalSeconds)
+        best = result;
+    }
+    latencies.push_back(latency);
+    bestResults.push_back(best);
+  }
+
+  cout << "Summary (board size " << sgf->xSize << "x" << sgf->ySize << "):" << endl;
+  for(int i = 0; i<numIntraOpThreadsToTest.size(); i++) {
+    const PlayUtils::BenchmarkResults& best = bestResults[i];
+    cout << "numEigenIntraOpThreads = " << numIntraOpThreadsToTest[i]
+         << ": latency " << Global::strprintf("%.2f",latencies[i] * 1000.0) << " ms"
+         << ", best throughput " << Global::strprintf("%.2f",best.totalVisits / best.totalSeconds) << " visits/s"
+         << " at numSearchThreads = " << best.numThreads << endl;
+  }
+  cout << endl;
+  cout << "Higher numEigenIntraOpThreads lowers the latency of each evaluation, which helps short searches with few threads." << endl;
+  cout << "With many search threads, more backend threads each using fewer cores usually gives more total throughput." << endl;
+  cout << endl;
+}
+
 static vector<PlayUtils::BenchmarkResults> doAutoTuneThreads(
   const SearchParams& params,
   const CompactSgf* sgf,
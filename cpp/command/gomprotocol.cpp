@@ -479,6 +479,56 @@ struct GomEngine {
     return true;
   }
 
+  //If the stones, in the order they were played, are the current position followed by some more moves, then play just those
+  //moves so that the search tree under them is kept, as when a manager sends the full BOARD every turn.
+  //Returns false if the position can't be reached this way, in which case it should be set up from scratch.
+  bool tryAdvancePosition(const vector<Move>& stones, Logger& logger) {
+    assert(bot->getRootHist().rules == currentRules);
+    bot->stopAndWait();
+    const Board& rootBoard = bot->getRootBoard();
+    if(stones.size() < rootBoard.numStonesOnBoard())
+      return false;
+
+    vector<Move> newMoves;
+    vector<bool> isNewMoveLoc(Board::MAX_ARR_SIZE, false);
+    int numStonesMatched = 0;
+    for(int i = 0; i<stones.size(); i++) {
+      Loc loc = stones[i].loc;
+      if(!rootBoard.isOnBoard(loc))
+        return false;
+      if(rootBoard.colors[loc] == C_EMPTY) {
+        if(isNewMoveLoc[loc])
+          return false;
+        isNewMoveLoc[loc] = true;
+        newMoves.push_back(stones[i]);
+      }
+      else if(rootBoard.colors[loc] != stones[i].pla)
+        return false;
+      else
+        numStonesMatched++;
+    }
+    if(numStonesMatched != rootBoard.numStonesOnBoard())
+      return false;
+    Player pla = bot->getRootPla();
+    for(int i = 0; i<newMoves.size(); i++) {
+      if(newMoves[i].pla != pla)
+        return false;
+      pla = getOpp(pla);
+    }
+
+    int64_t oldRootVisits = bot->getSearch()->getRootVisits();
+    for(int i = 0; i<newMoves.size(); i++) {
+      if(!play(newMoves[i].loc, newMoves[i].pla))
+        return false;
+    }
+    int64_t newRootVisits = bot->getSearch()->getRootVisits();
+    logger.write(
+      "BOARD reached by " + Global::intToString((int)newMoves.size()) + " new moves, kept " +
+      Global::int64ToString(newRootVisits) + " of " + Global::int64ToString(oldRootVisits) + " root visits (" +
+      Global::strprintf("%.1f%%", oldRootVisits > 0 ? 100.0 * newRootVisits / oldRootVisits : 0.0) + ")");
+    return true;
+  }
+
   void updateKomiIfNew(float newKomi) {
     bot->setKomiIfNew(newKomi);
     currentRules.komi = newKomi;
@@ -1571,7 +1621,7 @@ int MainCmds::gomprotocol(const std::vector<std::string>& args) {
             responseIsError = true;
             response = "Expected 1 arguments for info:time_left but got '" + Global::concat(pieces, " ") + "'";
           }
-          else
+          else if(engine->bTimeControls.originalMainTime < TimeControls::UNLIMITED_TIME_THRESHOLD)
           {
             engine->bTimeControls.mainTimeLeft = time / 1000.0;
             engine->wTimeControls.mainTimeLeft = time / 1000.0;
@@ -1584,8 +1634,12 @@ int MainCmds::gomprotocol(const std::vector<std::string>& args) {
             responseIsError = true;
             response = "Expected 1 arguments for info:timeout_match but got '" + Global::concat(pieces, " ") + "'";
           } else {
-            engine->bTimeControls.originalMainTime = time / 1000.0;
-            engine->wTimeControls.originalMainTime = time / 1000.0;
+            // 0 means no limit for the match
+            double mainTime = time > 0 ? time / 1000.0 : TimeControls::UNLIMITED_TIME_DEFAULT;
+            engine->bTimeControls.gomocupMatchTime = true;
+            engine->wTimeControls.gomocupMatchTime = true;
+            engine->bTimeControls.originalMainTime = mainTime;
+            engine->wTimeControls.originalMainTime = mainTime;
             engine->bTimeControls.mainTimeLeft = engine->bTimeControls.originalMainTime;
             engine->wTimeControls.mainTimeLeft = engine->wTimeControls.originalMainTime;
           }
@@ -1645,8 +1699,6 @@ int MainCmds::gomprotocol(const std::vector<std::string>& args) {
       }
     }
     else if (command == "BOARD") {
-      engine->clearCache();
-      engine->clearBoard();
       maybeSaveAvoidPatterns(false);
 
       string moveline;
@@ -1665,7 +1717,11 @@ int MainCmds::gomprotocol(const std::vector<std::string>& args) {
         {
           bool debug = false;
           bool playChosenMove = true;
-          engine->setPosition(initialStones);
+          if(!engine->tryAdvancePosition(initialStones, logger)) {
+            engine->clearCache();
+            engine->clearBoard();
+            engine->setPosition(initialStones);
+          }
           GomEngine::GenmoveArgs gargs;
           gargs.searchFactorWhenWinningThreshold = searchFactorWhenWinningThreshold;
           gargs.searchFactorWhenWinning = searchFactorWhenWinning;
@@ -8,6 +8,7 @@
 #include "../search/patternbonustable.h"
 #include "../program/setup.h"
 #include "../program/play.h"
+#include "../vcfsolver/VCFsolver.h"
 #include "../command/commandline.h"
 #include "../main.h"
 #include "../external/nlohmann_json/json.hpp"
@@ -464,6 +465,9 @@ int MainCmds::match(const vector<string>& args) {
       delete nnEvals[i];
     }
   }
+#ifdef USE_VCF
+  logger.write(VCFsolver::getStatsString());
+#endif
   NeuralNet::globalCleanup();
 
   if(sigReceived.load())
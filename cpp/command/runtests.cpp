@@ -14,6 +14,7 @@
 #include "../game/board.h"
 #include "../game/rules.h"
 #include "../game/boardhistory.h"
+#include "../forbiddenPoint/ForbiddenPointFinder.h"
 #include "../neuralnet/nninputs.h"
 #include "../program/gtpconfig.h"
 #include "../program/setup.h"
@@ -23,12 +24,10 @@
 
 using namespace std;
 
-/*
 int MainCmds::runtests(const vector<string>& args) {
   (void)args;
   testAssert(sizeof(size_t) == 8);
   Board::initHash();
-  ScoreValue::initTables();
 
   BSearch::runTests();
   Rand::runTests();
@@ -38,38 +37,16 @@ int MainCmds::runtests(const vector<string>& args) {
   Base64::runTests();
   ThreadTest::runTests();
 
-  Tests::runBoardIOTests();
-  Tests::runBoardBasicTests();
-
-  Tests::runBoardAreaTests();
-
-  Tests::runRulesTests();
-
-  Tests::runBoardUndoTest();
-  Tests::runBoardHandicapTest();
-  Tests::runBoardStressTest();
-
-  Tests::runSgfTests();
-  Tests::runBasicSymmetryTests();
-  Tests::runBoardSymmetryTests();
-  Tests::runSymmetryDifferenceTests();
-  Tests::runBoardReplayTest();
+  CForbiddenPointFinder::runTests();
 
-  ScoreValue::freeTables();
-
-  Tests::runInlineConfigTests();
-
-  // Pick an arbitrary file that the test uses
-  if(FileUtils::exists("tests/data/configs/folded/test-parent.cfg"))
-    Tests::runConfigTests({});
-  else {
-    cout << "Not being run out of git repo, skipping config parsing tests" << endl;
-  }
+  Tests::runIncrementalBackupTests();
 
   cout << "All tests passed" << endl;
   return 0;
 }
 
+/*
+
 int MainCmds::runoutputtests(const vector<string>& args) {
   (void)args;
   Board::initHash();
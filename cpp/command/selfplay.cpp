@@ -11,6 +11,7 @@
 #include "../program/setup.h"
 #include "../program/play.h"
 #include "../program/selfplaymanager.h"
+#include "../vcfsolver/VCFsolver.h"
 #include "../command/commandline.h"
 #include "../main.h"
 
@@ -389,6 +390,9 @@ int MainCmds::selfplay(const vector<string>& args) {
   //Delete and clean up everything else
   NeuralNet::globalCleanup();
   gameRunner.reset();
+#ifdef USE_VCF
+  logger.write(VCFsolver::getStatsString());
+#endif
 
   if(sigReceived.load())
     logger.write("Exited cleanly after signal");
@@ -0,0 +1,194 @@
+#include "../core/numa.h"
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace std;
+
+namespace {
+  struct Topology {
+    vector<int> nodeIds;
+    vector<vector<int>> cpusByNode;
+    vector<int64_t> memoryKBByNode;
+  };
+
+  std::atomic<bool> pinThreads(false);
+  std::atomic<bool> interleaveTables(false);
+
+  //Parses sysfs cpu lists like "0-15,32-47"
+  vector<int> parseCpuList(const string& s) {
+    vector<int> ret;
+    for(const string& piece: Global::split(Global::trim(s),',')) {
+      if(Global::trim(piece).size() <= 0)
+        continue;
+      vector<string> range = Global::split(Global::trim(piece),'-');
+      int lo = Global::stringToInt(range[0]);
+      int hi = range.size() > 1 ? Global::stringToInt(range[1]) : lo;
+      for(int cpu = lo; cpu <= hi; cpu++)
+        ret.push_back(cpu);
+    }
+    return ret;
+  }
+
+  string readFirstLine(const string& file) {
+    ifstream in(file);
+    string line;
+    if(!in.good() || !std::getline(in,line))
+      return string();
+    return line;
+  }
+
+  Topology readTopology() {
+    Topology topology;
+#ifdef __linux__
+    try {
+      vector<int> onlineNodes = parseCpuList(readFirstLine("/sys/devices/system/node/online"));
+      for(int node: onlineNodes) {
+        string dir = "/sys/devices/system/node/node" + Global::intToString(node);
+        vector<int> cpus = parseCpuList(readFirstLine(dir + "/cpulist"));
+        //Memory-only nodes have nothing to pin threads to
+        if(cpus.size() <= 0)
+          continue;
+        int64_t memoryKB = 0;
+        ifstream in(dir + "/meminfo");
+        string line;
+        while(std::getline(in,line)) {
+          vector<string> pieces = Global::split(line,' ');
+          vector<string> words;
+          for(const string& piece: pieces)
+            if(piece.size() > 0)
+              words.push_back(piece);
+          if(words.size() >= 4 && words[2] == "MemTotal:") {
+            memoryKB = Global::stringToInt64(words[3]);
+            break;
+          }
+        }
+        topology.nodeIds.push_back(node);
+        topology.cpusByNode.push_back(cpus);
+        topology.memoryKBByNode.push_back(memoryKB);
+      }
+    }
+    catch(const StringError&) {
+      topology = Topology();
+    }
+#endif
+    return topology;
+  }
+
+  const Topology& getTopology() {
+    static std::once_flag flag;
+    static Topology topology;
+    std::call_once(flag, []() { topology = readTopology(); });
+    return topology;
+  }
+}
+
+int NUMA::getNumNodes() {
+  const Topology& topology = getTopology();
+  return topology.nodeIds.size() > 0 ? (int)topology.nodeIds.size() : 1;
+}
+
+string NUMA::getTopologyString() {
+  const Topology& topology = getTopology();
+  if(topology.nodeIds.size() <= 0)
+    return "NUMA topology unknown, treating as a single node";
+  ostringstream out;
+  out << "NUMA nodes: " << topology.nodeIds.size();
+  for(size_t i = 0; i<topology.nodeIds.size(); i++) {
+    const vector<int>& cpus = topology.cpusByNode[i];
+    out << "\n  node " << topology.nodeIds[i] << ": " << cpus.size() << " cpus";
+    //Compact back into ranges
+    string cpuList;
+    for(size_t j = 0; j<cpus.size(); j++) {
+      size_t k = j;
+      while(k+1 < cpus.size() && cpus[k+1] == cpus[k]+1)
+        k++;
+      cpuList += (cpuList.size() > 0 ? "," : "") + Global::intToString(cpus[j]);
+      if(k > j)
+        cpuList += "-" + Global::intToString(cpus[k]);
+      j = k;
+    }
+    out << " (" << cpuList << "), " << Global::strprintf("%.1f", topology.memoryKBByNode[i] / (1024.0 * 1024.0)) << " GB";
+  }
+  return out.str();
+}
+
+void NUMA::setPinThreads(bool b) {
+  pinThreads.store(b,std::memory_order_release);
+}
+bool NUMA::getPinThreads() {
+  return pinThreads.load(std::memory_order_acquire);
+}
+void NUMA::setInterleaveTables(bool b) {
+  interleaveTables.store(b,std::memory_order_release);
+}
+bool NUMA::getInterleaveTables() {
+  return interleaveTables.load(std::memory_order_acquire);
+}
+
+bool NUMA::pinCurrentThreadToNode(int idx) {
+#ifdef __linux__
+  const Topology& topology = getTopology();
+  if(topology.nodeIds.size() <= 0 || idx < 0)
+    return false;
+  const vector<int>& cpus = topology.cpusByNode[idx % topology.nodeIds.size()];
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  for(int cpu: cpus) {
+    if(cpu < CPU_SETSIZE)
+      CPU_SET(cpu,&cpuSet);
+  }
+  return sched_setaffinity(0, sizeof(cpuSet), &cpuSet) == 0;
+#else
+  (void)idx;
+  return false;
+#endif
+}
+
+void NUMA::maybePinCurrentThread(int idx) {
+  if(getPinThreads())
+    pinCurrentThreadToNode(idx);
+}
+
+bool NUMA::interleave(void* ptr, size_t bytes) {
+#ifdef __linux__
+  const Topology& topology = getTopology();
+  if(topology.nodeIds.size() <= 1 || ptr == NULL || bytes <= 0)
+    return false;
+  //Values from linux/mempolicy.h
+  const int MPOL_INTERLEAVE_MODE = 3;
+  const unsigned MPOL_MF_MOVE_FLAG = 1 << 1;
+  const int MAX_NODES = 1024;
+  const int BITS_PER_WORD = 8 * sizeof(unsigned long);
+  unsigned long nodeMask[MAX_NODES / BITS_PER_WORD] = {};
+  for(int node: topology.nodeIds) {
+    if(node < MAX_NODES)
+      nodeMask[node / BITS_PER_WORD] |= 1UL << (node % BITS_PER_WORD);
+  }
+  //mbind wants whole pages, and moves any other memory sharing the pages at the ends too, which is harmless
+  uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+  uintptr_t start = (uintptr_t)ptr & ~(pageSize-1);
+  uintptr_t end = ((uintptr_t)ptr + bytes + pageSize-1) & ~(pageSize-1);
+  long result = syscall(
+    SYS_mbind, (void*)start, (unsigned long)(end - start), MPOL_INTERLEAVE_MODE, nodeMask, (unsigned long)(MAX_NODES+1), MPOL_MF_MOVE_FLAG
+  );
+  return result == 0;
+#else
+  (void)ptr;
+  (void)bytes;
+  return false;
+#endif
+}
+
+void NUMA::maybeInterleave(void* ptr, size_t bytes) {
+  if(getInterleaveTables())
+    interleave(ptr,bytes);
+}
@@ -0,0 +1,33 @@
+#ifndef CORE_NUMA_H_
+#define CORE_NUMA_H_
+
+#include "../core/global.h"
+
+//Optional NUMA awareness, for machines with several sockets. Linux only, elsewhere there is always one node and
+//nothing is pinned or moved. Uses the kernel interfaces directly rather than libnuma, so there is nothing extra to link.
+namespace NUMA {
+  //Number of nodes with cpus, read once from sysfs, 1 if unknown
+  int getNumNodes();
+  //Nodes and their cpus and memory, for logging at startup
+  std::string getTopologyString();
+
+  //Process-wide settings, set at startup from the config, see Setup::initializeNNEvaluators
+  void setPinThreads(bool b);
+  bool getPinThreads();
+  void setInterleaveTables(bool b);
+  bool getInterleaveTables();
+
+  //Restrict the calling thread, and any threads it creates afterwards, to the cpus of node idx % getNumNodes(),
+  //so that memory it allocates and touches first is local to that node. Returns false if not possible.
+  bool pinCurrentThreadToNode(int idx);
+  //pinCurrentThreadToNode if getPinThreads()
+  void maybePinCurrentThread(int idx);
+
+  //Spread the pages of this memory round robin over all the nodes, moving those already allocated, so that a table
+  //accessed uniformly from every socket isn't all on one. Returns false if not possible or only one node.
+  bool interleave(void* ptr, size_t bytes);
+  //interleave if getInterleaveTables()
+  void maybeInterleave(void* ptr, size_t bytes);
+}
+
+#endif  // CORE_NUMA_H_
@@ -9,6 +9,8 @@
 #include "../core/global.h"
 #include "../core/multithread.h"
 
+#include <chrono>
+#include <deque>
 #include <queue>
 
 template<typename T>
@@ -20,6 +22,8 @@ class ThreadSafeContainer
   std::mutex mutex;
   std::condition_variable notEmptyCondVar;
   std::condition_variable notFullCondVar;
+  std::condition_variable sizeCondVar;
+  int numSizeWaiters;
 
   // Abstract methods to be implemented in derived classes
   virtual void pushUnsynchronized(T elt) = 0;
@@ -30,10 +34,10 @@ class ThreadSafeContainer
 
  public:
   inline ThreadSafeContainer()
-    :maxSize(0x7FFFFFFF),closed(false),readOnly(false),mutex(),notEmptyCondVar(),notFullCondVar()
+    :maxSize(0x7FFFFFFF),closed(false),readOnly(false),mutex(),notEmptyCondVar(),notFullCondVar(),sizeCondVar(),numSizeWaiters(0)
   {}
   inline ThreadSafeContainer(size_t maxSz)
-    :maxSize(maxSz),closed(false),readOnly(false),mutex(),notEmptyCondVar(),notFullCondVar()
+    :maxSize(maxSz),closed(false),readOnly(false),mutex(),notEmptyCondVar(),notFullCondVar(),sizeCondVar(),numSizeWaiters(0)
   {}
   inline ~ThreadSafeContainer()
   {}
@@ -70,6 +74,7 @@ class ThreadSafeContainer
     clearUnsynchronized();
     notFullCondVar.notify_all();
     notEmptyCondVar.notify_all();
+    sizeCondVar.notify_all();
   }
 
   // Set the queue to be read only.
@@ -80,6 +85,7 @@ class ThreadSafeContainer
     readOnly = true;
     notFullCondVar.notify_all();
     notEmptyCondVar.notify_all();
+    sizeCondVar.notify_all();
   }
 
   // Make the queue writable again.
@@ -100,6 +106,8 @@ class ThreadSafeContainer
     pushUnsynchronized(elt);
     if(sizeUnsynchronized() == 1)
       notEmptyCondVar.notify_all();
+    if(numSizeWaiters > 0)
+      sizeCondVar.notify_all();
     return true;
   }
 
@@ -113,6 +121,8 @@ class ThreadSafeContainer
     pushUnsynchronized(elt);
     if(sizeUnsynchronized() == 1)
       notEmptyCondVar.notify_all();
+    if(numSizeWaiters > 0)
+      sizeCondVar.notify_all();
     return true;
   }
 
@@ -171,6 +181,30 @@ class ThreadSafeContainer
     return true;
   }
 
+  // Wait until the queue has at least n elements or is closed or is readonly, but no longer than duration, and then
+  // pop and append up to n elements to buf.
+  // Returns the number of elements popped, which may be zero.
+  inline size_t waitPopUpToNFor(std::vector<T>& buf, size_t n, std::chrono::nanoseconds duration)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + duration;
+    numSizeWaiters++;
+    while(!closed && !readOnly && sizeUnsynchronized() < n) {
+      if(sizeCondVar.wait_until(lock,deadline) == std::cv_status::timeout)
+        break;
+    }
+    numSizeWaiters--;
+    if(closed)
+      return 0;
+    size_t size = sizeUnsynchronized();
+    size_t numToPop = std::min(size,n);
+    for(size_t i = 0; i<numToPop; i++)
+      buf.push_back(popUnsynchronized());
+    if(size >= maxSize && size < maxSize + n)
+      notFullCondVar.notify_all();
+    return numToPop;
+  }
+
 };
 
 
@@ -263,5 +297,77 @@ class ThreadSafePriorityQueue final : public ThreadSafeContainer<std::pair<KT,VT
 };
 
 
+//Elements are pairs of a lane index and a value, and each lane is FIFO. Will return elements from the LOWEST-numbered
+//nonempty lane first, except that once the head of a lane has been passed over for more than maxPassedOver elements
+//from lower-numbered lanes, it is returned next, so that no lane can be starved.
+template<typename VT>
+class ThreadSafeLaneQueue final : public ThreadSafeContainer<std::pair<int,VT> >
+{
+  typedef std::pair<int,VT> T;
+  std::vector<std::deque<VT>> lanes;
+  std::vector<int64_t> numPassedOver;
+  int64_t maxPassedOver;
+  size_t totalSize;
+
+ public:
+  inline ThreadSafeLaneQueue(int numLanes, int64_t maxPassedOvr):
+    ThreadSafeContainer<T>(), lanes(numLanes), numPassedOver(numLanes,0), maxPassedOver(maxPassedOvr), totalSize(0)
+  {}
+
+  //Not synchronized, only call while nothing else is using the queue
+  inline void setMaxPassedOver(int64_t n) {
+    maxPassedOver = n;
+  }
+
+  inline void pushUnsynchronized(T elt) override {
+    assert(elt.first >= 0 && elt.first < (int)lanes.size());
+    if(lanes[elt.first].empty())
+      numPassedOver[elt.first] = 0;
+    lanes[elt.first].push_back(elt.second);
+    totalSize++;
+  }
+  inline T popUnsynchronized() override {
+    int numLanes = (int)lanes.size();
+    int lane = -1;
+    for(int i = numLanes-1; i >= 0; i--) {
+      if(!lanes[i].empty() && numPassedOver[i] > maxPassedOver) {
+        lane = i;
+        break;
+      }
+    }
+    if(lane < 0) {
+      for(int i = 0; i < numLanes; i++) {
+        if(!lanes[i].empty()) {
+          lane = i;
+          break;
+        }
+      }
+    }
+    assert(lane >= 0);
+    for(int i = lane+1; i < numLanes; i++) {
+      if(!lanes[i].empty())
+        numPassedOver[i]++;
+    }
+    numPassedOver[lane] = 0;
+    T item = std::make_pair(lane,lanes[lane].front());
+    lanes[lane].pop_front();
+    totalSize--;
+    return item;
+  }
+
+  inline void clearUnsynchronized() override {
+    for(std::deque<VT>& lane: lanes)
+      lane.clear();
+    totalSize = 0;
+  }
+
+  inline size_t sizeUnsynchronized() override {
+    return totalSize;
+  }
+
+  inline bool empty() override {
+    return totalSize == 0;
+  }
+};
 
 #endif  // CORE_THREADSAFEQUEUE_H_
@@ -233,29 +233,6 @@ void TrainingWriteBuffers::clear() {
   curRows = 0;
 }
 
-//Copy floats that are all 0-1 into bits, packing 8 to a byte, big-endian-style within each byte.
-static void packBits(const float* binaryFloats, int len, uint8_t* bits) {
-  for(int i = 0; i < len; i += 8) {
-    if(i + 8 <= len) {
-      bits[i >> 3] =
-        ((uint8_t)binaryFloats[i + 0] << 7) |
-        ((uint8_t)binaryFloats[i + 1] << 6) |
-        ((uint8_t)binaryFloats[i + 2] << 5) |
-        ((uint8_t)binaryFloats[i + 3] << 4) |
-        ((uint8_t)binaryFloats[i + 4] << 3) |
-        ((uint8_t)binaryFloats[i + 5] << 2) |
-        ((uint8_t)binaryFloats[i + 6] << 1) |
-        ((uint8_t)binaryFloats[i + 7] << 0);
-    }
-    else {
-      bits[i >> 3] = 0;
-      for(int di = 0; i + di < len; di++) {
-        bits[i >> 3] |= ((uint8_t)binaryFloats[i + di] << (7-di));
-      }
-    }
-  }
-}
-
 static void zeroPolicyTarget(int policySize, int16_t* target) {
   for(int pos = 0; pos<policySize; pos++)
     target[pos] = 0;
@@ -446,7 +423,7 @@ void TrainingWriteBuffers::addRow(
     //Pack bools bitwise into uint8_t
     uint8_t* rowBinPacked = binaryInputNCHWPacked.data + curRows * numBinaryChannels * packedBoardArea;
     for(int c = 0; c<numBinaryChannels; c++)
-      packBits(rowBin + c * posArea, posArea, rowBinPacked + c * packedBoardArea);
+      NNInputs::packBinaryRow(rowBin + c * posArea, posArea, rowBinPacked + c * packedBoardArea);
   }
 
   //Vector for global targets and metadata
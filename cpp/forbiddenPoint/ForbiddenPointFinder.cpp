@@ -6,17 +6,21 @@
 //////////////////////////////////////////////////////////////////////
 
 #include "ForbiddenPointFinder.h"
+#include "../core/rand.h"
+#include "../core/test.h"
 #include <algorithm>
+#include <cassert>
+#include <vector>
 
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
 
-CForbiddenPointFinder::CForbiddenPointFinder() :f_boardsize(15)
+CForbiddenPointFinder::CForbiddenPointFinder() :f_boardsize(15), bCheckedExtension(false)
 {
 	Clear();
 }
-CForbiddenPointFinder::CForbiddenPointFinder(int size) : f_boardsize(size)
+CForbiddenPointFinder::CForbiddenPointFinder(int size) : f_boardsize(size), bCheckedExtension(false)
 {
 	Clear();
 }
@@ -1354,7 +1358,24 @@ bool CForbiddenPointFinder::isForbidden(int x, int y)
 
 }
 
+bool CForbiddenPointFinder::isForbidden(int x, int y, bool& onlyDependsOnLines)
+{
+	bCheckedExtension = false;
+	bool forbidden = isForbidden(x, y);
+	onlyDependsOnLines = !bCheckedExtension;
+	return forbidden;
+}
+
 bool CForbiddenPointFinder::isForbiddenNoNearbyCheck(int x, int y)
+{
+	if (cBoard[x+1][y+1] != C_EMPTY)
+		return false;
+	uint16_t pats[4];
+	GetLinePatterns(x + 1, y + 1, pats);
+	return IsForbiddenPattern(x + 1, y + 1, pats);
+}
+
+bool CForbiddenPointFinder::isForbiddenRecursive(int x, int y)
 {
 	if (IsDoubleThree(x, y) || IsDoubleFour(x, y) || IsOverline(x, y))
 	{
@@ -1362,3 +1383,283 @@ bool CForbiddenPointFinder::isForbiddenNoNearbyCheck(int x, int y)
 	}
 	return false;
 }
+
+//////////////////////////////////////////////////////////////////////
+// Pattern table
+//////////////////////////////////////////////////////////////////////
+//
+// Everything IsFive, IsOverline, IsFour and IsOpenFour look at in one direction lies within 5 points of the stone,
+// so for black they are precomputed for every content of the 10 points around it. The index has 2 bits per point,
+// 0 empty, 1 black, 2 white or wall, from offset -5 to +5 skipping the point itself.
+// What is left to do on the board is combining the 4 directions, and checking the point an open three extends to.
+
+namespace
+{
+	const int PAT_RADIUS = 5;
+	const int PAT_LEN = 2 * PAT_RADIUS + 1;
+	const int PAT_NUM = 1 << (4 * PAT_RADIUS);
+
+	const uint16_t PAT_FIVE = 1;		// exactly five in this direction
+	const uint16_t PAT_OVERLINE = 2;	// six or more
+	const uint16_t PAT_FOUR = 4;		// IsFour in this direction, without the checks of the other directions
+	const uint16_t PAT_OPENFOUR1 = 8;	// IsOpenFour == 1, likewise
+	const uint16_t PAT_OPENFOUR2 = 16;	// IsOpenFour == 2, likewise
+	// Distance to the first empty point on the left/right past the stones, if black playing there after this stone
+	// makes IsOpenFour == 1 in this direction, so this stone may make an open three. 0 if not.
+	const int PAT_THREE_L_SHIFT = 5;
+	const int PAT_THREE_R_SHIFT = 8;
+	const uint16_t PAT_THREE_MASK = 7;
+	const uint16_t PAT_THREE = (PAT_THREE_MASK << PAT_THREE_L_SHIFT) | (PAT_THREE_MASK << PAT_THREE_R_SHIFT);
+
+	const int dirX[4] = { 1, 0, 1, 1 };
+	const int dirY[4] = { 0, 1, 1, -1 };
+
+	// Black stone at the empty point p of the line, points outside of the line count as wall
+	struct LineInfo
+	{
+		int nLine;
+		int emptyL, emptyR;	// -1 if the stones end with white or wall
+		bool fiveL, fiveR;
+		int openFour;
+	};
+
+	int LineAt(const char* line, int i)
+	{
+		return (i < 0 || i >= PAT_LEN) ? 2 : line[i];
+	}
+
+	int LineRun(const char* line, int p)
+	{
+		int nLine = 1;
+		for (int i = p - 1; LineAt(line, i) == 1; i--)
+			nLine++;
+		for (int i = p + 1; LineAt(line, i) == 1; i++)
+			nLine++;
+		return nLine;
+	}
+
+	bool LineFive(char* line, int p)
+	{
+		line[p] = 1;
+		bool five = LineRun(line, p) == 5;
+		line[p] = 0;
+		return five;
+	}
+
+	LineInfo AnalyzeLine(char* line, int p)
+	{
+		LineInfo info;
+		line[p] = 1;
+		info.nLine = LineRun(line, p);
+		int i = p - 1;
+		while (LineAt(line, i) == 1)
+			i--;
+		info.emptyL = LineAt(line, i) == 0 ? i : -1;
+		i = p + 1;
+		while (LineAt(line, i) == 1)
+			i++;
+		info.emptyR = LineAt(line, i) == 0 ? i : -1;
+		info.fiveL = info.emptyL >= 0 && LineFive(line, info.emptyL);
+		info.fiveR = info.emptyR >= 0 && LineFive(line, info.emptyR);
+		info.openFour = (info.fiveL && info.fiveR) ? (info.nLine == 4 ? 1 : 2) : 0;
+		line[p] = 0;
+		return info;
+	}
+
+	uint16_t ComputePattern(char* line)
+	{
+		const int p = PAT_RADIUS;
+		LineInfo info = AnalyzeLine(line, p);
+		uint16_t pat = 0;
+		if (info.nLine == 5)
+			pat |= PAT_FIVE;
+		if (info.nLine >= 6)
+			pat |= PAT_OVERLINE;
+		if (info.fiveL || info.fiveR)
+			pat |= PAT_FOUR;
+		if (info.openFour == 1)
+			pat |= PAT_OPENFOUR1;
+		if (info.openFour == 2)
+			pat |= PAT_OPENFOUR2;
+
+		line[p] = 1;
+		if (info.emptyL >= 0 && AnalyzeLine(line, info.emptyL).openFour == 1)
+			pat |= (uint16_t)(p - info.emptyL) << PAT_THREE_L_SHIFT;
+		if (info.emptyR >= 0 && AnalyzeLine(line, info.emptyR).openFour == 1)
+			pat |= (uint16_t)(info.emptyR - p) << PAT_THREE_R_SHIFT;
+		line[p] = 0;
+		return pat;
+	}
+
+	struct PatternTable
+	{
+		std::vector<uint16_t> pats;
+		PatternTable() : pats(PAT_NUM, 0)
+		{
+			char line[PAT_LEN];
+			for (int key = 0; key < PAT_NUM; key++)
+			{
+				bool valid = true;
+				for (int i = 0, k = 0; i < PAT_LEN; i++)
+				{
+					if (i == PAT_RADIUS)
+					{
+						line[i] = 0;
+						continue;
+					}
+					line[i] = (char)((key >> (2 * k)) & 3);
+					valid = valid && line[i] != 3;
+					k++;
+				}
+				if (valid)
+					pats[key] = ComputePattern(line);
+			}
+		}
+	};
+
+	const std::vector<uint16_t>& GetPatternTable()
+	{
+		static const PatternTable table;
+		return table.pats;
+	}
+}
+
+void CForbiddenPointFinder::GetLinePatterns(int x, int y, uint16_t pats[4])
+{
+	const std::vector<uint16_t>& table = GetPatternTable();
+	for (int d = 0; d < 4; d++)
+	{
+		uint32_t key = 0;
+		int k = 0;
+		for (int i = -PAT_RADIUS; i <= PAT_RADIUS; i++)
+		{
+			if (i == 0)
+				continue;
+			int xx = x + i * dirX[d];
+			int yy = y + i * dirY[d];
+			uint32_t c = 2;
+			if (xx >= 0 && xx <= f_boardsize + 1 && yy >= 0 && yy <= f_boardsize + 1)
+			{
+				char s = cBoard[xx][yy];
+				c = (s == C_EMPTY) ? 0 : (s == C_BLACK) ? 1 : 2;
+			}
+			key |= c << (2 * k);
+			k++;
+		}
+		pats[d] = table[key];
+	}
+}
+
+// Same as IsDoubleThree || IsDoubleFour || IsOverline for the empty point (x,y)
+bool CForbiddenPointFinder::IsForbiddenPattern(int x, int y, const uint16_t pats[4])
+{
+	for (int d = 0; d < 4; d++)
+		if (pats[d] & PAT_FIVE)
+			return false;
+	for (int d = 0; d < 4; d++)
+		if (pats[d] & PAT_OVERLINE)
+			return true;
+
+	int nFour = 0;
+	for (int d = 0; d < 4; d++)
+	{
+		if (pats[d] & PAT_OPENFOUR2)
+			nFour += 2;
+		else if (pats[d] & PAT_FOUR)
+			nFour++;
+	}
+	if (nFour >= 2)
+		return true;
+
+	return IsDoubleThreePattern(x, y, pats);
+}
+
+// IsDoubleThree for the empty point (x,y) that makes neither five nor overline
+bool CForbiddenPointFinder::IsDoubleThreePattern(int x, int y, const uint16_t pats[4])
+{
+	int nCandidate = 0;
+	for (int d = 0; d < 4; d++)
+		if (pats[d] & PAT_THREE)
+			nCandidate++;
+	if (nCandidate < 2)
+		return false;
+
+	bCheckedExtension = true;
+	cBoard[x][y] = C_BLACK;
+	int nThree = 0;
+	for (int d = 0; d < 4 && nThree < 2 && nThree + nCandidate >= 2; d++)
+	{
+		if (!(pats[d] & PAT_THREE))
+			continue;
+		nCandidate--;
+		int distL = (pats[d] >> PAT_THREE_L_SHIFT) & PAT_THREE_MASK;
+		int distR = (pats[d] >> PAT_THREE_R_SHIFT) & PAT_THREE_MASK;
+		if ((distL != 0 && IsOpenThreeExtension(x - distL * dirX[d], y - distL * dirY[d], d)) ||
+			(distR != 0 && IsOpenThreeExtension(x + distR * dirX[d], y + distR * dirY[d], d)))
+			nThree++;
+	}
+	cBoard[x][y] = C_EMPTY;
+	return nThree >= 2;
+}
+
+// Whether the four black makes at (x,y) in direction d counts for an open three, the table has already found
+// that it is an open four in that line. Same as IsOpenFour == 1 && !IsDoubleFour && !IsDoubleThree.
+bool CForbiddenPointFinder::IsOpenThreeExtension(int x, int y, int d)
+{
+	uint16_t pats[4];
+	GetLinePatterns(x, y, pats);
+	(void)d;
+	assert(pats[d] & PAT_OPENFOUR1);
+	for (int i = 0; i < 4; i++)
+		if (pats[i] & (PAT_FIVE | PAT_OVERLINE))
+			return false;
+
+	int nFour = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		if (pats[i] & PAT_OPENFOUR2)
+			nFour += 2;
+		else if (pats[i] & PAT_FOUR)
+			nFour++;
+	}
+	if (nFour >= 2)
+		return false;
+
+	return !IsDoubleThreePattern(x, y, pats);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Tests
+//////////////////////////////////////////////////////////////////////
+
+void CForbiddenPointFinder::runTests()
+{
+	Rand rand("ForbiddenPointFinder::runTests");
+	int numForbidden = 0;
+	for (int rep = 0; rep < 3000; rep++)
+	{
+		int size = rep % 3 == 0 ? 15 : rep % 3 == 1 ? COMPILE_MAX_BOARD_LEN : 9;
+		CForbiddenPointFinder fpf(size);
+		//Dense clusters of stones, mostly black, so that plenty of threes, fours and overlines cross each other
+		int numStones = 10 + (int)rand.nextUInt(size * size / 3);
+		int clusterSize = 4 + (int)rand.nextUInt(size - 3);
+		int x0 = (int)rand.nextUInt(size - clusterSize + 1), y0 = (int)rand.nextUInt(size - clusterSize + 1);
+		for (int i = 0; i < numStones; i++)
+		{
+			int x = x0 + (int)rand.nextUInt(clusterSize), y = y0 + (int)rand.nextUInt(clusterSize);
+			fpf.SetStone(x, y, rand.nextUInt(3) == 0 ? C_WHITE : C_BLACK);
+		}
+		for (int y = 0; y < size; y++)
+			for (int x = 0; x < size; x++)
+			{
+				if (fpf.cBoard[x + 1][y + 1] != C_EMPTY)
+					continue;
+				bool forbidden = fpf.isForbiddenRecursive(x, y);
+				testAssert(fpf.isForbiddenNoNearbyCheck(x, y) == forbidden);
+				testAssert(fpf.isForbidden(x, y) == forbidden);
+				if (forbidden)
+					numForbidden++;
+			}
+	}
+	testAssert(numForbidden > 1000);
+}
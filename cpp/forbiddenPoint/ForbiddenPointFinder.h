@@ -25,7 +25,13 @@ public:
 	void Clear();
 	//int  AddStone(int x, int y, char cStone);
 	bool isForbidden(int x, int y);
+	//Also tells whether the result only depends on the points within distance 5 of (x,y) along its 4 lines, so it stays valid
+	//as long as none of them change. Otherwise some open three had to be followed to the point it extends to.
+	bool isForbidden(int x, int y, bool& onlyDependsOnLines);
+	//Looks up each line through (x,y) in a precomputed pattern table, and only recurses to check the four made by an open three
 	bool isForbiddenNoNearbyCheck(int x, int y);
+	//The same result from IsDoubleThree, IsDoubleFour and IsOverline directly, which recurse on every three. Slow, for testing.
+	bool isForbiddenRecursive(int x, int y);
 	void SetStone(int x, int y, char cStone);
 	bool IsFive(int x, int y, int nColor);
 	bool IsOverline(int x, int y);
@@ -36,5 +42,15 @@ public:
 	bool IsDoubleFour(int x, int y);
 	bool IsDoubleThree(int x, int y);
 
+	//Compares the pattern table against the recursive check on random positions
+	static void runTests();
+
+private:
+	bool bCheckedExtension;	// Set once IsDoubleThreePattern has to look past the lines of the point
+	//Pattern of each of the 4 lines through (x,y), with x and y in cBoard coordinates, see ForbiddenPointFinder.cpp
+	void GetLinePatterns(int x, int y, uint16_t pats[4]);
+	bool IsForbiddenPattern(int x, int y, const uint16_t pats[4]);
+	bool IsDoubleThreePattern(int x, int y, const uint16_t pats[4]);
+	bool IsOpenThreeExtension(int x, int y, int d);
 };
 #endif // !defined(FORBIDDENPOINTFINDER_H_INCLUDED_)
\ No newline at end of file
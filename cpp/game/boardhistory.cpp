@@ -294,7 +294,16 @@ Hash128 BoardHistory::getSituationRulesHash(
   Player nextPlayer 
   )
 {
-  Hash128 hash = board.pos_hash;
+  return getSituationRulesHash(board.pos_hash, hist, nextPlayer);
+}
+
+Hash128 BoardHistory::getSituationRulesHash(
+  Hash128 posHash,
+  const BoardHistory& hist,
+  Player nextPlayer
+  )
+{
+  Hash128 hash = posHash;
   hash ^= Board::ZOBRIST_PLAYER_HASH[nextPlayer];
 
   float selfKomi = hist.currentSelfKomi(nextPlayer);
@@ -101,6 +101,8 @@ struct BoardHistory {
 
   //Compute a hash that takes into account the full situation, the rules, discretized komi, and any immediate ko prohibitions.
   static Hash128 getSituationRulesHash(const Board& board, const BoardHistory& hist, Player nextPlayer);
+  //Same, with the position hash of the board given separately, such as for the board transformed by a symmetry
+  static Hash128 getSituationRulesHash(Hash128 posHash, const BoardHistory& hist, Player nextPlayer);
 
 
   private:
@@ -420,5 +420,8 @@ void GameLogic::ResultsBeforeNN::init(const Board& board, const BoardHistory& hi
     myOnlyLoc = myvcfloc;
     return;
   }
+
+  if(oppVCFresult == 1)
+    VCFsolver::findDefence(board, hist.rules, nextPlayer, myDefenceLocs);
 #endif
 }
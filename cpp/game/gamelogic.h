@@ -44,6 +44,8 @@ namespace GameLogic {
     Loc myOnlyLoc;
     uint8_t myVCFresult;
     uint8_t oppVCFresult;
+    //If the opponent has a VCF, all the moves that refute it, the other moves lose. Empty if unknown.
+    std::vector<Loc> myDefenceLocs;
     ResultsBeforeNN();
     void init(const Board& board, const BoardHistory& hist, Color nextPlayer);
   };
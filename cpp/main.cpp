@@ -55,11 +55,11 @@ evalsgf : Utility/debug tool, analyze a single position of a game from an SGF fi
 
 testgpuerror : Print the average error of the neural net between current config and fp32 config.
 
+runtests : Test important board algorithms and datastructures
 
 )%%" << endl;
 }
 /*
-runtests : Test important board algorithms and datastructures
 runnnlayertests : Test a few subcomponents of the current neural net backend
 
 runnnontinyboardtest : Run neural net on a tiny board and dump result to stdout
@@ -104,9 +104,9 @@ static int handleSubcommand(const string& subcommand, const vector<string>& args
     return MainCmds::selfplay(subArgs);
   else if(subcommand == "testgpuerror")
     return MainCmds::testgpuerror(subArgs);
-  /*
   else if(subcommand == "runtests")
     return MainCmds::runtests(subArgs);
+  /*
   else if(subcommand == "runnnlayertests")
     return MainCmds::runnnlayertests(subArgs);
   else if(subcommand == "runnnontinyboardtest")
@@ -14,8 +14,8 @@ namespace MainCmds {
   int selfplay(const std::vector<std::string>& args);
 
   int testgpuerror(const std::vector<std::string>& args);
-  /*
   int runtests(const std::vector<std::string>& args);
+  /*
   int runnnlayertests(const std::vector<std::string>& args);
   int runnnontinyboardtest(const std::vector<std::string>& args);
   int runnnsymmetriestest(const std::vector<std::string>& args);
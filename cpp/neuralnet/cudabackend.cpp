@@ -2284,6 +2284,7 @@ ComputeContext* NeuralNet::createComputeContext(
   const string& openCLTunerFile,
   const string& homeDataDirOverride,
   bool openCLReTunePerBoardSize,
+  int numEigenIntraOpThreads,
   enabled_t useFP16Mode,
   enabled_t useNHWCMode,
   const LoadedModel* loadedModel
@@ -2293,6 +2294,7 @@ ComputeContext* NeuralNet::createComputeContext(
   (void)openCLTunerFile;
   (void)homeDataDirOverride;
   (void)openCLReTunePerBoardSize;
+  (void)numEigenIntraOpThreads;
   (void)loadedModel;
 
   ComputeContext* context = new ComputeContext();
@@ -2602,7 +2604,7 @@ void NeuralNet::getOutput(
     float* rowMetaInput = inputBuffers->userInputMetaBuffer + (inputBuffers->singleInputMetaElts * nIdx);
 
     const float* rowGlobal = inputBufs[nIdx]->rowGlobalBuf.data();
-    const float* rowSpatial = inputBufs[nIdx]->rowSpatialBuf.data();
+    const uint8_t* rowSpatial = inputBufs[nIdx]->rowSpatialPackedBuf.data();
     const float* rowMeta = inputBufs[nIdx]->rowMetaBuf.data();
     bool hasRowMeta = inputBufs[nIdx]->hasRowMeta;
     std::copy(rowGlobal,rowGlobal+numGlobalFeatures,rowGlobalInput);
@@ -2614,7 +2616,7 @@ void NeuralNet::getOutput(
     else {
       testAssert(!hasRowMeta);
     }
-    SymmetryHelpers::copyInputsWithSymmetry(rowSpatial, rowSpatialInput, 1, nnYLen, nnXLen, numSpatialFeatures, gpuHandle->inputsUseNHWC, inputBufs[nIdx]->symmetry);
+    SymmetryHelpers::copyPackedInputsWithSymmetry(rowSpatial, rowSpatialInput, 1, nnYLen, nnXLen, numSpatialFeatures, gpuHandle->inputsUseNHWC, inputBufs[nIdx]->symmetry);
   }
 
   Buffers* buffers = gpuHandle->buffers.get();
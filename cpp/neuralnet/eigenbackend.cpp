@@ -5,8 +5,8 @@
  * Only supports float32 computation with NHWC memory layout (at runtime and as input).
  */
 
-//TODO someday - not sure how to make thread pool work with TensorMap. It works with Tensor, but TensorMap doesn't seem to have a device(...) method.
-//#define EIGEN_USE_THREADS
+//Eigen's ThreadPoolDevice doesn't work with TensorMap, which doesn't have a device(...) method, so instead the handle keeps
+//its own helper threads and the convolutions and batch norms split their work between them, see ComputeHandleInternal.
 
 #include "../neuralnet/nninterface.h"
 
@@ -18,10 +18,15 @@
 #include "../neuralnet/nninputs.h"
 #include "../neuralnet/nneval.h"
 #include "../neuralnet/activations.h"
+#include "../neuralnet/nnprofiler.h"
 
 #include "../core/simpleallocator.h"
 #include "../core/test.h"
 
+#include <condition_variable>
+#include <functional>
+#include <thread>
+
 using namespace std;
 using Eigen::Tensor;
 using Eigen::TensorMap;
@@ -178,6 +183,31 @@ static size_t roundUpToMultiple(size_t size, size_t ofThis) {
   return (size + ofThis - 1) / ofThis * ofThis;
 }
 
+template <typename Expr>
+static void assignActivated(Eigen::Map<Eigen::ArrayXf>& out, const Expr& x, int activation) {
+  if(activation == ACTIVATION_IDENTITY)
+    out = x;
+  else if(activation == ACTIVATION_RELU)
+    out = x.cwiseMax(0.0f);
+  else if(activation == ACTIVATION_MISH)
+    out = x * (x.cwiseMin(20.0f).exp().log1p() + (x.cwiseMax(20.0f) - 20.0f)).tanh();
+  else if(activation == ACTIVATION_MISH_SCALE8)
+    testAssert(false); // Eigen does not use scaled mish activations due to no fp16
+  else
+    testAssert(false);
+}
+
+// The channels of a single position, out = activation(in * scale + bias). scale can be NULL for none, in can equal out.
+static void applyNormAct(const float* in, float* out, const float* scale, const float* bias, int numChannels, int activation) {
+  Eigen::Map<const Eigen::ArrayXf> inMap(in, numChannels);
+  Eigen::Map<const Eigen::ArrayXf> biasMap(bias, numChannels);
+  Eigen::Map<Eigen::ArrayXf> outMap(out, numChannels);
+  if(scale == NULL)
+    assignActivated(outMap, inMap + biasMap, activation);
+  else
+    assignActivated(outMap, inMap * Eigen::Map<const Eigen::ArrayXf>(scale, numChannels) + biasMap, activation);
+}
+
 // --------------------------------------------------------------------------------------------------------------
 
 struct Model;
@@ -185,6 +215,7 @@ struct Model;
 struct ComputeContext {
   const int nnXLen;
   const int nnYLen;
+  const int numIntraOpThreads;
 
   std::mutex cachedModelsMutex;
   std::map<std::string,std::shared_ptr<const Model>> cachedModels;
@@ -194,9 +225,10 @@ struct ComputeContext {
   ComputeContext(const ComputeContext&) = delete;
   ComputeContext& operator=(const ComputeContext&) = delete;
 
-  ComputeContext(int nnX, int nnY)
+  ComputeContext(int nnX, int nnY, int numIntraOp)
     : nnXLen(nnX),
       nnYLen(nnY),
+      numIntraOpThreads(numIntraOp),
       cachedModelsMutex(),
       cachedModels(),
       cachedModelsRefCount()
@@ -211,18 +243,138 @@ struct ComputeContext {
 // --------------------------------------------------------------------------------------------------------------
 
 struct ComputeHandleInternal {
-  //static constexpr int numEigenThreads = 2;
-  //Eigen::ThreadPool threadPool;
-  //Eigen::ThreadPoolDevice device;
-
   const int nnXLen;
   const int nnYLen;
 
+  //The larger layers split their work between the server thread that owns this handle and numIntraOpThreads-1 helper threads,
+  //see parallelFor. This lowers the latency of each batch, at the cost of cores that could otherwise evaluate other batches.
+  const int numIntraOpThreads;
+  //Scratch for one winograd tile, per thread
+  vector<vector<float>> tileBufs;
+
+  std::mutex workMutex;
+  std::condition_variable workReady;
+  std::condition_variable workDone;
+  const std::function<void(int,int,int)>* work;
+  int workSize;
+  int numWorkChunks;
+  int numWorkChunksRemaining;
+  std::atomic<uint64_t> workGeneration;
+  std::atomic<bool> shuttingDown;
+  vector<std::thread> helperThreads;
+
+  ComputeHandleInternal() = delete;
+  ComputeHandleInternal(const ComputeHandleInternal&) = delete;
+  ComputeHandleInternal& operator=(const ComputeHandleInternal&) = delete;
+
   ComputeHandleInternal(const ComputeContext* ctx)
     :
     nnXLen(ctx->nnXLen),
-    nnYLen(ctx->nnYLen)
-  {}
+    nnYLen(ctx->nnYLen),
+    numIntraOpThreads(std::max(1,ctx->numIntraOpThreads)),
+    tileBufs(numIntraOpThreads),
+    workMutex(),
+    workReady(),
+    workDone(),
+    work(NULL),
+    workSize(0),
+    numWorkChunks(0),
+    numWorkChunksRemaining(0),
+    workGeneration(0),
+    shuttingDown(false),
+    helperThreads()
+  {
+    for(int threadIdx = 1; threadIdx < numIntraOpThreads; threadIdx++)
+      helperThreads.push_back(std::thread(&ComputeHandleInternal::helperLoop, this, threadIdx));
+  }
+
+  ~ComputeHandleInternal() {
+    {
+      std::lock_guard<std::mutex> lock(workMutex);
+      shuttingDown.store(true, std::memory_order_release);
+    }
+    workReady.notify_all();
+    for(std::thread& thread: helperThreads)
+      thread.join();
+  }
+
+  void ensureTileBufs(size_t eltsPerThread) {
+    for(vector<float>& buf: tileBufs) {
+      if(buf.size() < eltsPerThread)
+        buf.resize(eltsPerThread);
+    }
+  }
+
+  static int chunkStart(int n, int numChunks, int chunkIdx) {
+    return (int)((int64_t)n * chunkIdx / numChunks);
+  }
+
+  //Calls f(begin,end,threadIdx) on contiguous chunks covering [0,n), one chunk per thread, and returns once all of them are done.
+  //The calling thread runs the first chunk itself. Not reentrant, f must not call parallelFor.
+  void parallelFor(int n, const std::function<void(int,int,int)>& f) {
+    int numChunks = std::min(n, numIntraOpThreads);
+    if(numChunks <= 1) {
+      if(n > 0)
+        f(0,n,0);
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(workMutex);
+      work = &f;
+      workSize = n;
+      numWorkChunks = numChunks;
+      numWorkChunksRemaining = numChunks-1;
+      workGeneration.fetch_add(1, std::memory_order_release);
+    }
+    workReady.notify_all();
+
+    f(0, chunkStart(n,numChunks,1), 0);
+
+    std::unique_lock<std::mutex> lock(workMutex);
+    while(numWorkChunksRemaining > 0)
+      workDone.wait(lock);
+    work = NULL;
+  }
+
+  void helperLoop(int threadIdx) {
+    uint64_t seenGeneration = 0;
+    while(true) {
+      //Layers follow each other closely within a batch, so spin for a little while before going to sleep
+      for(int spin = 0; spin < 2000; spin++) {
+        if(workGeneration.load(std::memory_order_acquire) != seenGeneration || shuttingDown.load(std::memory_order_acquire))
+          break;
+        std::this_thread::yield();
+      }
+
+      const std::function<void(int,int,int)>* f;
+      int n;
+      int numChunks;
+      {
+        std::unique_lock<std::mutex> lock(workMutex);
+        while(!shuttingDown.load(std::memory_order_acquire) && workGeneration.load(std::memory_order_acquire) == seenGeneration)
+          workReady.wait(lock);
+        if(shuttingDown.load(std::memory_order_acquire))
+          return;
+        seenGeneration = workGeneration.load(std::memory_order_acquire);
+        if(threadIdx >= numWorkChunks)
+          continue;
+        f = work;
+        n = workSize;
+        numChunks = numWorkChunks;
+      }
+
+      (*f)(chunkStart(n,numChunks,threadIdx), chunkStart(n,numChunks,threadIdx+1), threadIdx);
+
+      bool allDone;
+      {
+        std::lock_guard<std::mutex> lock(workMutex);
+        numWorkChunksRemaining -= 1;
+        allDone = numWorkChunksRemaining == 0;
+      }
+      if(allDone)
+        workDone.notify_one();
+    }
+  }
 };
 
 
@@ -287,11 +439,49 @@ struct ConvLayer {
   int inTileXYSize;
   int outTileXYSize;
 
+  //Convs are profiled by kernel size, since that decides which of the implementations below they use
+  string profileCategory;
+
+  //Batch norm and activation of the input, applied while gathering the winograd input tiles instead of as a separate pass
+  //over the input, see canFuseInputNormAct.
+  bool hasInputNormAct;
+  vector<float> inputScale;
+  vector<float> inputBias;
+  int inputActivation;
+  //Batch norm and activation of the output. The scale is folded into the weights, the bias and activation are applied
+  //when writing the output.
+  bool hasOutputNormAct;
+  vector<float> outputBias;
+  int outputActivation;
+
   ConvLayer() = delete;
   ConvLayer(const ConvLayer&) = delete;
   ConvLayer& operator=(const ConvLayer&) = delete;
 
   ConvLayer(const ConvLayerDesc& desc, int nnX, int nnY)
+    : ConvLayer(desc,nnX,nnY,NULL,NULL,NULL,NULL)
+  {}
+
+  //The winograd input tiles overlap, so the norm of each input position gets recomputed for every tile that includes it,
+  //2.25 times on average for 3x3 convs. That's cheaper than a separate pass over the input, but not for mish, whose
+  //transcendentals cost more than the pass saves.
+  static bool canFuseInputNormAct(const ConvLayerDesc& desc, const ActivationLayerDesc& actDesc) {
+    return desc.convXSize == 3 && desc.convYSize == 3 && desc.dilationX == 1 && desc.dilationY == 1 &&
+      (actDesc.activation == ACTIVATION_IDENTITY || actDesc.activation == ACTIVATION_RELU);
+  }
+
+  //inputNormDesc and inputActDesc, if not NULL, are the batch norm and activation that this conv's input should go through
+  //first, which requires canFuseInputNormAct. outputNormDesc and outputActDesc, if not NULL, are the batch norm and activation
+  //that the output should go through. Inputs and outputs are masked as BatchNormLayer would.
+  ConvLayer(
+    const ConvLayerDesc& desc,
+    int nnX,
+    int nnY,
+    const BatchNormLayerDesc* inputNormDesc,
+    const ActivationLayerDesc* inputActDesc,
+    const BatchNormLayerDesc* outputNormDesc,
+    const ActivationLayerDesc* outputActDesc
+  )
     : name(desc.name),
       convYSize(desc.convYSize),
       convXSize(desc.convXSize),
@@ -310,6 +500,33 @@ struct ConvLayer {
     assert(convXSize % 2 == 1);
     assert(convYSize % 2 == 1);
 
+    profileCategory = Global::strprintf("conv%dx%d",convYSize,convXSize);
+
+    hasInputNormAct = inputNormDesc != NULL;
+    inputActivation = ACTIVATION_IDENTITY;
+    if(hasInputNormAct) {
+      testAssert(inputActDesc != NULL && canFuseInputNormAct(desc,*inputActDesc));
+      testAssert(inputNormDesc->numChannels == inChannels);
+      inputScale = inputNormDesc->mergedScale;
+      inputBias = inputNormDesc->mergedBias;
+      inputActivation = inputActDesc->activation;
+    }
+
+    vector<float> weights = desc.weights;
+    hasOutputNormAct = outputNormDesc != NULL;
+    outputActivation = ACTIVATION_IDENTITY;
+    if(hasOutputNormAct) {
+      testAssert(outputActDesc != NULL);
+      testAssert(outputNormDesc->numChannels == outChannels);
+      const int weightsPerOutChannel = inChannels * convYSize * convXSize;
+      for(int oc = 0; oc < outChannels; oc++) {
+        for(int i = 0; i < weightsPerOutChannel; i++)
+          weights[oc * weightsPerOutChannel + i] *= outputNormDesc->mergedScale[oc];
+      }
+      outputBias = outputNormDesc->mergedBias;
+      outputActivation = outputActDesc->activation;
+    }
+
     if((convXSize == 3 && convYSize == 3) || (convXSize == 5 && convYSize == 5)) {
       imagePatchSize = 0; //not used in this branch
 
@@ -353,7 +570,7 @@ struct ConvLayer {
           for(int subY = 0; subY < convYSize; subY++) {
             for(int subX = 0; subX < convXSize; subX++) {
               if(oc < outChannels && ic < inChannels)
-                tmp[subY][subX] = desc.weights[((oc * inChannels + ic) * convYSize + subY) * convXSize + subX];
+                tmp[subY][subX] = weights[((oc * inChannels + ic) * convYSize + subY) * convXSize + subX];
               else
                 tmp[subY][subX] = 0.0f;
             }
@@ -395,7 +612,7 @@ struct ConvLayer {
       inTileXYSize = 0; //not used in this branch
       outTileXYSize = 0; //not used in this branch
 
-      TENSOR4 kernel = TensorMap<const Tensor<const SCALAR, 4>>(desc.weights.data(), convXSize, convYSize, inChannels, outChannels);
+      TENSOR4 kernel = TensorMap<const Tensor<const SCALAR, 4>>(weights.data(), convXSize, convYSize, inChannels, outChannels);
       imagePatchSize = convXSize * convYSize * inChannels;
       Eigen::array<Eigen::Index, 4> dimensionPermutatation = {3, 2, 0, 1};
       Eigen::array<Eigen::Index, 2> newShape = {outChannels, imagePatchSize};
@@ -409,14 +626,22 @@ struct ConvLayer {
       constexpr int inTileYSize = 6;
       size_t totalChannelsRounded = roundUpToMultiple(inChannels,32) + roundUpToMultiple(outChannels,32);
       size_t sizeForTransforms = totalChannelsRounded * maxBatchSize * numTilesY * numTilesX * inTileXSize * inTileYSize;
-      size_t sizeForTileBufs = 2 * inTileXSize * inTileYSize * roundUpToMultiple(std::max(inChannels,outChannels),32);
-      return sizeForTransforms + sizeForTileBufs;
+      return sizeForTransforms;
     }
     return 0;
   }
 
-  void apply(ComputeHandleInternal* handle, CONSTTENSORMAP4* input, TENSORMAP4* output, float* convWorkspace, bool accumulate) const {
-    (void)handle;
+  // Mask should be in 'NHW' format (no "C" channel), it's only used if there's a norm to apply to the input or the output.
+  void apply(
+    ComputeHandleInternal* handle,
+    CONSTTENSORMAP4* input,
+    TENSORMAP4* output,
+    CONSTTENSORMAP3* mask,
+    float* convWorkspace,
+    bool accumulate
+  ) const {
+    NNProfiler::Section section(profileCategory.c_str(),name.c_str());
+    assert(!(hasOutputNormAct && accumulate));
     assert(output->dimension(0) == outChannels);
     assert(input->dimension(0) == inChannels);
     assert(input->dimension(1) == nnXLen);
@@ -431,96 +656,104 @@ struct ConvLayer {
       const int outTileXSize = convXSize == 5 ? 2 : 4;
       const int outTileYSize = convYSize == 5 ? 2 : 4;
 
-      float* tile = convWorkspace;
-      float* tile2 = tile + inTileXSize * inTileYSize * roundUpToMultiple(std::max(inChannels,outChannels),32);
-      float* convWorkspaceIn = tile2 + inTileXSize * inTileYSize * roundUpToMultiple(std::max(inChannels,outChannels),32);
+      const int numTiles = batchSize * numTilesY * numTilesX;
+      handle->ensureTileBufs(inTileXSize * inTileYSize * roundUpToMultiple(std::max(inChannels,outChannels),32));
+
+      float* convWorkspaceIn = convWorkspace;
       float* convWorkspaceOut = convWorkspaceIn + roundUpToMultiple(inChannels,32) * batchSize * numTilesY * numTilesX * inTileXSize * inTileYSize;
       TENSORMAP3 transformedInput(convWorkspaceIn, inChannels, batchSize * numTilesY * numTilesX, inTileXSize * inTileYSize);
       TENSORMAP3 transformedOutput(convWorkspaceOut, outChannels, batchSize * numTilesY * numTilesX, inTileXSize * inTileYSize);
-      for(int n = 0; n < batchSize; n++) {
-        for(int yTile = 0; yTile < numTilesY; yTile++) {
-          for(int xTile = 0; xTile < numTilesX; xTile++) {
-            for(int dy = 0; dy < inTileYSize; dy++) {
-              for(int dx = 0; dx < inTileXSize; dx++) {
-                int x = xTile*outTileXSize+dx+inTileXOffset;
-                int y = yTile*outTileYSize+dy+inTileYOffset;
-                int subTileIdx = dy * inTileXSize + dx;
-                if(x < 0 || y < 0 || x >= nnXLen || y >= nnYLen) {
+      handle->parallelFor(numTiles, [&](int tileBegin, int tileEnd, int threadIdx) {
+        float* tile = handle->tileBufs[threadIdx].data();
+        for(int batchTileXTileY = tileBegin; batchTileXTileY < tileEnd; batchTileXTileY++) {
+          const int n = batchTileXTileY / (numTilesY * numTilesX);
+          const int yTile = (batchTileXTileY / numTilesX) % numTilesY;
+          const int xTile = batchTileXTileY % numTilesX;
+          for(int dy = 0; dy < inTileYSize; dy++) {
+            for(int dx = 0; dx < inTileXSize; dx++) {
+              int x = xTile*outTileXSize+dx+inTileXOffset;
+              int y = yTile*outTileYSize+dy+inTileYOffset;
+              int subTileIdx = dy * inTileXSize + dx;
+              if(x < 0 || y < 0 || x >= nnXLen || y >= nnYLen) {
+                std::fill(tile + subTileIdx * inChannels, tile + (subTileIdx+1) * inChannels, 0.0f);
+              }
+              else if(hasInputNormAct) {
+                if((*mask)(x,y,n) != 1.0f)
                   std::fill(tile + subTileIdx * inChannels, tile + (subTileIdx+1) * inChannels, 0.0f);
-                }
-                else {
-                  for(int ic = 0; ic < inChannels; ic++) {
-                    float z = (*input)(ic,x,y,n);
-                    tile[subTileIdx * inChannels + ic] = z;
-                  }
+                else
+                  applyNormAct(&(*input)(0,x,y,n), tile + subTileIdx * inChannels, inputScale.data(), inputBias.data(), inChannels, inputActivation);
+              }
+              else {
+                for(int ic = 0; ic < inChannels; ic++) {
+                  float z = (*input)(ic,x,y,n);
+                  tile[subTileIdx * inChannels + ic] = z;
                 }
               }
             }
+          }
 
-            for(int subY = 0; subY < inTileYSize; subY++) {
-              float* __restrict t0 = &tile[(subY*inTileXSize+0)*inChannels];
-              float* __restrict t1 = &tile[(subY*inTileXSize+1)*inChannels];
-              float* __restrict t2 = &tile[(subY*inTileXSize+2)*inChannels];
-              float* __restrict t3 = &tile[(subY*inTileXSize+3)*inChannels];
-              float* __restrict t4 = &tile[(subY*inTileXSize+4)*inChannels];
-              float* __restrict t5 = &tile[(subY*inTileXSize+5)*inChannels];
-              for(int ic = 0; ic < inChannels; ic++) {
-                float z0 = t0[ic];
-                float z1 = t1[ic];
-                float z2 = t2[ic];
-                float z3 = t3[ic];
-                float z4 = t4[ic];
-                float z5 = t5[ic];
-                t0[ic] = 4.0f*z0 - 5.0f*z2 + z4;
-                t1[ic] = - 4.0f*z1 - 4.0f*z2 + z3 + z4;
-                t2[ic] =   4.0f*z1 - 4.0f*z2 - z3 + z4;
-                t3[ic] = - 2.0f*z1 - z2 + 2.0f*z3 + z4;
-                t4[ic] =   2.0f*z1 - z2 - 2.0f*z3 + z4;
-                t5[ic] = 4.0f*z1 - 5.0f*z3 + z5;
-              }
+          for(int subY = 0; subY < inTileYSize; subY++) {
+            float* __restrict t0 = &tile[(subY*inTileXSize+0)*inChannels];
+            float* __restrict t1 = &tile[(subY*inTileXSize+1)*inChannels];
+            float* __restrict t2 = &tile[(subY*inTileXSize+2)*inChannels];
+            float* __restrict t3 = &tile[(subY*inTileXSize+3)*inChannels];
+            float* __restrict t4 = &tile[(subY*inTileXSize+4)*inChannels];
+            float* __restrict t5 = &tile[(subY*inTileXSize+5)*inChannels];
+            for(int ic = 0; ic < inChannels; ic++) {
+              float z0 = t0[ic];
+              float z1 = t1[ic];
+              float z2 = t2[ic];
+              float z3 = t3[ic];
+              float z4 = t4[ic];
+              float z5 = t5[ic];
+              t0[ic] = 4.0f*z0 - 5.0f*z2 + z4;
+              t1[ic] = - 4.0f*z1 - 4.0f*z2 + z3 + z4;
+              t2[ic] =   4.0f*z1 - 4.0f*z2 - z3 + z4;
+              t3[ic] = - 2.0f*z1 - z2 + 2.0f*z3 + z4;
+              t4[ic] =   2.0f*z1 - z2 - 2.0f*z3 + z4;
+              t5[ic] = 4.0f*z1 - 5.0f*z3 + z5;
             }
-            for(int subX = 0; subX < inTileXSize; subX++) {
-              float* __restrict t0 = &tile[(0*inTileXSize+subX)*inChannels];
-              float* __restrict t1 = &tile[(1*inTileXSize+subX)*inChannels];
-              float* __restrict t2 = &tile[(2*inTileXSize+subX)*inChannels];
-              float* __restrict t3 = &tile[(3*inTileXSize+subX)*inChannels];
-              float* __restrict t4 = &tile[(4*inTileXSize+subX)*inChannels];
-              float* __restrict t5 = &tile[(5*inTileXSize+subX)*inChannels];
-              for(int ic = 0; ic < inChannels; ic++) {
-                float z0 = t0[ic];
-                float z1 = t1[ic];
-                float z2 = t2[ic];
-                float z3 = t3[ic];
-                float z4 = t4[ic];
-                float z5 = t5[ic];
-                t0[ic] = 4.0f*z0 - 5.0f*z2 + z4;
-                t1[ic] = - 4.0f*z1 - 4.0f*z2 + z3 + z4;
-                t2[ic] =   4.0f*z1 - 4.0f*z2 - z3 + z4;
-                t3[ic] = - 2.0f*z1 - z2 + 2.0f*z3 + z4;
-                t4[ic] =   2.0f*z1 - z2 - 2.0f*z3 + z4;
-                t5[ic] = 4.0f*z1 - 5.0f*z3 + z5;
-              }
+          }
+          for(int subX = 0; subX < inTileXSize; subX++) {
+            float* __restrict t0 = &tile[(0*inTileXSize+subX)*inChannels];
+            float* __restrict t1 = &tile[(1*inTileXSize+subX)*inChannels];
+            float* __restrict t2 = &tile[(2*inTileXSize+subX)*inChannels];
+            float* __restrict t3 = &tile[(3*inTileXSize+subX)*inChannels];
+            float* __restrict t4 = &tile[(4*inTileXSize+subX)*inChannels];
+            float* __restrict t5 = &tile[(5*inTileXSize+subX)*inChannels];
+            for(int ic = 0; ic < inChannels; ic++) {
+              float z0 = t0[ic];
+              float z1 = t1[ic];
+              float z2 = t2[ic];
+              float z3 = t3[ic];
+              float z4 = t4[ic];
+              float z5 = t5[ic];
+              t0[ic] = 4.0f*z0 - 5.0f*z2 + z4;
+              t1[ic] = - 4.0f*z1 - 4.0f*z2 + z3 + z4;
+              t2[ic] =   4.0f*z1 - 4.0f*z2 - z3 + z4;
+              t3[ic] = - 2.0f*z1 - z2 + 2.0f*z3 + z4;
+              t4[ic] =   2.0f*z1 - z2 - 2.0f*z3 + z4;
+              t5[ic] = 4.0f*z1 - 5.0f*z3 + z5;
             }
-            int batchTileXTileY = n * numTilesY * numTilesX + yTile * numTilesX + xTile;
-            for(int dy = 0; dy < inTileYSize; dy++) {
-              for(int dx = 0; dx < inTileXSize; dx++) {
-                for(int ic = 0; ic < inChannels; ic++) {
-                  int subTileIdx = dy * inTileXSize + dx;
-                  transformedInput(ic, batchTileXTileY, subTileIdx) = tile[subTileIdx*inChannels+ic];
-                }
+          }
+          for(int dy = 0; dy < inTileYSize; dy++) {
+            for(int dx = 0; dx < inTileXSize; dx++) {
+              for(int ic = 0; ic < inChannels; ic++) {
+                int subTileIdx = dy * inTileXSize + dx;
+                transformedInput(ic, batchTileXTileY, subTileIdx) = tile[subTileIdx*inChannels+ic];
               }
             }
           }
         }
-      }
+      });
 
       //TODO someday: Does eigen have a fast batched matrix multiply?
       //Here we just manually iterate over the 36 matrices that need to get multiplied.
       //Also, if eigen were to support *interleaved* matrices (viewing it as a matrix whose element is
       //a vector of length 36 instead of a float), that might allow for improved transform/untransform implementations.
-      for(int dy = 0; dy < inTileYSize; dy++) {
-        for(int dx = 0; dx < inTileXSize; dx++) {
-          int subTileIdx = dy * inTileXSize + dx;
+      handle->parallelFor(inTileXSize * inTileYSize, [&](int subTileBegin, int subTileEnd, int threadIdx) {
+        (void)threadIdx;
+        for(int subTileIdx = subTileBegin; subTileIdx < subTileEnd; subTileIdx++) {
           auto transformedInputMap = Eigen::Map<Eigen::Matrix<SCALAR,Eigen::Dynamic,Eigen::Dynamic,Eigen::ColMajor>>(
             (float*)transformedInput.data() + subTileIdx * batchSize * numTilesY * numTilesX * inChannels,
             inChannels,
@@ -536,135 +769,174 @@ struct ConvLayer {
             outChannels,
             batchSize * numTilesY * numTilesX
           );
-          transformedOutputMap = winogradKernelMap * transformedInputMap;
+          transformedOutputMap.noalias() = winogradKernelMap * transformedInputMap;
         }
-      }
-
-      for(int n = 0; n < batchSize; n++) {
-        for(int yTile = 0; yTile < numTilesY; yTile++) {
-          for(int xTile = 0; xTile < numTilesX; xTile++) {
-            int batchTileXTileY = n * numTilesY * numTilesX + yTile * numTilesX + xTile;
-            for(int dy = 0; dy < inTileYSize; dy++) {
-              for(int dx = 0; dx < inTileXSize; dx++) {
-                int subTileIdx = dy * inTileXSize + dx;
-                for(int oc = 0; oc < outChannels; oc++) {
-                  tile[subTileIdx*outChannels+oc] = transformedOutput(oc, batchTileXTileY, subTileIdx);
-                }
+      });
+
+      handle->parallelFor(numTiles, [&](int tileBegin, int tileEnd, int threadIdx) {
+        float* tile = handle->tileBufs[threadIdx].data();
+        for(int batchTileXTileY = tileBegin; batchTileXTileY < tileEnd; batchTileXTileY++) {
+          const int n = batchTileXTileY / (numTilesY * numTilesX);
+          const int yTile = (batchTileXTileY / numTilesX) % numTilesY;
+          const int xTile = batchTileXTileY % numTilesX;
+          for(int dy = 0; dy < inTileYSize; dy++) {
+            for(int dx = 0; dx < inTileXSize; dx++) {
+              int subTileIdx = dy * inTileXSize + dx;
+              for(int oc = 0; oc < outChannels; oc++) {
+                tile[subTileIdx*outChannels+oc] = transformedOutput(oc, batchTileXTileY, subTileIdx);
               }
             }
+          }
 
-            if(convXSize == 5 && convYSize == 5) {
-              for(int subY = 0; subY < inTileYSize; subY++) {
-                float* __restrict t0 = &tile[(subY*inTileXSize+0)*outChannels];
-                float* __restrict t1 = &tile[(subY*inTileXSize+1)*outChannels];
-                float* __restrict t2 = &tile[(subY*inTileXSize+2)*outChannels];
-                float* __restrict t3 = &tile[(subY*inTileXSize+3)*outChannels];
-                float* __restrict t4 = &tile[(subY*inTileXSize+4)*outChannels];
-                float* __restrict t5 = &tile[(subY*inTileXSize+5)*outChannels];
-                for(int oc = 0; oc < outChannels; oc++) {
-                  float z0 = t0[oc];
-                  float z1 = t1[oc];
-                  float z2 = t2[oc];
-                  float z3 = t3[oc];
-                  float z4 = t4[oc];
-                  float z5 = t5[oc];
-                  t0[oc] = z0 + z1 + z2 + z3 + z4;
-                  t1[oc] = (z1-z2) + 2.0f*(z3-z4) + z5;
-                }
+          if(convXSize == 5 && convYSize == 5) {
+            for(int subY = 0; subY < inTileYSize; subY++) {
+              float* __restrict t0 = &tile[(subY*inTileXSize+0)*outChannels];
+              float* __restrict t1 = &tile[(subY*inTileXSize+1)*outChannels];
+              float* __restrict t2 = &tile[(subY*inTileXSize+2)*outChannels];
+              float* __restrict t3 = &tile[(subY*inTileXSize+3)*outChannels];
+              float* __restrict t4 = &tile[(subY*inTileXSize+4)*outChannels];
+              float* __restrict t5 = &tile[(subY*inTileXSize+5)*outChannels];
+              for(int oc = 0; oc < outChannels; oc++) {
+                float z0 = t0[oc];
+                float z1 = t1[oc];
+                float z2 = t2[oc];
+                float z3 = t3[oc];
+                float z4 = t4[oc];
+                float z5 = t5[oc];
+                t0[oc] = z0 + z1 + z2 + z3 + z4;
+                t1[oc] = (z1-z2) + 2.0f*(z3-z4) + z5;
               }
-              for(int subX = 0; subX < outTileXSize; subX++) {
-                float* __restrict t0 = &tile[(0*inTileXSize+subX)*outChannels];
-                float* __restrict t1 = &tile[(1*inTileXSize+subX)*outChannels];
-                float* __restrict t2 = &tile[(2*inTileXSize+subX)*outChannels];
-                float* __restrict t3 = &tile[(3*inTileXSize+subX)*outChannels];
-                float* __restrict t4 = &tile[(4*inTileXSize+subX)*outChannels];
-                float* __restrict t5 = &tile[(5*inTileXSize+subX)*outChannels];
-                for(int oc = 0; oc < outChannels; oc++) {
-                  float z0 = t0[oc];
-                  float z1 = t1[oc];
-                  float z2 = t2[oc];
-                  float z3 = t3[oc];
-                  float z4 = t4[oc];
-                  float z5 = t5[oc];
-                  t0[oc] = z0 + z1 + z2 + z3 + z4;
-                  t1[oc] = (z1-z2) + 2.0f*(z3-z4) + z5;
-                }
+            }
+            for(int subX = 0; subX < outTileXSize; subX++) {
+              float* __restrict t0 = &tile[(0*inTileXSize+subX)*outChannels];
+              float* __restrict t1 = &tile[(1*inTileXSize+subX)*outChannels];
+              float* __restrict t2 = &tile[(2*inTileXSize+subX)*outChannels];
+              float* __restrict t3 = &tile[(3*inTileXSize+subX)*outChannels];
+              float* __restrict t4 = &tile[(4*inTileXSize+subX)*outChannels];
+              float* __restrict t5 = &tile[(5*inTileXSize+subX)*outChannels];
+              for(int oc = 0; oc < outChannels; oc++) {
+                float z0 = t0[oc];
+                float z1 = t1[oc];
+                float z2 = t2[oc];
+                float z3 = t3[oc];
+                float z4 = t4[oc];
+                float z5 = t5[oc];
+                t0[oc] = z0 + z1 + z2 + z3 + z4;
+                t1[oc] = (z1-z2) + 2.0f*(z3-z4) + z5;
               }
             }
-            else {
-              for(int subY = 0; subY < inTileYSize; subY++) {
-                float* __restrict t0 = &tile[(subY*inTileXSize+0)*outChannels];
-                float* __restrict t1 = &tile[(subY*inTileXSize+1)*outChannels];
-                float* __restrict t2 = &tile[(subY*inTileXSize+2)*outChannels];
-                float* __restrict t3 = &tile[(subY*inTileXSize+3)*outChannels];
-                float* __restrict t4 = &tile[(subY*inTileXSize+4)*outChannels];
-                float* __restrict t5 = &tile[(subY*inTileXSize+5)*outChannels];
-                for(int oc = 0; oc < outChannels; oc++) {
-                  float z0 = t0[oc];
-                  float z1 = t1[oc];
-                  float z2 = t2[oc];
-                  float z3 = t3[oc];
-                  float z4 = t4[oc];
-                  float z5 = t5[oc];
-                  t0[oc] = z0 + z1 + z2 + z3 + z4;
-                  t1[oc] = (z1-z2) + 2.0f*(z3-z4);
-                  t2[oc] = (z1+z2) + 4.0f*(z3+z4);
-                  t3[oc] = (z1-z2) + 8.0f*(z3-z4) + z5;
-                }
+          }
+          else {
+            for(int subY = 0; subY < inTileYSize; subY++) {
+              float* __restrict t0 = &tile[(subY*inTileXSize+0)*outChannels];
+              float* __restrict t1 = &tile[(subY*inTileXSize+1)*outChannels];
+              float* __restrict t2 = &tile[(subY*inTileXSize+2)*outChannels];
+              float* __restrict t3 = &tile[(subY*inTileXSize+3)*outChannels];
+              float* __restrict t4 = &tile[(subY*inTileXSize+4)*outChannels];
+              float* __restrict t5 = &tile[(subY*inTileXSize+5)*outChannels];
+              for(int oc = 0; oc < outChannels; oc++) {
+                float z0 = t0[oc];
+                float z1 = t1[oc];
+                float z2 = t2[oc];
+                float z3 = t3[oc];
+                float z4 = t4[oc];
+                float z5 = t5[oc];
+                t0[oc] = z0 + z1 + z2 + z3 + z4;
+                t1[oc] = (z1-z2) + 2.0f*(z3-z4);
+                t2[oc] = (z1+z2) + 4.0f*(z3+z4);
+                t3[oc] = (z1-z2) + 8.0f*(z3-z4) + z5;
               }
-              for(int subX = 0; subX < outTileXSize; subX++) {
-                float* __restrict t0 = &tile[(0*inTileXSize+subX)*outChannels];
-                float* __restrict t1 = &tile[(1*inTileXSize+subX)*outChannels];
-                float* __restrict t2 = &tile[(2*inTileXSize+subX)*outChannels];
-                float* __restrict t3 = &tile[(3*inTileXSize+subX)*outChannels];
-                float* __restrict t4 = &tile[(4*inTileXSize+subX)*outChannels];
-                float* __restrict t5 = &tile[(5*inTileXSize+subX)*outChannels];
-                for(int oc = 0; oc < outChannels; oc++) {
-                  float z0 = t0[oc];
-                  float z1 = t1[oc];
-                  float z2 = t2[oc];
-                  float z3 = t3[oc];
-                  float z4 = t4[oc];
-                  float z5 = t5[oc];
-                  t0[oc] = z0 + z1 + z2 + z3 + z4;
-                  t1[oc] = (z1-z2) + 2.0f*(z3-z4);
-                  t2[oc] = (z1+z2) + 4.0f*(z3+z4);
-                  t3[oc] = (z1-z2) + 8.0f*(z3-z4) + z5;
-                }
+            }
+            for(int subX = 0; subX < outTileXSize; subX++) {
+              float* __restrict t0 = &tile[(0*inTileXSize+subX)*outChannels];
+              float* __restrict t1 = &tile[(1*inTileXSize+subX)*outChannels];
+              float* __restrict t2 = &tile[(2*inTileXSize+subX)*outChannels];
+              float* __restrict t3 = &tile[(3*inTileXSize+subX)*outChannels];
+              float* __restrict t4 = &tile[(4*inTileXSize+subX)*outChannels];
+              float* __restrict t5 = &tile[(5*inTileXSize+subX)*outChannels];
+              for(int oc = 0; oc < outChannels; oc++) {
+                float z0 = t0[oc];
+                float z1 = t1[oc];
+                float z2 = t2[oc];
+                float z3 = t3[oc];
+                float z4 = t4[oc];
+                float z5 = t5[oc];
+                t0[oc] = z0 + z1 + z2 + z3 + z4;
+                t1[oc] = (z1-z2) + 2.0f*(z3-z4);
+                t2[oc] = (z1+z2) + 4.0f*(z3+z4);
+                t3[oc] = (z1-z2) + 8.0f*(z3-z4) + z5;
               }
             }
+          }
 
-            if(accumulate) {
-              for(int dy = 0; dy < outTileYSize; dy++) {
-                for(int dx = 0; dx < outTileXSize; dx++) {
-                  int x = xTile*outTileXSize+dx;
-                  int y = yTile*outTileYSize+dy;
-                  if(!(x < 0 || y < 0 || x >= nnXLen || y >= nnYLen)) {
-                    int subTileIdx = dy * inTileXSize + dx;
-                    for(int oc = 0; oc < outChannels; oc++) {
-                      (*output)(oc,x,y,n) += tile[subTileIdx*outChannels+oc];
-                    }
+          if(hasOutputNormAct) {
+            for(int dy = 0; dy < outTileYSize; dy++) {
+              for(int dx = 0; dx < outTileXSize; dx++) {
+                int x = xTile*outTileXSize+dx;
+                int y = yTile*outTileYSize+dy;
+                if(!(x < 0 || y < 0 || x >= nnXLen || y >= nnYLen)) {
+                  int subTileIdx = dy * inTileXSize + dx;
+                  if((*mask)(x,y,n) != 1.0f)
+                    std::fill(&(*output)(0,x,y,n), &(*output)(0,x,y,n) + outChannels, 0.0f);
+                  else
+                    applyNormAct(tile + subTileIdx*outChannels, &(*output)(0,x,y,n), NULL, outputBias.data(), outChannels, outputActivation);
+                }
+              }
+            }
+          }
+          else if(accumulate) {
+            for(int dy = 0; dy < outTileYSize; dy++) {
+              for(int dx = 0; dx < outTileXSize; dx++) {
+                int x = xTile*outTileXSize+dx;
+                int y = yTile*outTileYSize+dy;
+                if(!(x < 0 || y < 0 || x >= nnXLen || y >= nnYLen)) {
+                  int subTileIdx = dy * inTileXSize + dx;
+                  for(int oc = 0; oc < outChannels; oc++) {
+                    (*output)(oc,x,y,n) += tile[subTileIdx*outChannels+oc];
                   }
                 }
               }
             }
-            else {
-              for(int dy = 0; dy < outTileYSize; dy++) {
-                for(int dx = 0; dx < outTileXSize; dx++) {
-                  int x = xTile*outTileXSize+dx;
-                  int y = yTile*outTileYSize+dy;
-                  if(!(x < 0 || y < 0 || x >= nnXLen || y >= nnYLen)) {
-                    int subTileIdx = dy * inTileXSize + dx;
-                    for(int oc = 0; oc < outChannels; oc++) {
-                      (*output)(oc,x,y,n) = tile[subTileIdx*outChannels+oc];
-                    }
+          }
+          else {
+            for(int dy = 0; dy < outTileYSize; dy++) {
+              for(int dx = 0; dx < outTileXSize; dx++) {
+                int x = xTile*outTileXSize+dx;
+                int y = yTile*outTileYSize+dy;
+                if(!(x < 0 || y < 0 || x >= nnXLen || y >= nnYLen)) {
+                  int subTileIdx = dy * inTileXSize + dx;
+                  for(int oc = 0; oc < outChannels; oc++) {
+                    (*output)(oc,x,y,n) = tile[subTileIdx*outChannels+oc];
                   }
                 }
               }
             }
           }
         }
-      }
+      });
+    }
+    else if(convXSize == 1 && convYSize == 1) {
+      assert(!hasInputNormAct);
+      //A plain matrix multiply, split by board positions
+      const int numPositions = nnXLen * nnYLen * batchSize;
+      handle->parallelFor(numPositions, [&](int posBegin, int posEnd, int threadIdx) {
+        (void)threadIdx;
+        auto kernelMap = Eigen::Map<const Eigen::Matrix<SCALAR,Eigen::Dynamic,Eigen::Dynamic,Eigen::ColMajor>>(
+          imagePatchKernel.data(), outChannels, inChannels
+        );
+        auto inputMap = Eigen::Map<const Eigen::Matrix<SCALAR,Eigen::Dynamic,Eigen::Dynamic,Eigen::ColMajor>>(
+          input->data() + (size_t)posBegin * inChannels, inChannels, posEnd - posBegin
+        );
+        auto outputMap = Eigen::Map<Eigen::Matrix<SCALAR,Eigen::Dynamic,Eigen::Dynamic,Eigen::ColMajor>>(
+          output->data() + (size_t)posBegin * outChannels, outChannels, posEnd - posBegin
+        );
+        if(accumulate)
+          outputMap.noalias() += kernelMap * inputMap;
+        else
+          outputMap.noalias() = kernelMap * inputMap;
+        if(hasOutputNormAct)
+          applyOutputNormAct(output, mask, posBegin, posEnd);
+      });
     }
     else {
       Eigen::array<Eigen::Index, 2> imagePatchColVectorShape = {imagePatchSize, nnXLen*nnYLen*batchSize};
@@ -676,6 +948,18 @@ struct ConvLayer {
         *output += convolution;
       else
         *output = convolution;
+      if(hasOutputNormAct)
+        applyOutputNormAct(output, mask, 0, nnXLen*nnYLen*batchSize);
+    }
+  }
+
+  void applyOutputNormAct(TENSORMAP4* output, CONSTTENSORMAP3* mask, int posBegin, int posEnd) const {
+    for(int pos = posBegin; pos < posEnd; pos++) {
+      float* out = output->data() + (size_t)pos * outChannels;
+      if(mask->data()[pos] != 1.0f)
+        std::fill(out, out + outChannels, 0.0f);
+      else
+        applyNormAct(out, out, NULL, outputBias.data(), outChannels, outputActivation);
     }
   }
 };
@@ -714,27 +998,30 @@ struct BatchNormLayer {
   }
 
   // Mask should be in 'NHW' format (no "C" channel).
+  // Split by board positions between the threads of the handle.
   void apply(
+    ComputeHandleInternal* handle,
     CONSTTENSORMAP4* input,
     TENSORMAP4* output,
     CONSTTENSORMAP3* mask
   ) const {
-    for(int c = 0; c < input->dimension(0); c++) {
-      auto inC = input->chip(c, 0);
-      auto x = inC * mergedScale[c] + mergedBias[c];
-      auto z = TENSOR3(mask->dimension(0), mask->dimension(1), mask->dimension(2)).setZero();
-
-    if(activation == ACTIVATION_IDENTITY)
-      output->chip(c, 0) = (*mask == 1.0f).select(x, z);
-    else if(activation == ACTIVATION_RELU)
-      output->chip(c, 0) = (*mask == 1.0f).select(x.cwiseMax(0.0f), z);
-    else if(activation == ACTIVATION_MISH)
-      output->chip(c, 0) = (*mask == 1.0f).select(x * (x.cwiseMin(20.0f).exp().log1p() + (x.cwiseMax(20.0f) - 20.0f)).tanh(), z);
-    else if(activation == ACTIVATION_MISH_SCALE8)
-      testAssert(false); // Eigen does not use scaled mish activations due to no fp16
-    else
-      testAssert(false);
-    }
+    NNProfiler::Section section("batchnorm",name.c_str());
+    const int numChannels = input->dimension(0);
+    const int numPositions = input->dimension(1) * input->dimension(2) * input->dimension(3);
+    assert(output->dimension(0) == numChannels);
+    assert(mask->size() == numPositions);
+
+    handle->parallelFor(numPositions, [&](int posBegin, int posEnd, int threadIdx) {
+      (void)threadIdx;
+      for(int pos = posBegin; pos < posEnd; pos++) {
+        const float* in = input->data() + (size_t)pos * numChannels;
+        float* out = output->data() + (size_t)pos * numChannels;
+        if(mask->data()[pos] != 1.0f)
+          std::fill(out, out + numChannels, 0.0f);
+        else
+          applyNormAct(in, out, mergedScale.data(), mergedBias.data(), numChannels, activation);
+      }
+    });
   }
 };
 
@@ -806,6 +1093,7 @@ struct MatMulLayer {
   }
 
   void apply(CONSTTENSORMAP2* in, TENSORMAP2* out) const {
+    NNProfiler::Section section("matmul",name.c_str());
     Eigen::array<Eigen::IndexPair<int>, 1> product_dims = { Eigen::IndexPair<int>(1, 0) };
     *out = weights.contract(*in, product_dims);
   }
@@ -825,6 +1113,7 @@ struct MatBiasLayer {
   {}
 
   void apply(TENSORMAP2* mat) const {
+    NNProfiler::Section section("matbias",name.c_str());
     for(int n = 0; n < mat->dimension(1); n++) {
       for(int c = 0; c < mat->dimension(0); c++) {
         (*mat)(c, n) += weights[c];
@@ -836,6 +1125,8 @@ struct MatBiasLayer {
 // --------------------------------------------------------------------------------------------------------------
 
 struct NormActConv {
+  //Whether the conv applies the norm while gathering its input, instead of it being a separate pass
+  const bool normFusedIntoConv;
   const BatchNormLayer norm;
   const ConvLayer conv;
   const int inChannels;
@@ -847,15 +1138,24 @@ struct NormActConv {
 
   ~NormActConv(){}
 
+  //outputNormDesc and outputActDesc, if not NULL, are the batch norm and activation that the output of the conv goes through
+  //next, which get folded into the conv.
   NormActConv(
     const BatchNormLayerDesc& normDesc,
     const ActivationLayerDesc& actDesc,
     const ConvLayerDesc& convDesc,
     int nnX,
-    int nnY
+    int nnY,
+    const BatchNormLayerDesc* outputNormDesc = NULL,
+    const ActivationLayerDesc* outputActDesc = NULL
   )
-    : norm(normDesc,actDesc),
-      conv(convDesc,nnX,nnY),
+    : normFusedIntoConv(ConvLayer::canFuseInputNormAct(convDesc,actDesc)),
+      norm(normDesc,actDesc),
+      conv(
+        convDesc,nnX,nnY,
+        normFusedIntoConv ? &normDesc : NULL, normFusedIntoConv ? &actDesc : NULL,
+        outputNormDesc, outputActDesc
+      ),
       inChannels(convDesc.inChannels),
       outChannels(convDesc.outChannels)
   {}
@@ -873,8 +1173,13 @@ struct NormActConv {
     float* convWorkspace,
     bool accumulate
   ) const {
-    norm.apply(input, inputScratch, mask);
-    conv.apply(handle, inputScratch, output, convWorkspace, accumulate);
+    if(normFusedIntoConv) {
+      conv.apply(handle, input, output, mask, convWorkspace, accumulate);
+    }
+    else {
+      norm.apply(handle, input, inputScratch, mask);
+      conv.apply(handle, inputScratch, output, mask, convWorkspace, accumulate);
+    }
   }
 };
 
@@ -900,10 +1205,12 @@ struct ResidualBlockIntf {
 
 // --------------------------------------------------------------------------------------------------------------
 
+//The mid batch norm and activation are folded into the first conv, so the second conv can use its output directly, and it
+//adds its own output to the trunk as it writes it.
 struct ResidualBlock final : public ResidualBlockIntf {
   const string name;
   const NormActConv normActConv1;
-  const NormActConv normActConv2;
+  const ConvLayer finalConv;
 
   ResidualBlock() = delete;
   ResidualBlock(const ResidualBlock&) = delete;
@@ -913,14 +1220,14 @@ struct ResidualBlock final : public ResidualBlockIntf {
 
   ResidualBlock(const ResidualBlockDesc& desc, int nnX, int nnY)
     : name(desc.name),
-      normActConv1(desc.preBN,desc.preActivation,desc.regularConv,nnX,nnY),
-      normActConv2(desc.midBN,desc.midActivation,desc.finalConv,nnX,nnY)
+      normActConv1(desc.preBN,desc.preActivation,desc.regularConv,nnX,nnY,&desc.midBN,&desc.midActivation),
+      finalConv(desc.finalConv,nnX,nnY)
   {}
 
   size_t requiredConvWorkspaceElts(size_t maxBatchSize) const override {
     return std::max(
       normActConv1.requiredConvWorkspaceElts(maxBatchSize),
-      normActConv2.requiredConvWorkspaceElts(maxBatchSize)
+      finalConv.requiredConvWorkspaceElts(maxBatchSize)
     );
   }
 
@@ -933,15 +1240,14 @@ struct ResidualBlock final : public ResidualBlockIntf {
     const float* maskSum,
     float* convWorkspace
   ) const override {
+    NNProfiler::Section section("block",name.c_str());
     (void)maskSum;
     int batchSize = trunk->dimension(3);
     SizedBuf<float*> midInBuf(scratch->allocator, scratch->getBufSizeXY(normActConv1.outChannels));
-    SizedBuf<float*> midScratchBuf(scratch->allocator, scratch->getBufSizeXY(normActConv1.outChannels));
     TENSORMAP4 midIn(midInBuf.buf, normActConv1.outChannels, handle->nnXLen, handle->nnYLen, batchSize);
-    TENSORMAP4 midScratch(midScratchBuf.buf, normActConv1.outChannels, handle->nnXLen, handle->nnYLen, batchSize);
 
     normActConv1.apply(handle, trunk, trunkScratch, &midIn, mask, convWorkspace, false);
-    normActConv2.apply(handle, &midIn, &midScratch, trunk, mask, convWorkspace, true);
+    finalConv.apply(handle, &midIn, trunk, mask, convWorkspace, true);
   }
 };
 
@@ -951,8 +1257,7 @@ struct GlobalPoolingResidualBlock final : public ResidualBlockIntf {
   const string name;
   const BatchNormLayer preBN;
   const ConvLayer regularConv;
-  const ConvLayer gpoolConv;
-  const BatchNormLayer gpoolBN;
+  const ConvLayer gpoolConv; //Also applies gpoolBN and gpoolActivation, folded in
   const MatMulLayer gpoolToBiasMul;
   const NormActConv normActConv2;
 
@@ -966,8 +1271,7 @@ struct GlobalPoolingResidualBlock final : public ResidualBlockIntf {
     : name(desc.name),
       preBN(desc.preBN,desc.preActivation),
       regularConv(desc.regularConv,nnX,nnY),
-      gpoolConv(desc.gpoolConv,nnX,nnY),
-      gpoolBN(desc.gpoolBN,desc.gpoolActivation),
+      gpoolConv(desc.gpoolConv,nnX,nnY,NULL,NULL,&desc.gpoolBN,&desc.gpoolActivation),
       gpoolToBiasMul(desc.gpoolToBiasMul),
       normActConv2(desc.midBN,desc.midActivation,desc.finalConv,nnX,nnY)
   {}
@@ -989,30 +1293,27 @@ struct GlobalPoolingResidualBlock final : public ResidualBlockIntf {
     const float* maskSum,
     float* convWorkspace
   ) const override {
+    NNProfiler::Section section("block",name.c_str());
     int batchSize = trunk->dimension(3);
     SizedBuf<float*> regularOutBuf(scratch->allocator, scratch->getBufSizeXY(regularConv.outChannels));
     SizedBuf<float*> regularScratchBuf(scratch->allocator, scratch->getBufSizeXY(regularConv.outChannels));
-    SizedBuf<float*> gpoolOutBuf(scratch->allocator, scratch->getBufSizeXY(gpoolConv.outChannels));
     SizedBuf<float*> gpoolOut2Buf(scratch->allocator, scratch->getBufSizeXY(gpoolConv.outChannels));
     SizedBuf<float*> gpoolConcatBuf(scratch->allocator, scratch->getBufSize(gpoolConv.outChannels*3));
     SizedBuf<float*> gpoolBiasBuf(scratch->allocator, scratch->getBufSize(regularConv.outChannels));
 
     TENSORMAP4 regularOut(regularOutBuf.buf, regularConv.outChannels, handle->nnXLen, handle->nnYLen, batchSize);
     TENSORMAP4 regularScratch(regularScratchBuf.buf, regularConv.outChannels, handle->nnXLen, handle->nnYLen, batchSize);
-    TENSORMAP4 gpoolOut(gpoolOutBuf.buf, gpoolConv.outChannels, handle->nnXLen, handle->nnYLen, batchSize);
     TENSORMAP4 gpoolOut2(gpoolOut2Buf.buf, gpoolConv.outChannels, handle->nnXLen, handle->nnYLen, batchSize);
     TENSORMAP2 gpoolConcat(gpoolConcatBuf.buf, gpoolConv.outChannels*3, batchSize);
     TENSORMAP2 gpoolBias(gpoolBiasBuf.buf, regularConv.outChannels, batchSize);
 
     DTENSOR("trunk", trunk);
     DTENSOR("mask", mask);
-    preBN.apply(trunk, trunkScratch, mask);
+    preBN.apply(handle, trunk, trunkScratch, mask);
     DTENSOR("trunkScratch", trunkScratch);
-    regularConv.apply(handle, trunkScratch, &regularOut, convWorkspace, false);
+    regularConv.apply(handle, trunkScratch, &regularOut, mask, convWorkspace, false);
     DTENSOR("regularOut", &regularOut);
-    gpoolConv.apply(handle, trunkScratch, &gpoolOut, convWorkspace, false);
-    DTENSOR("gpoolOut", &gpoolOut);
-    gpoolBN.apply(&gpoolOut, &gpoolOut2, mask);
+    gpoolConv.apply(handle, trunkScratch, &gpoolOut2, mask, convWorkspace, false);
     DTENSOR("gpoolOut2", &gpoolOut2);
     poolRowsGPool(&gpoolOut2, &gpoolConcat, mask, maskSum);
     gpoolToBiasMul.apply(&gpoolConcat, &gpoolBias);
@@ -1021,7 +1322,6 @@ struct GlobalPoolingResidualBlock final : public ResidualBlockIntf {
     DSHAPE("trunk", trunk);
     DSHAPE("trunkScratch", trunkScratch);
     DSHAPE("regularOut", &regularOut);
-    DSHAPE("gpoolOut", &gpoolOut);
     DSHAPE("gpoolOut2", &gpoolOut2);
     DSHAPE("gpoolConcat", &gpoolConcat);
     DSHAPE("gpoolBias", &gpoolBias);
@@ -1101,6 +1401,7 @@ struct NestedBottleneckResidualBlock final : public ResidualBlockIntf {
     const float* maskSum,
     float* convWorkspace
   ) const override {
+    NNProfiler::Section section("nestedBlock",name.c_str());
     (void)maskSum;
     int batchSize = trunk->dimension(3);
     SizedBuf<float*> midInBuf(scratch->allocator, scratch->getBufSizeXY(normActConv1.outChannels));
@@ -1212,6 +1513,7 @@ struct SGFMetadataEncoder {
     CONSTTENSORMAP2* input,
     TENSORMAP2* output
   ) const {
+    NNProfiler::Section section("component",name.c_str());
     int batchSize = input->dimension(1);
     SizedBuf<float*> internalBuf1(scratch->allocator, scratch->getBufSize(std::max(mul1.outChannels,mul2.outChannels)));
     SizedBuf<float*> internalBuf2(scratch->allocator, scratch->getBufSize(std::max(mul1.outChannels,mul2.outChannels)));
@@ -1280,13 +1582,14 @@ struct Trunk {
     const float* maskSum,
     float* convWorkspace
   ) const {
+    NNProfiler::Section section("component",name.c_str());
     int batchSize = trunk->dimension(3);
     SizedBuf<float*> trunkScratchBuf(scratch->allocator, scratch->getBufSizeXY(initialConv.outChannels));
     SizedBuf<float*> inputMatMulOutBuf(scratch->allocator, scratch->getBufSize(initialMatMul.outChannels));
     TENSORMAP4 trunkScratch(trunkScratchBuf.buf, initialConv.outChannels, handle->nnXLen, handle->nnYLen, batchSize);
     TENSORMAP2 inputMatMulOut(inputMatMulOutBuf.buf, initialMatMul.outChannels, batchSize);
 
-    initialConv.apply(handle, input, &trunkScratch, convWorkspace, false);
+    initialConv.apply(handle, input, &trunkScratch, mask, convWorkspace, false);
     initialMatMul.apply(inputGlobal, &inputMatMulOut);
     addNCBiasInplace(&trunkScratch, &inputMatMulOut);
     if(sgfMetadataEncoder != nullptr) {
@@ -1301,7 +1604,7 @@ struct Trunk {
     // Flip trunkBuf and trunkScratchBuf so that the result gets accumulated in trunkScratchBuf
     blocks.apply(handle,scratch,&trunkScratch,trunk,mask,maskSum,convWorkspace);
     // And now with the final BN port it from trunkScratchBuf to trunkBuf.
-    trunkTipBN.apply(&trunkScratch, trunk, mask);
+    trunkTipBN.apply(handle, &trunkScratch, trunk, mask);
   }
 };
 
@@ -1310,8 +1613,7 @@ struct PolicyHead {
   const int modelVersion;
 
   const ConvLayer p1Conv;
-  const ConvLayer g1Conv;
-  const BatchNormLayer g1BN;
+  const ConvLayer g1Conv; //Also applies g1BN and g1Activation, folded in
   const MatMulLayer gpoolToBiasMul;
   const BatchNormLayer p1BN;
   const ConvLayer p2Conv;
@@ -1328,8 +1630,7 @@ struct PolicyHead {
     : name(desc.name),
       modelVersion(desc.modelVersion),
       p1Conv(desc.p1Conv,nnX,nnY),
-      g1Conv(desc.g1Conv,nnX,nnY),
-      g1BN(desc.g1BN,desc.g1Activation),
+      g1Conv(desc.g1Conv,nnX,nnY,NULL,NULL,&desc.g1BN,&desc.g1Activation),
       gpoolToBiasMul(desc.gpoolToBiasMul),
       p1BN(desc.p1BN,desc.p1Activation),
       p2Conv(desc.p2Conv,nnX,nnY),
@@ -1357,30 +1658,28 @@ struct PolicyHead {
     const float* maskSum,
     float* convWorkspace
   ) const {
+    NNProfiler::Section section("component",name.c_str());
     int batchSize = trunk->dimension(3);
     SizedBuf<float*> p1OutBuf(scratch->allocator, scratch->getBufSizeXY(p1Conv.outChannels));
     SizedBuf<float*> p1Out2Buf(scratch->allocator, scratch->getBufSizeXY(p1Conv.outChannels));
-    SizedBuf<float*> g1OutBuf(scratch->allocator, scratch->getBufSizeXY(g1Conv.outChannels));
     SizedBuf<float*> g1Out2Buf(scratch->allocator, scratch->getBufSizeXY(g1Conv.outChannels));
     SizedBuf<float*> g1ConcatBuf(scratch->allocator, scratch->getBufSize(g1Conv.outChannels*3));
     SizedBuf<float*> g1BiasBuf(scratch->allocator, scratch->getBufSize(p1Conv.outChannels));
     SizedBuf<float*> p1PassBuf(scratch->allocator, scratch->getBufSize(p1Conv.outChannels));
     TENSORMAP4 p1Out(p1OutBuf.buf, p1Conv.outChannels, handle->nnXLen, handle->nnYLen, batchSize);
     TENSORMAP4 p1Out2(p1Out2Buf.buf, p1Conv.outChannels, handle->nnXLen, handle->nnYLen, batchSize);
-    TENSORMAP4 g1Out(g1OutBuf.buf, g1Conv.outChannels, handle->nnXLen, handle->nnYLen, batchSize);
     TENSORMAP4 g1Out2(g1Out2Buf.buf, g1Conv.outChannels, handle->nnXLen, handle->nnYLen, batchSize);
     TENSORMAP2 g1Concat(g1ConcatBuf.buf, g1Conv.outChannels*3, batchSize);
     TENSORMAP2 g1Bias(g1BiasBuf.buf, p1Conv.outChannels, batchSize);
     TENSORMAP2 p1Pass(p1PassBuf.buf, p1Conv.outChannels, batchSize);
 
-    p1Conv.apply(handle, trunk, &p1Out, convWorkspace, false);
-    g1Conv.apply(handle, trunk, &g1Out, convWorkspace, false);
-    g1BN.apply(&g1Out, &g1Out2, mask);
+    p1Conv.apply(handle, trunk, &p1Out, mask, convWorkspace, false);
+    g1Conv.apply(handle, trunk, &g1Out2, mask, convWorkspace, false);
     poolRowsGPool(&g1Out2, &g1Concat, mask, maskSum);
     gpoolToBiasMul.apply(&g1Concat, &g1Bias);
     addNCBiasInplace(&p1Out, &g1Bias);
-    p1BN.apply(&p1Out, &p1Out2, mask);
-    p2Conv.apply(handle, &p1Out2, policy, convWorkspace, false);
+    p1BN.apply(handle, &p1Out, &p1Out2, mask);
+    p2Conv.apply(handle, &p1Out2, policy, mask, convWorkspace, false);
 
     if(NNModelVersion::getSupportedVersion(modelVersion, NNModelVersion::NONLINEARITY_PASS_POLICY)) {
       gpoolToPassMul.apply(&g1Concat, &p1Pass);
@@ -1398,8 +1697,7 @@ struct ValueHead {
   const string name;
   const int modelVersion;
 
-  const ConvLayer v1Conv;
-  const BatchNormLayer v1BN;
+  const ConvLayer v1Conv; //Also applies v1BN and v1Activation, folded in
   const MatMulLayer v2Mul;
   const MatBiasLayer v2Bias;
   const ActivationLayer v2Activation;
@@ -1416,8 +1714,7 @@ struct ValueHead {
   ValueHead(const ValueHeadDesc& desc, int nnX, int nnY)
     : name(desc.name),
       modelVersion(desc.modelVersion),
-      v1Conv(desc.v1Conv,nnX,nnY),
-      v1BN(desc.v1BN,desc.v1Activation),
+      v1Conv(desc.v1Conv,nnX,nnY,NULL,NULL,&desc.v1BN,&desc.v1Activation),
       v2Mul(desc.v2Mul),
       v2Bias(desc.v2Bias),
       v2Activation(desc.v2Activation),
@@ -1445,19 +1742,17 @@ struct ValueHead {
     const float* maskSum,
     float* convWorkspace
   ) const {
+    NNProfiler::Section section("component",name.c_str());
     int batchSize = trunk->dimension(3);
-    SizedBuf<float*> v1OutBuf(scratch->allocator, scratch->getBufSizeXY(v1Conv.outChannels));
     SizedBuf<float*> v1Out2Buf(scratch->allocator, scratch->getBufSizeXY(v1Conv.outChannels));
     SizedBuf<float*> v1MeanBuf(scratch->allocator, scratch->getBufSize(v1Conv.outChannels*3));
     SizedBuf<float*> v2OutBuf(scratch->allocator, scratch->getBufSize(v2Mul.outChannels));
 
-    TENSORMAP4 v1Out(v1OutBuf.buf, v1Conv.outChannels, handle->nnXLen, handle->nnYLen, batchSize);
     TENSORMAP4 v1Out2(v1Out2Buf.buf, v1Conv.outChannels, handle->nnXLen, handle->nnYLen, batchSize);
     TENSORMAP2 v1Mean(v1MeanBuf.buf, v1Conv.outChannels*3, batchSize);
     TENSORMAP2 v2Out(v2OutBuf.buf, v2Mul.outChannels, batchSize);
 
-    v1Conv.apply(handle, trunk, &v1Out, convWorkspace, false);
-    v1BN.apply(&v1Out, &v1Out2, mask);
+    v1Conv.apply(handle, trunk, &v1Out2, mask, convWorkspace, false);
     poolRowsValueHead(&v1Out2, &v1Mean, maskSum);
     v2Mul.apply(&v1Mean, &v2Out);
     v2Bias.apply(&v2Out);
@@ -1468,7 +1763,7 @@ struct ValueHead {
     sv3Mul.apply(&v2Out, scoreValue);
     sv3Bias.apply(scoreValue);
 
-    vOwnershipConv.apply(handle, &v1Out2, ownership, convWorkspace, false);
+    vOwnershipConv.apply(handle, &v1Out2, ownership, mask, convWorkspace, false);
   }
 };
 
@@ -1695,6 +1990,7 @@ ComputeContext* NeuralNet::createComputeContext(
   const string& openCLTunerFile,
   const string& homeDataDirOverride,
   bool openCLReTunePerBoardSize,
+  int numEigenIntraOpThreads,
   enabled_t useFP16Mode,
   enabled_t useNHWCMode,
   const LoadedModel* loadedModel
@@ -1714,7 +2010,7 @@ ComputeContext* NeuralNet::createComputeContext(
   if(!useNHWC)
     throw StringError("Eigen backend: useNHWC = false not supported");
 
-  ComputeContext* context = new ComputeContext(nnXLen,nnYLen);
+  ComputeContext* context = new ComputeContext(nnXLen,nnYLen,numEigenIntraOpThreads);
   return context;
 }
 
@@ -1825,13 +2121,14 @@ void NeuralNet::getOutput(
   assert(numGlobalFeatures == inputBuffers->singleInputGlobalElts);
   const int numPolicyChannels = computeHandle->model->numPolicyChannels;
 
+  NNProfiler::Section inputSection("eigen","inputFill");
   for(int nIdx = 0; nIdx<batchSize; nIdx++) {
     float* rowSpatialInput = inputBuffers->spatialInput.data() + (inputBuffers->singleInputElts * nIdx);
     float* rowGlobalInput = inputBuffers->globalInput.data() + (inputBuffers->singleInputGlobalElts * nIdx);
     float* rowMetaInput = inputBuffers->metaInput.data() + (inputBuffers->singleInputMetaElts * nIdx);
 
     const float* rowGlobal = inputBufs[nIdx]->rowGlobalBuf.data();
-    const float* rowSpatial = inputBufs[nIdx]->rowSpatialBuf.data();
+    const uint8_t* rowSpatial = inputBufs[nIdx]->rowSpatialPackedBuf.data();
     const float* rowMeta = inputBufs[nIdx]->rowMetaBuf.data();
     const bool hasRowMeta = inputBufs[nIdx]->hasRowMeta;
     std::copy(rowGlobal,rowGlobal+numGlobalFeatures,rowGlobalInput);
@@ -1843,7 +2140,7 @@ void NeuralNet::getOutput(
     else {
       testAssert(!hasRowMeta);
     }
-    SymmetryHelpers::copyInputsWithSymmetry(rowSpatial, rowSpatialInput, 1, nnYLen, nnXLen, numSpatialFeatures, computeHandle->inputsUseNHWC, inputBufs[nIdx]->symmetry);
+    SymmetryHelpers::copyPackedInputsWithSymmetry(rowSpatial, rowSpatialInput, 1, nnYLen, nnXLen, numSpatialFeatures, computeHandle->inputsUseNHWC, inputBufs[nIdx]->symmetry);
   }
 
   Buffers& buffers = *(computeHandle->buffers);
@@ -1866,7 +2163,9 @@ void NeuralNet::getOutput(
   vector<float>& maskSum = buffers.maskSum;
   computeMaskSum(&mask,maskSum.data());
   vector<float>& convWorkspace = buffers.convWorkspace;
+  inputSection.stop();
 
+  NNProfiler::Section modelSection("eigen","model");
   computeHandle->model->apply(
     &computeHandle->handleInternal,
     computeHandle->scratch.get(),
@@ -1883,7 +2182,9 @@ void NeuralNet::getOutput(
     maskSum.data(),
     convWorkspace.data()
   );
+  modelSection.stop();
 
+  NNProfiler::Section outputSection("eigen","outputCopy");
   assert(inputBuffers->singlePolicyPassResultElts == numPolicyChannels);
   assert(inputBuffers->singlePolicyResultElts == numPolicyChannels * nnXLen * nnYLen);
 
@@ -1979,9 +2280,9 @@ bool NeuralNet::testEvaluateConv(
   size_t convWorkspaceElts = layer.requiredConvWorkspaceElts(batchSize);
   vector<float> convWorkspace(convWorkspaceElts);
 
-  ComputeContext ctx(nnXLen,nnYLen);
+  ComputeContext ctx(nnXLen,nnYLen,1);
   ComputeHandleInternal handle(&ctx);
-  layer.apply(&handle, &inTensor, &outTensor, convWorkspace.data(), false);
+  layer.apply(&handle, &inTensor, &outTensor, NULL, convWorkspace.data(), false);
 
   outputBuffer.resize(outTensorBuf.size());
   memcpy(outputBuffer.data(), outTensorBuf.data(), sizeof(SCALAR) * outTensorBuf.size());
@@ -2012,7 +2313,9 @@ bool NeuralNet::testEvaluateBatchNorm(
   TENSOR4 outTensorBuf(desc->numChannels, nnXLen, nnYLen, batchSize);
   TENSORMAP4 outTensor(outTensorBuf);
 
-  layer.apply(&inTensor, &outTensor, &mask);
+  ComputeContext ctx(nnXLen,nnYLen,1);
+  ComputeHandleInternal handle(&ctx);
+  layer.apply(&handle, &inTensor, &outTensor, &mask);
 
   outputBuffer.resize(outTensorBuf.size());
   memcpy(outputBuffer.data(), outTensorBuf.data(), sizeof(SCALAR) * outTensorBuf.size());
@@ -2050,7 +2353,7 @@ bool NeuralNet::testEvaluateResidualBlock(
 
   trunk = inTensor;
 
-  ComputeContext ctx(nnXLen,nnYLen);
+  ComputeContext ctx(nnXLen,nnYLen,1);
   ComputeHandleInternal handle(&ctx);
   ScratchBuffers scratch(batchSize, nnXLen, nnYLen);
   block.apply(
@@ -2111,7 +2414,7 @@ bool NeuralNet::testEvaluateGlobalPoolingResidualBlock(
 
   trunk = inTensor;
 
-  ComputeContext ctx(nnXLen,nnYLen);
+  ComputeContext ctx(nnXLen,nnYLen,1);
   ComputeHandleInternal handle(&ctx);
   ScratchBuffers scratch(batchSize, nnXLen, nnYLen);
   block.apply(
@@ -426,6 +426,7 @@ ComputeContext* NeuralNet::createComputeContext(
   const string& openCLTunerFile,
   const string& homeDataDirOverride,
   bool openCLReTunePerBoardSize,
+  int numEigenIntraOpThreads,
   enabled_t useFP16Mode,
   enabled_t useNHWCMode,
   const LoadedModel* loadedModel) {
@@ -435,6 +436,7 @@ ComputeContext* NeuralNet::createComputeContext(
   (void)openCLTunerFile;
   (void)homeDataDirOverride;
   (void)openCLReTunePerBoardSize;
+  (void)numEigenIntraOpThreads;
   (void)loadedModel;
 
   return new ComputeContext(nnXLen, nnYLen, useFP16Mode, useNHWCMode);
@@ -744,13 +746,13 @@ void MetalProcess::processRowData(size_t row, ComputeHandle* gpuHandle, InputBuf
   float* rowGlobalInput = &inputBuffers->userInputGlobalBuffer[inputBuffers->singleInputGlobalElts * row];
   float* rowMetaInput = &inputBuffers->userInputMetaBuffer[inputBuffers->singleInputMetaElts * row];
   const float* rowGlobal = inputBufs[row]->rowGlobalBuf.data();
-  const float* rowSpatial = inputBufs[row]->rowSpatialBuf.data();
+  const uint8_t* rowSpatial = inputBufs[row]->rowSpatialPackedBuf.data();
   const float* rowMeta = inputBufs[row]->rowMetaBuf.data();
 
   MetalProcess::copyRowData(rowGlobalInput, rowGlobal, inputBuffers->singleInputGlobalElts);
   MetalProcess::copyRowData(rowMetaInput, rowMeta, inputBuffers->singleInputMetaElts);
 
-  SymmetryHelpers::copyInputsWithSymmetry(
+  SymmetryHelpers::copyPackedInputsWithSymmetry(
     rowSpatial,
     rowSpatialInput,
     1,
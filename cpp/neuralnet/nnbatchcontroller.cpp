@@ -0,0 +1,87 @@
+#include "../neuralnet/nnbatchcontroller.h"
+
+#include <algorithm>
+
+using namespace std;
+
+//How much each new batch counts relative to the history, in the fit and in the arrival rate
+static const double FIT_DECAY = 0.98;
+static const double RATE_DECAY = 0.95;
+//Batches to see before waiting at all
+static const double MIN_WEIGHT_TO_WAIT = 4.0;
+//The wait limit never goes below this fraction of maxWaitSeconds, so that it can tell once waiting pays off again
+static const double MIN_WAIT_LIMIT_FRACTION = 1.0 / 64.0;
+
+NNBatchController::NNBatchController(double maxWaitSecs)
+  :maxWaitSeconds(maxWaitSecs),
+   waitLimitSeconds(maxWaitSecs),
+   weightSum(0.0),
+   sizeSum(0.0),
+   sizeSqSum(0.0),
+   timeSum(0.0),
+   sizeTimeSum(0.0),
+   fixedSeconds(0.0),
+   perRowSeconds(0.0),
+   arrivedRowsSum(0.0),
+   arrivedSecondsSum(0.0)
+{}
+
+NNBatchController::~NNBatchController()
+{}
+
+double NNBatchController::getWaitSeconds(int numRowsInHand, int desiredBatchSize) const {
+  if(maxWaitSeconds <= 0.0 || numRowsInHand >= desiredBatchSize || weightSum < MIN_WEIGHT_TO_WAIT)
+    return 0.0;
+  double rate = getArrivalRate();
+  if(rate <= 0.0 || numRowsInHand >= rate * fixedSeconds)
+    return 0.0;
+  return std::min(waitLimitSeconds, (desiredBatchSize - numRowsInHand) / rate);
+}
+
+void NNBatchController::recordBatch(
+  int numRowsBeforeWait, int numRows, double waitedSeconds, double cycleSeconds, double backendSeconds
+) {
+  double size = (double)numRows;
+  weightSum = weightSum * FIT_DECAY + 1.0;
+  sizeSum = sizeSum * FIT_DECAY + size;
+  sizeSqSum = sizeSqSum * FIT_DECAY + size * size;
+  timeSum = timeSum * FIT_DECAY + backendSeconds;
+  sizeTimeSum = sizeTimeSum * FIT_DECAY + size * backendSeconds;
+
+  double sizeVariance = weightSum * sizeSqSum - sizeSum * sizeSum;
+  if(sizeVariance > 1e-6 * weightSum * weightSum) {
+    perRowSeconds = std::max(0.0, (weightSum * sizeTimeSum - sizeSum * timeSum) / sizeVariance);
+    fixedSeconds = std::max(0.0, (timeSum - perRowSeconds * sizeSum) / weightSum);
+  }
+  //With batches of only one size there is no telling the two apart. Count it all as fixed, which makes us wait,
+  //which gives batches of other sizes to tell them apart, and if waiting doesn't pay off the wait limit drops.
+  else {
+    perRowSeconds = 0.0;
+    fixedSeconds = timeSum / weightSum;
+  }
+
+  arrivedRowsSum = arrivedRowsSum * RATE_DECAY + size;
+  arrivedSecondsSum = arrivedSecondsSum * RATE_DECAY + std::max(cycleSeconds, 0.0);
+
+  if(waitedSeconds > 0.0) {
+    if(numRows <= numRowsBeforeWait)
+      waitLimitSeconds = std::max(maxWaitSeconds * MIN_WAIT_LIMIT_FRACTION, waitLimitSeconds * 0.5);
+    else
+      waitLimitSeconds = std::min(maxWaitSeconds, waitLimitSeconds * 1.25);
+  }
+}
+
+double NNBatchController::getFixedSeconds() const {
+  return fixedSeconds;
+}
+double NNBatchController::getPerRowSeconds() const {
+  return perRowSeconds;
+}
+double NNBatchController::getArrivalRate() const {
+  if(arrivedSecondsSum <= 0.0)
+    return 0.0;
+  return arrivedRowsSum / arrivedSecondsSum;
+}
+double NNBatchController::getWaitLimitSeconds() const {
+  return waitLimitSeconds;
+}
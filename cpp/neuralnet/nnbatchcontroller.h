@@ -0,0 +1,54 @@
+#ifndef NEURALNET_NNBATCHCONTROLLER_H_
+#define NEURALNET_NNBATCHCONTROLLER_H_
+
+#include "../core/global.h"
+
+//Decides how long a server thread should wait for more queued evals before running a batch that isn't full.
+//Waiting only pays off if the backend has a large fixed cost per batch compared to its cost per row, and evals arrive
+//fast enough to add meaningfully to the batch during the wait. So this fits the backend time of a batch as
+//fixed + perRow * numRows, and tracks the rate evals arrive at. With n rows in hand, waiting w seconds for rate * w more
+//changes the time per row from fixed / n + perRow to (w + fixed) / (n + rate * w) + perRow, which is better exactly
+//when n < rate * fixed, and then the more so the longer the wait. So in that case it waits until the batch would be
+//full, up to a limit. The limit starts at maxWaitSeconds, halves every time a wait gains nothing, such as when all the
+//clients are already waiting on this batch, and grows back while waits pay off.
+//One per server thread, not thread-safe.
+class NNBatchController {
+ public:
+  NNBatchController(double maxWaitSeconds);
+  ~NNBatchController();
+
+  NNBatchController(const NNBatchController& other) = delete;
+  NNBatchController& operator=(const NNBatchController& other) = delete;
+
+  //How long to wait for the rest of a batch of desiredBatchSize, with numRowsInHand already taken from the queue
+  double getWaitSeconds(int numRowsInHand, int desiredBatchSize) const;
+
+  //Record a batch of numRows rows, numRowsBeforeWait of which were taken before waiting waitedSeconds for the rest.
+  //cycleSeconds is the time since the previous batch was taken from the queue, over which these rows arrived,
+  //backendSeconds the time the backend took to evaluate it.
+  void recordBatch(int numRowsBeforeWait, int numRows, double waitedSeconds, double cycleSeconds, double backendSeconds);
+
+  double getFixedSeconds() const;
+  double getPerRowSeconds() const;
+  double getArrivalRate() const;
+  double getWaitLimitSeconds() const;
+
+ private:
+  const double maxWaitSeconds;
+  double waitLimitSeconds;
+
+  //Exponentially decayed sums for the least squares fit of backend time against batch size
+  double weightSum;
+  double sizeSum;
+  double sizeSqSum;
+  double timeSum;
+  double sizeTimeSum;
+  double fixedSeconds;
+  double perRowSeconds;
+
+  //Exponentially decayed rows taken and time, whose ratio is the arrival rate
+  double arrivedRowsSum;
+  double arrivedSecondsSum;
+};
+
+#endif  // NEURALNET_NNBATCHCONTROLLER_H_
@@ -1,6 +1,13 @@
 #include "../neuralnet/nneval.h"
 #include "../neuralnet/modelversion.h"
+#include "../neuralnet/nnbatchcontroller.h"
+#include "../neuralnet/nnpersistentcache.h"
+#include "../neuralnet/nnsharedexecutor.h"
+#include "../neuralnet/nnprofiler.h"
 #include "../game/gamelogic.h"
+#include "../core/numa.h"
+
+#include <cstring>
 
 using namespace std;
 
@@ -12,7 +19,7 @@ NNResultBuf::NNResultBuf()
     hasResult(false),
     boardXSizeForServer(0),
     boardYSizeForServer(0),
-    rowSpatialBuf(),
+    rowSpatialPackedBuf(),
     rowGlobalBuf(),
     rowMetaBuf(),
     hasRowMeta(false),
@@ -20,7 +27,8 @@ NNResultBuf::NNResultBuf()
     errorLogLockout(false),
     // If no symmetry is specified, it will use default or random based on config.
     symmetry(NNInputs::SYMMETRY_NOTSPECIFIED),
-    policyOptimism(0.0)
+    policyOptimism(0.0),
+    priority(NNPriority::NORMAL)
 {}
 
 NNResultBuf::~NNResultBuf() {
@@ -56,10 +64,13 @@ NNEvaluator::NNEvaluator(
   bool iUseNHWC,
   int nnCacheSizePowerOfTwo,
   int nnMutexPoolSizePowerofTwo,
+  int64_t nnCacheMemoryBytes,
+  int nnCachePolicyBits,
   bool skipNeuralNet,
   const string& openCLTunerFile,
   const string& homeDataDirOverride,
   bool openCLReTunePerBoardSize,
+  int numEigenIntraOpThr,
   enabled_t useFP16Mode,
   enabled_t useNHWCMode,
   int numThr,
@@ -77,6 +88,7 @@ NNEvaluator::NNEvaluator(
    inputsUseNHWC(iUseNHWC),
    usingFP16Mode(useFP16Mode),
    usingNHWCMode(useNHWCMode),
+   numEigenIntraOpThreads(numEigenIntraOpThr),
    numThreads(numThr),
    gpuIdxByServerThread(gpuIdxByServerThr),
    randSeed(rSeed),
@@ -84,6 +96,13 @@ NNEvaluator::NNEvaluator(
    computeContext(NULL),
    loadedModel(NULL),
    nnCacheTable(NULL),
+   compactNNCacheTable(NULL),
+   persistentCache(NULL),
+   persistentCacheMaxTurns(-1),
+   useCanonicalCacheKeys(false),
+   maxBatchFillWaitSeconds(0.0),
+   sharedExecutor(NULL),
+   sharedExecutorClientId(-1),
    logger(lg),
    internalModelName(),
    modelVersion(-1),
@@ -106,8 +125,9 @@ NNEvaluator::NNEvaluator(
    currentDoRandomize(doRandomize),
    currentDefaultSymmetry(defaultSymmetry),
    currentBatchSize(maxBatchSz),
-   queryQueue()
+   queryQueue(NNPriority::NUM_PRIORITIES, (int64_t)maxBatchSz * 4)
 {
+  clearStats();
   if(nnXLen > NNPos::MAX_BOARD_LEN)
     throw StringError("Maximum supported nnEval board size is " + Global::intToString(NNPos::MAX_BOARD_LEN));
   if(nnYLen > NNPos::MAX_BOARD_LEN)
@@ -125,7 +145,16 @@ NNEvaluator::NNEvaluator(
     );
   }
 
-  if(nnCacheSizePowerOfTwo >= 0)
+  if(nnCacheMemoryBytes > 0) {
+    compactNNCacheTable = new CompactNNCacheTable(nnCacheMemoryBytes, nnCachePolicyBits, nnXLen, nnYLen, nnMutexPoolSizePowerofTwo);
+    if(logger != NULL) {
+      logger->write(
+        "Compact neural net cache: " + Global::uint64ToString(compactNNCacheTable->getNumEntries()) + " entries of " +
+        Global::uint64ToString(compactNNCacheTable->getEntryBytes()) + " bytes"
+      );
+    }
+  }
+  else if(nnCacheSizePowerOfTwo >= 0)
     nnCacheTable = new NNCacheTable(nnCacheSizePowerOfTwo, nnMutexPoolSizePowerofTwo);
 
   if(!debugSkipNeuralNet) {
@@ -142,7 +171,7 @@ NNEvaluator::NNEvaluator(
     postProcessParams = desc.postProcessParams;
     computeContext = NeuralNet::createComputeContext(
       gpuIdxs,logger,nnXLen,nnYLen,
-      openCLTunerFile,homeDataDirOverride,openCLReTunePerBoardSize,
+      openCLTunerFile,homeDataDirOverride,openCLReTunePerBoardSize,numEigenIntraOpThreads,
       usingFP16Mode,usingNHWCMode,loadedModel
     );
   }
@@ -151,15 +180,14 @@ NNEvaluator::NNEvaluator(
     modelVersion = NNModelVersion::defaultModelVersion;
     inputsVersion = NNModelVersion::getInputsVersion(modelVersion);
   }
-
-  //Reserve a decent amount above the batch size so that allocation is unlikely.
-  queryQueue.reserve(maxBatchSize * 4 * gpuIdxByServerThread.size());
   //Starts readonly. Becomes writable once we spawn server threads
   queryQueue.setReadOnly();
 }
 
 NNEvaluator::~NNEvaluator() {
   killServerThreads();
+  if(sharedExecutor != NULL)
+    sharedExecutor->removeClient(sharedExecutorClientId);
 
   if(computeContext != NULL)
     NeuralNet::freeComputeContext(computeContext);
@@ -170,6 +198,8 @@ NNEvaluator::~NNEvaluator() {
   loadedModel = NULL;
 
   delete nnCacheTable;
+  delete compactNNCacheTable;
+  delete persistentCache;
 }
 
 string NNEvaluator::getModelName() const {
@@ -294,6 +324,9 @@ enabled_t NNEvaluator::getUsingFP16Mode() const {
 enabled_t NNEvaluator::getUsingNHWCMode() const {
   return usingNHWCMode;
 }
+int NNEvaluator::getNumEigenIntraOpThreads() const {
+  return numEigenIntraOpThreads;
+}
 
 bool NNEvaluator::supportsShorttermError() const {
   return modelVersion >= 9;
@@ -329,15 +362,121 @@ uint64_t NNEvaluator::numBatchesProcessed() const {
 double NNEvaluator::averageProcessedBatchSize() const {
   return (double)numRowsProcessed() / (double)numBatchesProcessed();
 }
+uint64_t NNEvaluator::numEvalsProcessed(int priority) const {
+  return m_numEvalsByPriority[priority].load(std::memory_order_relaxed);
+}
+double NNEvaluator::averageEvalLatency(int priority) const {
+  uint64_t numEvals = numEvalsProcessed(priority);
+  if(numEvals <= 0)
+    return 0.0;
+  return m_totalLatencyNanosByPriority[priority].load(std::memory_order_relaxed) * 1e-9 / (double)numEvals;
+}
+double NNEvaluator::maxEvalLatency(int priority) const {
+  return m_maxLatencyNanosByPriority[priority].load(std::memory_order_relaxed) * 1e-9;
+}
+string NNEvaluator::getPriorityStatsString() const {
+  string ret;
+  for(int priority = 0; priority < NNPriority::NUM_PRIORITIES; priority++) {
+    uint64_t numEvals = numEvalsProcessed(priority);
+    if(numEvals <= 0)
+      continue;
+    if(ret.size() > 0)
+      ret += ", ";
+    ret += Global::strprintf(
+      "%s %llu evals avg %.2fms max %.2fms",
+      NNPriority::toString(priority).c_str(), (unsigned long long)numEvals,
+      averageEvalLatency(priority) * 1000.0, maxEvalLatency(priority) * 1000.0
+    );
+  }
+  return ret;
+}
+
+vector<uint64_t> NNEvaluator::getBatchLatencyHistogram() const {
+  vector<uint64_t> ret(NUM_BATCH_LATENCY_BUCKETS);
+  for(int i = 0; i < NUM_BATCH_LATENCY_BUCKETS; i++)
+    ret[i] = m_numBatchesByLatencyBucket[i].load(std::memory_order_relaxed);
+  return ret;
+}
+string NNEvaluator::getBatchLatencyHistogramString() const {
+  ostringstream out;
+  out << "Backend time per batch:" << "\n";
+  vector<uint64_t> histogram = getBatchLatencyHistogram();
+  for(int i = 0; i < NUM_BATCH_LATENCY_BUCKETS; i++) {
+    if(histogram[i] > 0)
+      out << Global::strprintf("  %9.3fms - %9.3fms %10llu batches", (1 << i) * 0.001, (2 << i) * 0.001, (unsigned long long)histogram[i]) << "\n";
+  }
+  out << "Backend time by batch size:" << "\n";
+  for(int i = 0; i < NUM_BATCH_SIZE_BUCKETS; i++) {
+    uint64_t numBatches = m_numBatchesBySizeBucket[i].load(std::memory_order_relaxed);
+    if(numBatches <= 0)
+      continue;
+    double avgMs = m_backendNanosBySizeBucket[i].load(std::memory_order_relaxed) * 1e-6 / (double)numBatches;
+    int minSize = i == 0 ? 1 : (1 << (i-1)) + 1;
+    out << Global::strprintf("  size %6d - %6d %10llu batches avg %9.3fms", minSize, 1 << i, (unsigned long long)numBatches, avgMs) << "\n";
+  }
+  uint64_t numFillWaits = m_numBatchFillWaits.load(std::memory_order_relaxed);
+  out << Global::strprintf(
+    "Waited to fill %llu batches, avg %.3fms, gaining avg %.2f rows",
+    (unsigned long long)numFillWaits,
+    numFillWaits > 0 ? m_batchFillWaitNanos.load(std::memory_order_relaxed) * 1e-6 / (double)numFillWaits : 0.0,
+    numFillWaits > 0 ? m_numRowsGainedByFillWaits.load(std::memory_order_relaxed) / (double)numFillWaits : 0.0
+  );
+  return out.str();
+}
 
 void NNEvaluator::clearStats() {
   m_numRowsProcessed.store(0);
   m_numBatchesProcessed.store(0);
+  for(int priority = 0; priority < NNPriority::NUM_PRIORITIES; priority++) {
+    m_numEvalsByPriority[priority].store(0);
+    m_totalLatencyNanosByPriority[priority].store(0);
+    m_maxLatencyNanosByPriority[priority].store(0);
+  }
+  for(int i = 0; i < NUM_BATCH_LATENCY_BUCKETS; i++)
+    m_numBatchesByLatencyBucket[i].store(0);
+  for(int i = 0; i < NUM_BATCH_SIZE_BUCKETS; i++) {
+    m_numBatchesBySizeBucket[i].store(0);
+    m_backendNanosBySizeBucket[i].store(0);
+  }
+  m_numBatchFillWaits.store(0);
+  m_batchFillWaitNanos.store(0);
+  m_numRowsGainedByFillWaits.store(0);
 }
 
 void NNEvaluator::clearCache() {
   if(nnCacheTable != NULL)
     nnCacheTable->clear();
+  if(compactNNCacheTable != NULL)
+    compactNNCacheTable->clear();
+}
+
+void NNEvaluator::openPersistentCache(const string& dir, bool readOnly, int64_t maxFileBytes, int maxTurns) {
+  if(debugSkipNeuralNet)
+    return;
+  delete persistentCache;
+  persistentCache = new PersistentNNCache(
+    dir, NeuralNet::getModelDesc(loadedModel).sha256, nnXLen, nnYLen, readOnly, maxFileBytes, logger
+  );
+  persistentCacheMaxTurns = maxTurns;
+}
+
+void NNEvaluator::setUseCanonicalCacheKeys(bool b) {
+  useCanonicalCacheKeys = b;
+}
+
+void NNEvaluator::setPriorityStarvationLimit(int64_t numEvals) {
+  queryQueue.setMaxPassedOver(numEvals);
+}
+
+void NNEvaluator::setMaxBatchFillWait(double seconds) {
+  maxBatchFillWaitSeconds = seconds;
+}
+
+void NNEvaluator::setSharedExecutor(NNSharedExecutor* executor, double weight) {
+  if(sharedExecutor != NULL)
+    sharedExecutor->removeClient(sharedExecutorClientId);
+  sharedExecutor = executor;
+  sharedExecutorClientId = executor == NULL ? -1 : executor->addClient(modelName, weight);
 }
 
 
@@ -431,6 +570,10 @@ void NNEvaluator::serve(
   int64_t numBatchesHandledThisThread = 0;
   int64_t numRowsHandledThisThread = 0;
 
+  //Before creating the handle, so that with one server thread per node each has its own node-local copy of the model,
+  //and any threads the backend spawns for this handle stay on the same node
+  NUMA::maybePinCurrentThread(serverThreadIdx);
+
   ComputeHandle* gpuHandle = NULL;
   if(loadedModel != NULL)
     gpuHandle = NeuralNet::createComputeHandle(
@@ -455,6 +598,11 @@ void NNEvaluator::serve(
 
   vector<NNResultBuf*> resultBufs;
   resultBufs.reserve(maxBatchSize);
+  vector<pair<int,NNResultBuf*>> queuedBufs;
+  queuedBufs.reserve(maxBatchSize);
+
+  NNBatchController batchController(maxBatchFillWaitSeconds);
+  std::chrono::steady_clock::time_point prevBatchTakenTime = std::chrono::steady_clock::now();
 
   vector<NNOutput*> outputBuf;
 
@@ -467,12 +615,38 @@ void NNEvaluator::serve(
   unique_lock<std::mutex> lock(bufferMutex, std::defer_lock);
   while(true) {
     resultBufs.clear();
+    queuedBufs.clear();
     int desiredBatchSize = std::min(maxBatchSize, currentBatchSize.load(std::memory_order_acquire));
-    bool gotAnything = queryQueue.waitPopUpToN(resultBufs,desiredBatchSize);
+    bool gotAnything;
+    {
+      NNProfiler::Section section("server","queueWait");
+      gotAnything = queryQueue.waitPopUpToN(queuedBufs,desiredBatchSize);
+    }
     //Queue being closed is a signal that we're done.
     if(!gotAnything)
       break;
 
+    int numRowsBeforeWait = (int)queuedBufs.size();
+    double waitSeconds = batchController.getWaitSeconds(numRowsBeforeWait,desiredBatchSize);
+    double waitedSeconds = 0.0;
+    if(waitSeconds > 0.0) {
+      NNProfiler::Section section("server","batchFillWait");
+      std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+      queryQueue.waitPopUpToNFor(
+        queuedBufs, desiredBatchSize - numRowsBeforeWait, std::chrono::nanoseconds((int64_t)(waitSeconds * 1e9))
+      );
+      waitedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+      m_numBatchFillWaits.fetch_add(1, std::memory_order_relaxed);
+      m_batchFillWaitNanos.fetch_add((uint64_t)(waitedSeconds * 1e9), std::memory_order_relaxed);
+      m_numRowsGainedByFillWaits.fetch_add(queuedBufs.size() - numRowsBeforeWait, std::memory_order_relaxed);
+    }
+    std::chrono::steady_clock::time_point batchTakenTime = std::chrono::steady_clock::now();
+    double cycleSeconds = std::chrono::duration<double>(batchTakenTime - prevBatchTakenTime).count();
+    prevBatchTakenTime = batchTakenTime;
+
+    for(const pair<int,NNResultBuf*>& queuedBuf: queuedBufs)
+      resultBufs.push_back(queuedBuf.second);
+
     int numRows = (int)resultBufs.size();
     assert(numRows > 0);
 
@@ -550,19 +724,40 @@ void NNEvaluator::serve(
         }
       }
 
+      std::chrono::steady_clock::time_point backendStart;
+      {
+        NNSharedExecutor::Slot slot(sharedExecutor, sharedExecutorClientId);
+        backendStart = std::chrono::steady_clock::now();
+        NNProfiler::Section section("server","getOutput");
 #ifdef QUANTIZED_OUTPUT
-      NeuralNet::getOutput(gpuHandle, buf.inputBuffers, numRows, resultBufs.data(), outputBuf, policyBuf.data());
-      assert(policyBuf.size() >= numRows * NNPos::MAX_NN_POLICY_SIZE);
+        NeuralNet::getOutput(gpuHandle, buf.inputBuffers, numRows, resultBufs.data(), outputBuf, policyBuf.data());
+        assert(policyBuf.size() >= numRows * NNPos::MAX_NN_POLICY_SIZE);
 #else
-      NeuralNet::getOutput(gpuHandle, buf.inputBuffers, numRows, resultBufs.data(), outputBuf);
+        NeuralNet::getOutput(gpuHandle, buf.inputBuffers, numRows, resultBufs.data(), outputBuf);
 #endif
+      }
       assert(outputBuf.size() == numRows);
+      uint64_t backendNanos = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - backendStart
+      ).count();
+      batchController.recordBatch(numRowsBeforeWait, numRows, waitedSeconds, cycleSeconds, backendNanos * 1e-9);
+
+      int latencyBucket = 0;
+      while(latencyBucket < NUM_BATCH_LATENCY_BUCKETS-1 && (backendNanos / 1000) >= ((uint64_t)2 << latencyBucket))
+        latencyBucket++;
+      int sizeBucket = 0;
+      while(sizeBucket < NUM_BATCH_SIZE_BUCKETS-1 && numRows > (1 << sizeBucket))
+        sizeBucket++;
+      m_numBatchesByLatencyBucket[latencyBucket].fetch_add(1, std::memory_order_relaxed);
+      m_numBatchesBySizeBucket[sizeBucket].fetch_add(1, std::memory_order_relaxed);
+      m_backendNanosBySizeBucket[sizeBucket].fetch_add(backendNanos, std::memory_order_relaxed);
 
       m_numRowsProcessed.fetch_add(numRows, std::memory_order_relaxed);
       m_numBatchesProcessed.fetch_add(1, std::memory_order_relaxed);
       numRowsHandledThisThread += numRows;
       numBatchesHandledThisThread += 1;
 
+      NNProfiler::Section deliverSection("server","deliver");
       for(int row = 0; row < numRows; row++) {
         assert(resultBufs[row] != NULL);
         NNResultBuf* resultBuf = resultBufs[row];
@@ -657,6 +852,25 @@ std::shared_ptr<NNOutput>* NNEvaluator::averageMultipleSymmetries(
   return new std::shared_ptr<NNOutput>(new NNOutput(ptrs));
 }
 
+//Copy of output for the board transformed by symmetry, with its policy moved to the transformed locations
+static shared_ptr<NNOutput> transformCachedOutput(const NNOutput& output, const Board& board, int symmetry, Hash128 nnHash) {
+  shared_ptr<NNOutput> ret = std::make_shared<NNOutput>(output);
+  for(int y = 0; y<board.y_size; y++) {
+    for(int x = 0; x<board.x_size; x++) {
+      int pos = NNPos::xyToPos(x,y,output.nnXLen);
+      Loc symLoc = SymmetryHelpers::getSymLoc(x,y,board,symmetry);
+      int symPos = NNPos::locToPos(symLoc,board.x_size,output.nnXLen,output.nnYLen);
+#ifdef QUANTIZED_OUTPUT
+      ret->policyProbsQuantized[symPos] = output.policyProbsQuantized[pos];
+#else
+      ret->policyProbs[symPos] = output.policyProbs[pos];
+#endif
+    }
+  }
+  ret->nnHash = nnHash;
+  return ret;
+}
+
 void NNEvaluator::evaluate(
   Board& board,
   const BoardHistory& history,
@@ -706,14 +920,41 @@ void NNEvaluator::evaluate(
     nnInputParams.policyOptimism = 0.0;
 
   Hash128 nnHash = NNInputs::getHash(board, history, nextPlayer, nnInputParams);
+  Hash128 metaHash;
   if(numInputMetaChannels > 0) {
     if(sgfMeta == NULL)
       Global::fatalError("SGFMetadata is required for " + modelName + " but was not provided");
     if(!sgfMeta->initialized)
       Global::fatalError("SGFMetadata is required for " + modelName + " but was not initialized. Did you specify humanSLProfile=... in katago's config or via overrides?");
-    nnHash ^= sgfMeta->getHash(nextPlayer);
+    metaHash = sgfMeta->getHash(nextPlayer);
+    nnHash ^= metaHash;
+  }
+
+  //The key and orientation of this position in the caches, see setUseCanonicalCacheKeys
+  Hash128 cacheHash = nnHash;
+  int cacheSymmetry = 0;
+  if(useCanonicalCacheKeys && (nnCacheTable != NULL || compactNNCacheTable != NULL || persistentCache != NULL)) {
+    cacheHash = NNInputs::getCanonicalHash(board, history, nextPlayer, nnInputParams, cacheSymmetry);
+    cacheHash ^= metaHash;
   }
-  if(nnCacheTable != NULL && !skipCache && nnCacheTable->get(nnHash,buf.result)) {
+
+  if(
+    !skipCache &&
+    ((nnCacheTable != NULL && nnCacheTable->get(cacheHash,buf.result)) ||
+     (compactNNCacheTable != NULL && compactNNCacheTable->get(cacheHash,buf.result)))
+  ) {
+    if(cacheSymmetry != 0)
+      buf.result = transformCachedOutput(*buf.result, board, SymmetryHelpers::invert(cacheSymmetry), nnHash);
+    buf.hasResult = true;
+    return;
+  }
+  if(persistentCache != NULL && !skipCache && persistentCache->get(cacheHash,buf.result)) {
+    if(nnCacheTable != NULL)
+      nnCacheTable->set(buf.result);
+    if(compactNNCacheTable != NULL)
+      compactNNCacheTable->set(buf.result);
+    if(cacheSymmetry != 0)
+      buf.result = transformCachedOutput(*buf.result, board, SymmetryHelpers::invert(cacheSymmetry), nnHash);
     buf.hasResult = true;
     return;
   }
@@ -722,14 +963,23 @@ void NNEvaluator::evaluate(
   buf.boardYSizeForServer = board.y_size;
 
   //if(nnInputParams.useVCFInput && history.rules.maxMoves == 0)
+  {
+    NNProfiler::Section section("client","resultsBeforeNN");
     nnInputParams.resultsBeforeNN.init(board, history, nextPlayer);
+  }
   //else
   //  nnInputParams.useVCFInput = false;
 
   if(!debugSkipNeuralNet) {
+    NNProfiler::Section section("client","fillInputs");
+    //The features are filled as floats on this thread and only handed to the server packed
+    static thread_local std::vector<float> rowSpatialBuf;
     const int rowSpatialLen = NNModelVersion::getNumSpatialFeatures(modelVersion) * nnXLen * nnYLen;
-    if(buf.rowSpatialBuf.size() < rowSpatialLen)
-      buf.rowSpatialBuf.resize(rowSpatialLen);
+    if(rowSpatialBuf.size() < rowSpatialLen)
+      rowSpatialBuf.resize(rowSpatialLen);
+    const int rowSpatialPackedLen = NNInputs::getPackedRowLen(rowSpatialLen);
+    if(buf.rowSpatialPackedBuf.size() < rowSpatialPackedLen)
+      buf.rowSpatialPackedBuf.resize(rowSpatialPackedLen);
     const int rowGlobalLen = NNModelVersion::getNumGlobalFeatures(modelVersion);
     if(buf.rowGlobalBuf.size() < rowGlobalLen)
       buf.rowGlobalBuf.resize(rowGlobalLen);
@@ -739,16 +989,17 @@ void NNEvaluator::evaluate(
 
     //static_assert(NNModelVersion::latestInputsVersionImplemented == 10, "");
     //if(inputsVersion == 97)
-    //  NNInputs::fillRowV97(board, history, nextPlayer, nnInputParamsWithResultsBeforeNN, nnXLen, nnYLen, inputsUseNHWC, buf.rowSpatialBuf.data(), buf.rowGlobalBuf.data());
+    //  NNInputs::fillRowV97(board, history, nextPlayer, nnInputParamsWithResultsBeforeNN, nnXLen, nnYLen, inputsUseNHWC, rowSpatialBuf.data(), buf.rowGlobalBuf.data());
     //else
     if(inputsVersion == 7)
-      NNInputs::fillRowV7(board, history, nextPlayer, nnInputParams, nnXLen, nnYLen, inputsUseNHWC, buf.rowSpatialBuf.data(), buf.rowGlobalBuf.data());
+      NNInputs::fillRowV7(board, history, nextPlayer, nnInputParams, nnXLen, nnYLen, inputsUseNHWC, rowSpatialBuf.data(), buf.rowGlobalBuf.data());
     else if(inputsVersion == 10)
-      NNInputs::fillRowV10(board, history, nextPlayer, nnInputParams, nnXLen, nnYLen, inputsUseNHWC, buf.rowSpatialBuf.data(), buf.rowGlobalBuf.data());
+      NNInputs::fillRowV10(board, history, nextPlayer, nnInputParams, nnXLen, nnYLen, inputsUseNHWC, rowSpatialBuf.data(), buf.rowGlobalBuf.data());
     else if(inputsVersion == 101)
-      NNInputs::fillRowV101(board, history, nextPlayer, nnInputParams, nnXLen, nnYLen, inputsUseNHWC, buf.rowSpatialBuf.data(), buf.rowGlobalBuf.data());
+      NNInputs::fillRowV101(board, history, nextPlayer, nnInputParams, nnXLen, nnYLen, inputsUseNHWC, rowSpatialBuf.data(), buf.rowGlobalBuf.data());
     else
       ASSERT_UNREACHABLE;
+    NNInputs::packBinaryRow(rowSpatialBuf.data(), rowSpatialLen, buf.rowSpatialPackedBuf.data());
 
     if(rowMetaLen > 0) {
       if(sgfMeta == NULL)
@@ -770,25 +1021,41 @@ void NNEvaluator::evaluate(
 
   buf.symmetry = nnInputParams.symmetry;
   buf.policyOptimism = nnInputParams.policyOptimism;
+  buf.priority = std::min(std::max(nnInputParams.priority, 0), NNPriority::NUM_PRIORITIES-1);
 
-  unique_lock<std::mutex> lock(bufferMutex);
-  numOngoingEvals += 1;
-  lock.unlock();
-
-  bool suc = queryQueue.forcePush(&buf);
-  assert(suc);
+  {
+    NNProfiler::Section section("client","waitForResult");
+    std::chrono::steady_clock::time_point queuedTime = std::chrono::steady_clock::now();
+    unique_lock<std::mutex> lock(bufferMutex);
+    numOngoingEvals += 1;
+    lock.unlock();
 
-  unique_lock<std::mutex> resultLock(buf.resultMutex);
-  while(!buf.hasResult)
-    buf.clientWaitingForResult.wait(resultLock);
-  resultLock.unlock();
+    bool suc = queryQueue.forcePush(std::make_pair(buf.priority,&buf));
+    assert(suc);
+
+    unique_lock<std::mutex> resultLock(buf.resultMutex);
+    while(!buf.hasResult)
+      buf.clientWaitingForResult.wait(resultLock);
+    resultLock.unlock();
+
+    uint64_t latencyNanos = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - queuedTime
+    ).count();
+    m_numEvalsByPriority[buf.priority].fetch_add(1,std::memory_order_relaxed);
+    m_totalLatencyNanosByPriority[buf.priority].fetch_add(latencyNanos,std::memory_order_relaxed);
+    uint64_t maxLatencyNanos = m_maxLatencyNanosByPriority[buf.priority].load(std::memory_order_relaxed);
+    while(latencyNanos > maxLatencyNanos &&
+          !m_maxLatencyNanosByPriority[buf.priority].compare_exchange_weak(maxLatencyNanos,latencyNanos,std::memory_order_relaxed))
+    {}
+  }
 
   //Perform postprocessing on the result - turn the nn output into probabilities
   //As a hack though, if the only thing we were missing was the ownermap, just grab the old policy and values
   //and use those. This avoids recomputing in a randomly different orientation when we just need the ownermap
   //and causing policy weights to be different, which would reduce performance of successive searches in a game
   //by making the successive searches distribute their playouts less coherently and using the cache more poorly.
-  
+  NNProfiler::Section postprocessSection("client","postprocess");
+
 #ifdef QUANTIZED_OUTPUT
     float* policy = buf.policyResult;
 #else
@@ -817,6 +1084,21 @@ void NNEvaluator::evaluate(
         !history.maybePassMove(nextPlayer)) {
         isLegal[NNPos::locToPos(Board::PASS_LOC, xSize, nnXLen, nnYLen)] = false;
       }
+      //Opponent has a VCF, every move other than the defences loses
+      if(resultsBeforeNN.myDefenceLocs.size() > 0) {
+        bool isDefence[NNPos::MAX_NN_POLICY_SIZE];
+        std::fill(isDefence, isDefence + policySize, false);
+        bool anyLegalDefence = false;
+        for(Loc loc: resultsBeforeNN.myDefenceLocs) {
+          int pos = NNPos::locToPos(loc, xSize, nnXLen, nnYLen);
+          isDefence[pos] = true;
+          anyLegalDefence = anyLegalDefence || isLegal[pos];
+        }
+        for(int i = 0; i < policySize && anyLegalDefence; i++) {
+          if(!isDefence[i] && i != NNPos::locToPos(Board::PASS_LOC, xSize, nnXLen, nnYLen))
+            isLegal[i] = false;
+        }
+      }
     } 
     else  // assume all other moves are illegal
     {
@@ -990,10 +1272,18 @@ void NNEvaluator::evaluate(
     buf.result->policyProbsQuantized[i] = NNOutput::policyQuant(policy[i]);
 #endif
 
-  //And record the nnHash in the result and put it into the table
+  //And record the nnHash in the result and put it into the table, in the canonical orientation if that's not this one
   buf.result->nnHash = nnHash;
+  if(nnCacheTable == NULL && compactNNCacheTable == NULL && persistentCache == NULL)
+    return;
+  shared_ptr<NNOutput> cacheResult =
+    cacheSymmetry == 0 ? buf.result : transformCachedOutput(*buf.result, board, cacheSymmetry, cacheHash);
   if(nnCacheTable != NULL)
-    nnCacheTable->set(buf.result);
+    nnCacheTable->set(cacheResult);
+  if(compactNNCacheTable != NULL)
+    compactNNCacheTable->set(cacheResult);
+  if(persistentCache != NULL && (persistentCacheMaxTurns < 0 || history.moveHistory.size() <= persistentCacheMaxTurns))
+    persistentCache->add(*cacheResult);
 
 }
 
@@ -1020,6 +1310,7 @@ NNCacheTable::NNCacheTable(int sizePowerOfTwo, int mutexPoolSizePowerOfTwo) {
   tableSize = ((uint64_t)1) << sizePowerOfTwo;
   tableMask = tableSize-1;
   entries = new Entry[tableSize];
+  NUMA::maybeInterleave(entries, tableSize * sizeof(Entry));
   uint32_t mutexPoolSize = ((uint32_t)1) << mutexPoolSizePowerOfTwo;
   mutexPoolMask = mutexPoolSize-1;
   mutexPool = new MutexPool(mutexPoolSize);
@@ -1087,3 +1378,234 @@ void NNCacheTable::clear() {
     buf.reset();
   }
 }
+
+//-------------------------------------------------------------------------------------
+
+//Legal moves keep at least this policy in 8 bit records
+static const double COMPACT_MIN_POLICY = 1e-6;
+
+CompactNNOutputCodec::CompactNNOutputCodec(int policyBits, int xLen, int yLen)
+  :nnXLen(xLen),
+   nnYLen(yLen),
+   policySize(NNPos::getPolicySize(xLen,yLen)),
+#ifdef QUANTIZED_OUTPUT
+   //Policies are already 8 bits in NNOutput, they're stored as they are
+   policyBytesPerMove(1),
+#else
+   policyBytesPerMove(policyBits / 8),
+#endif
+   //Keep the headers 8-byte aligned
+   recordBytes((sizeof(Header) + (size_t)policySize * policyBytesPerMove + 7) / 8 * 8)
+{
+  if(policyBits != 8 && policyBits != 16)
+    throw StringError("CompactNNOutputCodec: Invalid policyBits, must be 8 or 16: " + Global::intToString(policyBits));
+
+  //Code 0 is for illegal moves, codes 1-255 are spaced evenly in log space from COMPACT_MIN_POLICY to 1
+  policyDecodeTable[0] = -1.0f;
+  for(int i = 1; i<256; i++)
+    policyDecodeTable[i] = (float)exp(log(COMPACT_MIN_POLICY) * (255 - i) / 254.0);
+}
+
+static inline uint16_t encodeUnitProb(float p) {
+  return (uint16_t)std::min(65535.0f, std::max(0.0f, p * 65535.0f + 0.5f));
+}
+
+void CompactNNOutputCodec::encode(const NNOutput& output, uint8_t* record) const {
+  Header* header = (Header*)record;
+  header->hash0 = output.nnHash.hash0;
+  header->hash1 = output.nnHash.hash1;
+  header->varTimeLeft = output.varTimeLeft;
+  header->shorttermWinlossError = output.shorttermWinlossError;
+  header->policyOptimismUsed = output.policyOptimismUsed;
+  header->whiteWinProb = encodeUnitProb(output.whiteWinProb);
+  header->whiteLossProb = encodeUnitProb(output.whiteLossProb);
+  header->whiteNoResultProb = encodeUnitProb(output.whiteNoResultProb);
+  header->isUsed = 1;
+  header->isReferenced = 0;
+
+  uint8_t* policyData = record + sizeof(Header);
+#ifdef QUANTIZED_OUTPUT
+  std::copy(output.policyProbsQuantized, output.policyProbsQuantized + policySize, (int8_t*)policyData);
+#else
+  if(policyBytesPerMove == 2) {
+    //Round to nearest, keeping the sign, so that illegal moves stay negative
+    uint16_t* policy16 = (uint16_t*)policyData;
+    for(int i = 0; i<policySize; i++) {
+      uint32_t bits;
+      std::memcpy(&bits, &output.policyProbs[i], sizeof(bits));
+      bits += 0x7FFF + ((bits >> 16) & 1);
+      policy16[i] = (uint16_t)(bits >> 16);
+    }
+  }
+  else {
+    const double logMin = log(COMPACT_MIN_POLICY);
+    for(int i = 0; i<policySize; i++) {
+      float p = output.policyProbs[i];
+      if(p < 0)
+        policyData[i] = 0;
+      else if(p <= COMPACT_MIN_POLICY)
+        policyData[i] = 1;
+      else
+        policyData[i] = (uint8_t)std::min(255, 255 - (int)round(log(p) / logMin * 254.0));
+    }
+  }
+#endif
+  //Zero the padding, so that records of the same output are the same bytes
+  std::fill(policyData + (size_t)policySize * policyBytesPerMove, record + recordBytes, (uint8_t)0);
+}
+
+void CompactNNOutputCodec::decode(const uint8_t* record, NNOutput& output) const {
+  const Header* header = (const Header*)record;
+  output.nnHash = Hash128(header->hash0, header->hash1);
+  output.whiteWinProb = header->whiteWinProb / 65535.0f;
+  output.whiteLossProb = header->whiteLossProb / 65535.0f;
+  output.whiteNoResultProb = header->whiteNoResultProb / 65535.0f;
+  output.varTimeLeft = header->varTimeLeft;
+  output.shorttermWinlossError = header->shorttermWinlossError;
+  output.policyOptimismUsed = header->policyOptimismUsed;
+  output.nnXLen = nnXLen;
+  output.nnYLen = nnYLen;
+
+  const uint8_t* policyData = record + sizeof(Header);
+#ifdef QUANTIZED_OUTPUT
+  std::copy((const int8_t*)policyData, (const int8_t*)policyData + policySize, output.policyProbsQuantized);
+  for(int i = policySize; i<NNPos::MAX_NN_POLICY_SIZE; i++)
+    output.policyProbsQuantized[i] = (int8_t)NNOutput::policyQuant(-1.0f);
+#else
+  if(policyBytesPerMove == 2) {
+    const uint16_t* policy16 = (const uint16_t*)policyData;
+    for(int i = 0; i<policySize; i++) {
+      uint32_t bits = ((uint32_t)policy16[i]) << 16;
+      std::memcpy(&output.policyProbs[i], &bits, sizeof(bits));
+    }
+  }
+  else {
+    for(int i = 0; i<policySize; i++)
+      output.policyProbs[i] = policyDecodeTable[policyData[i]];
+  }
+  for(int i = policySize; i<NNPos::MAX_NN_POLICY_SIZE; i++)
+    output.policyProbs[i] = -1.0f;
+#endif
+}
+
+//-------------------------------------------------------------------------------------
+
+CompactNNCacheTable::CompactNNCacheTable(int64_t maxBytes, int policyBits, int xLen, int yLen, int mutexPoolSizePowerOfTwo)
+  :codec(policyBits,xLen,yLen)
+{
+  if(mutexPoolSizePowerOfTwo < 0 || mutexPoolSizePowerOfTwo > 31)
+    throw StringError("CompactNNCacheTable: Invalid mutexPoolSizePowerOfTwo: " + Global::intToString(mutexPoolSizePowerOfTwo));
+  if(maxBytes < (int64_t)(codec.recordBytes * NUM_WAYS))
+    throw StringError("CompactNNCacheTable: Memory budget too small for even one bucket: " + Global::int64ToString(maxBytes));
+  numBuckets = (uint64_t)maxBytes / (codec.recordBytes * NUM_WAYS);
+
+  entryData = new uint8_t[numBuckets * NUM_WAYS * codec.recordBytes]();
+  NUMA::maybeInterleave(entryData, numBuckets * NUM_WAYS * codec.recordBytes);
+  clockHands = new uint8_t[numBuckets]();
+  uint32_t mutexPoolSize = ((uint32_t)1) << mutexPoolSizePowerOfTwo;
+  mutexPoolMask = mutexPoolSize-1;
+  mutexPool = new MutexPool(mutexPoolSize);
+}
+
+CompactNNCacheTable::~CompactNNCacheTable() {
+  delete[] entryData;
+  delete[] clockHands;
+  delete mutexPool;
+}
+
+uint64_t CompactNNCacheTable::getNumEntries() const {
+  return numBuckets * NUM_WAYS;
+}
+size_t CompactNNCacheTable::getEntryBytes() const {
+  return codec.recordBytes;
+}
+
+bool CompactNNCacheTable::get(Hash128 nnHash, shared_ptr<NNOutput>& ret) {
+  //Free ret BEFORE locking, to avoid any expensive operations while locked.
+  if(ret != nullptr)
+    ret.reset();
+
+  const size_t entryBytes = codec.recordBytes;
+  static thread_local std::vector<uint8_t> entryBuf;
+  if(entryBuf.size() < entryBytes)
+    entryBuf.resize(entryBytes);
+
+  uint64_t bucketIdx = nnHash.hash0 % numBuckets;
+  uint8_t* bucket = entryData + bucketIdx * NUM_WAYS * entryBytes;
+  std::mutex& mutex = mutexPool->getMutex((uint32_t)bucketIdx & mutexPoolMask);
+
+  bool found = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for(int way = 0; way<NUM_WAYS; way++) {
+      uint8_t* entry = bucket + way * entryBytes;
+      CompactNNOutputCodec::Header* header = (CompactNNOutputCodec::Header*)entry;
+      if(header->isUsed && CompactNNOutputCodec::matches(entry,nnHash)) {
+        header->isReferenced = 1;
+        std::memcpy(entryBuf.data(), entry, entryBytes);
+        found = true;
+        break;
+      }
+    }
+  }
+  if(!found)
+    return false;
+
+  ret = std::make_shared<NNOutput>();
+  codec.decode(entryBuf.data(), *ret);
+  return true;
+}
+
+void CompactNNCacheTable::set(const shared_ptr<NNOutput>& p) {
+  //Encode right now, before locking, to avoid any expensive operations while locked.
+  const size_t entryBytes = codec.recordBytes;
+  static thread_local std::vector<uint8_t> entryBuf;
+  if(entryBuf.size() < entryBytes)
+    entryBuf.resize(entryBytes);
+  codec.encode(*p, entryBuf.data());
+
+  uint64_t bucketIdx = p->nnHash.hash0 % numBuckets;
+  uint8_t* bucket = entryData + bucketIdx * NUM_WAYS * entryBytes;
+  std::mutex& mutex = mutexPool->getMutex((uint32_t)bucketIdx & mutexPoolMask);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  //Overwrite the same position if it's there, else take a free way, else sweep the clock hand past referenced entries,
+  //clearing their bits, to the first unreferenced one. New entries start unreferenced, so an entry that never gets a hit
+  //is the first to go, ahead of older ones that did.
+  int targetWay = -1;
+  for(int way = 0; way<NUM_WAYS; way++) {
+    const uint8_t* entry = bucket + way * entryBytes;
+    const CompactNNOutputCodec::Header* header = (const CompactNNOutputCodec::Header*)entry;
+    if(header->isUsed && CompactNNOutputCodec::matches(entry,p->nnHash)) {
+      targetWay = way;
+      break;
+    }
+    if(!header->isUsed && targetWay < 0)
+      targetWay = way;
+  }
+  if(targetWay < 0) {
+    int hand = clockHands[bucketIdx];
+    while(true) {
+      CompactNNOutputCodec::Header* header = (CompactNNOutputCodec::Header*)(bucket + hand * entryBytes);
+      if(!header->isReferenced)
+        break;
+      header->isReferenced = 0;
+      hand = (hand + 1) % NUM_WAYS;
+    }
+    targetWay = hand;
+    clockHands[bucketIdx] = (uint8_t)((hand + 1) % NUM_WAYS);
+  }
+  std::memcpy(bucket + targetWay * entryBytes, entryBuf.data(), entryBytes);
+}
+
+void CompactNNCacheTable::clear() {
+  const size_t entryBytes = codec.recordBytes;
+  for(uint64_t bucketIdx = 0; bucketIdx<numBuckets; bucketIdx++) {
+    uint8_t* bucket = entryData + bucketIdx * NUM_WAYS * entryBytes;
+    std::mutex& mutex = mutexPool->getMutex((uint32_t)bucketIdx & mutexPoolMask);
+    std::lock_guard<std::mutex> lock(mutex);
+    for(int way = 0; way<NUM_WAYS; way++)
+      ((CompactNNOutputCodec::Header*)(bucket + way * entryBytes))->isUsed = 0;
+    clockHands[bucketIdx] = 0;
+  }
+}
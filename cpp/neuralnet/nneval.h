@@ -16,6 +16,8 @@
 #include "../search/mutexpool.h"
 
 class NNEvaluator;
+class PersistentNNCache;
+class NNSharedExecutor;
 
 class NNCacheTable {
   struct Entry {
@@ -43,6 +45,75 @@ class NNCacheTable {
   void clear();
 };
 
+//Packs an NNOutput into a fixed size record and back: the policy at 8 or 16 bits per move and only over nnXLen * nnYLen,
+//and the values packed. 16 bits keeps the top half of the float (about 3 significant digits), 8 bits is logarithmic
+//from 1e-6 to 1 (within 3%). Records are plain bytes, so they can be kept in big flat arrays or in files.
+struct CompactNNOutputCodec {
+  struct Header {
+    uint64_t hash0;
+    uint64_t hash1;
+    float varTimeLeft;
+    float shorttermWinlossError;
+    float policyOptimismUsed;
+    uint16_t whiteWinProb; //Scaled by 65535
+    uint16_t whiteLossProb;
+    uint16_t whiteNoResultProb;
+    //Not touched by decode, free for the users of the records. Encode sets isUsed to 1 and isReferenced to 0.
+    uint8_t isUsed;
+    uint8_t isReferenced;
+    //Followed by policySize 8 or 16 bit policy values
+  };
+
+  const int nnXLen;
+  const int nnYLen;
+  const int policySize;
+  const int policyBytesPerMove;
+  const size_t recordBytes; //A multiple of 8
+  float policyDecodeTable[256];
+
+  CompactNNOutputCodec(int policyBits, int nnXLen, int nnYLen);
+
+  void encode(const NNOutput& output, uint8_t* record) const;
+  void decode(const uint8_t* record, NNOutput& output) const;
+  static inline bool matches(const uint8_t* record, Hash128 nnHash) {
+    const Header* header = (const Header*)record;
+    return header->hash0 == nnHash.hash0 && header->hash1 == nnHash.hash1;
+  }
+};
+
+//Alternative to NNCacheTable that fits many more evaluations in the same memory, for analysis and other uses that revisit
+//a lot of positions. Rather than keeping a shared NNOutput per entry, entries are CompactNNOutputCodec records stored
+//inline. The table is split into buckets of NUM_WAYS entries, as many as fit in the memory budget, and replaces entries
+//within a bucket by the clock algorithm, so that entries that get hit stay longer than ones that never do.
+//Hits build a new NNOutput from the entry, with the policy rounded.
+class CompactNNCacheTable {
+ public:
+  static constexpr int NUM_WAYS = 4;
+
+ private:
+  const CompactNNOutputCodec codec;
+  uint64_t numBuckets;
+  uint8_t* entryData; //numBuckets * NUM_WAYS records
+  uint8_t* clockHands; //Per bucket, the next way to consider replacing
+  MutexPool* mutexPool;
+  uint32_t mutexPoolMask;
+
+ public:
+  CompactNNCacheTable(int64_t maxBytes, int policyBits, int nnXLen, int nnYLen, int mutexPoolSizePowerOfTwo);
+  ~CompactNNCacheTable();
+
+  CompactNNCacheTable(const CompactNNCacheTable& other) = delete;
+  CompactNNCacheTable& operator=(const CompactNNCacheTable& other) = delete;
+
+  //These are thread-safe. For get, ret will be set to nullptr upon a failure to find.
+  bool get(Hash128 nnHash, std::shared_ptr<NNOutput>& ret);
+  void set(const std::shared_ptr<NNOutput>& p);
+  void clear();
+
+  uint64_t getNumEntries() const;
+  size_t getEntryBytes() const;
+};
+
 //Each thread should allocate and re-use one of these
 struct NNResultBuf {
   std::condition_variable clientWaitingForResult;
@@ -50,7 +121,7 @@ struct NNResultBuf {
   bool hasResult;
   int boardXSizeForServer;
   int boardYSizeForServer;
-  std::vector<float> rowSpatialBuf;
+  std::vector<uint8_t> rowSpatialPackedBuf; //Packed by NNInputs::packBinaryRow
   std::vector<float> rowGlobalBuf;
   std::vector<float> rowMetaBuf;
   bool hasRowMeta;
@@ -58,6 +129,7 @@ struct NNResultBuf {
   bool errorLogLockout; //error flag to restrict log to 1 error to prevent spam
   int symmetry; //The symmetry to use for this eval
   double policyOptimism;  // The policy optimism to use for this eval
+  int priority; //The NNPriority of this eval
 #ifdef QUANTIZED_OUTPUT
   float policyResult[NNPos::MAX_NN_POLICY_SIZE];
 #endif
@@ -90,10 +162,13 @@ class NNEvaluator {
     bool inputsUseNHWC,
     int nnCacheSizePowerOfTwo,
     int nnMutexPoolSizePowerofTwo,
+    int64_t nnCacheMemoryBytes,
+    int nnCachePolicyBits,
     bool debugSkipNeuralNet,
     const std::string& openCLTunerFile,
     const std::string& homeDataDirOverride,
     bool openCLReTunePerBoardSize,
+    int numEigenIntraOpThreads,
     enabled_t useFP16Mode,
     enabled_t useNHWCMode,
     int numThreads,
@@ -127,6 +202,7 @@ class NNEvaluator {
   double getTrunkSpatialConvDepth() const;
   enabled_t getUsingFP16Mode() const;
   enabled_t getUsingNHWCMode() const;
+  int getNumEigenIntraOpThreads() const;
 
   //Check if the loaded neural net supports shorttermError fields
   bool supportsShorttermError() const;
@@ -138,6 +214,24 @@ class NNEvaluator {
   //Clear all entires cached in the table
   void clearCache();
 
+  //Also look up evaluations in, and add new ones to, the persistent cache file for this model in dir, see PersistentNNCache.
+  //Only positions at most maxTurns moves into the game are added, any if maxTurns < 0. Does nothing if debugSkipNeuralNet.
+  //Not threadsafe, call before any evaluations.
+  void openPersistentCache(const std::string& dir, bool readOnly, int64_t maxFileBytes, int maxTurns);
+  //Key the caches by NNInputs::getCanonicalHash, so that all the symmetries of a position share one entry, stored in
+  //the canonical orientation and transformed back on lookup. Not threadsafe, call before any evaluations.
+  void setUseCanonicalCacheKeys(bool b);
+  //When forming batches, evals of higher NNPriority are taken first, but an eval that has had more than this many evals
+  //of higher priority taken ahead of it while it was next in its own priority is taken regardless.
+  //Not threadsafe, call before any evaluations.
+  void setPriorityStarvationLimit(int64_t numEvals);
+  //Let server threads wait up to this long for more evals to fill a batch, when NNBatchController expects that to
+  //improve throughput. 0 to never wait, the default. Not threadsafe, call before spawnServerThreads.
+  void setMaxBatchFillWait(double seconds);
+  //Run batches only while holding a slot of executor, which must outlive this evaluator, competing for slots with the
+  //other evaluators using it in proportion to weight. Not threadsafe, call before spawnServerThreads.
+  void setSharedExecutor(NNSharedExecutor* executor, double weight);
+
   //Queue a position for the next neural net batch evaluation and wait for it. Upon evaluation, result
   //will be supplied in NNResultBuf& buf, the shared_ptr there can grabbed via std::move if desired.
   //logStream is for some error logging, can be NULL.
@@ -201,6 +295,19 @@ class NNEvaluator {
   uint64_t numRowsProcessed() const;
   uint64_t numBatchesProcessed() const;
   double averageProcessedBatchSize() const;
+  //For evals of each NNPriority that went to the neural net, how many, and the average and maximum seconds from being
+  //queued until the result was ready
+  uint64_t numEvalsProcessed(int priority) const;
+  double averageEvalLatency(int priority) const;
+  double maxEvalLatency(int priority) const;
+  //Summary of the above for the priorities that had any evals, for logging
+  std::string getPriorityStatsString() const;
+  //Number of batches by the time the backend took on them, bucket i for [2^i, 2^(i+1)) microseconds
+  std::vector<uint64_t> getBatchLatencyHistogram() const;
+  //For logging, the histogram above, the average backend time by batch size, and what waiting to fill batches gained
+  std::string getBatchLatencyHistogramString() const;
+  static constexpr int NUM_BATCH_LATENCY_BUCKETS = 24;
+  static constexpr int NUM_BATCH_SIZE_BUCKETS = 18;
 
   void clearStats();
 
@@ -214,6 +321,7 @@ class NNEvaluator {
   const bool inputsUseNHWC;
   const enabled_t usingFP16Mode;
   const enabled_t usingNHWCMode;
+  const int numEigenIntraOpThreads;
   int numThreads;
   std::vector<int> gpuIdxByServerThread;
   const std::string randSeed;
@@ -221,7 +329,15 @@ class NNEvaluator {
 
   ComputeContext* computeContext;
   LoadedModel* loadedModel;
+  //At most one of these is used, the compact one if nnCacheMemoryBytes > 0, else the other if nnCacheSizePowerOfTwo >= 0
   NNCacheTable* nnCacheTable;
+  CompactNNCacheTable* compactNNCacheTable;
+  PersistentNNCache* persistentCache;
+  int persistentCacheMaxTurns;
+  bool useCanonicalCacheKeys;
+  double maxBatchFillWaitSeconds;
+  NNSharedExecutor* sharedExecutor;
+  int sharedExecutorClientId;
   Logger* logger;
 
   std::string internalModelName;
@@ -240,6 +356,15 @@ class NNEvaluator {
   //Counters for statistics
   std::atomic<uint64_t> m_numRowsProcessed;
   std::atomic<uint64_t> m_numBatchesProcessed;
+  std::atomic<uint64_t> m_numEvalsByPriority[NNPriority::NUM_PRIORITIES];
+  std::atomic<uint64_t> m_totalLatencyNanosByPriority[NNPriority::NUM_PRIORITIES];
+  std::atomic<uint64_t> m_maxLatencyNanosByPriority[NNPriority::NUM_PRIORITIES];
+  std::atomic<uint64_t> m_numBatchesByLatencyBucket[NUM_BATCH_LATENCY_BUCKETS];
+  std::atomic<uint64_t> m_numBatchesBySizeBucket[NUM_BATCH_SIZE_BUCKETS];
+  std::atomic<uint64_t> m_backendNanosBySizeBucket[NUM_BATCH_SIZE_BUCKETS];
+  std::atomic<uint64_t> m_numBatchFillWaits;
+  std::atomic<uint64_t> m_batchFillWaitNanos;
+  std::atomic<uint64_t> m_numRowsGainedByFillWaits;
 
   mutable std::mutex bufferMutex;
 
@@ -264,8 +389,8 @@ class NNEvaluator {
   // Modifiable batch size smaller than maxBatchSize
   std::atomic<int> currentBatchSize;
 
-  // Queued up requests
-  ThreadSafeQueue<NNResultBuf*> queryQueue;
+  // Queued up requests, one lane per NNPriority
+  ThreadSafeLaneQueue<NNResultBuf*> queryQueue;
  public:
   //Helper, for internal use only
   void serve(NNServerBuf& buf, Rand& rand, int gpuIdxForThisThread, int serverThreadIdx);
@@ -35,6 +35,29 @@ int NNPos::getPolicySize(int nnXLen, int nnYLen) {
   return nnXLen * nnYLen + 1;
 }
 
+//-----------------------------------------------------------------------------------------------------------
+
+int NNPriority::parse(const string& s) {
+  string lower = Global::toLower(Global::trim(s));
+  if(lower == "high")
+    return HIGH;
+  if(lower == "normal")
+    return NORMAL;
+  if(lower == "low")
+    return LOW;
+  throw StringError("Unknown neural net evaluation priority: " + s + ", expected high, normal, or low");
+}
+
+string NNPriority::toString(int priority) {
+  if(priority == HIGH)
+    return "high";
+  if(priority == NORMAL)
+    return "normal";
+  if(priority == LOW)
+    return "low";
+  return "unknown";
+}
+
 //-----------------------------------------------------------------------------------------------------------
 //-----------------------------------------------------------------------------------------------------------
 
@@ -275,7 +298,8 @@ void NNOutput::debugPrint(ostream& out, const Board& board) {
 
 //-------------------------------------------------------------------------------------------------------------
 
-static void copyWithSymmetry(const float* src, float* dst, int nSize, int hSize, int wSize, int cSize, bool useNHWC, int symmetry, bool reverse) {
+template<typename GetSrc>
+static void copyWithSymmetry(GetSrc src, float* dst, int nSize, int hSize, int wSize, int cSize, bool useNHWC, int symmetry, bool reverse) {
   bool transpose = (symmetry & 0x4) != 0 && hSize == wSize;
   bool flipX = (symmetry & 0x2) != 0;
   bool flipY = (symmetry & 0x1) != 0;
@@ -302,7 +326,7 @@ static void copyWithSymmetry(const float* src, float* dst, int nSize, int hSize,
           int nhwOld = nhOld + w*wStride;
           int nhwNew = nhNew + wBaseNew + w*wStrideNew;
           for(int c = 0; c<cSize; c++) {
-            dst[nhwNew + c] = src[nhwOld + c];
+            dst[nhwNew + c] = src(nhwOld + c);
           }
         }
       }
@@ -329,7 +353,7 @@ static void copyWithSymmetry(const float* src, float* dst, int nSize, int hSize,
         for(int w = 0; w<wSize; w++) {
           int nchwOld = nchOld + w*wStride;
           int nchwNew = nchNew + wBaseNew + w*wStrideNew;
-          dst[nchwNew] = src[nchwOld];
+          dst[nchwNew] = src(nchwOld);
         }
       }
     }
@@ -338,11 +362,18 @@ static void copyWithSymmetry(const float* src, float* dst, int nSize, int hSize,
 
 
 void SymmetryHelpers::copyInputsWithSymmetry(const float* src, float* dst, int nSize, int hSize, int wSize, int cSize, bool useNHWC, int symmetry) {
-  copyWithSymmetry(src, dst, nSize, hSize, wSize, cSize, useNHWC, symmetry, false);
+  copyWithSymmetry([src](int i) { return src[i]; }, dst, nSize, hSize, wSize, cSize, useNHWC, symmetry, false);
 }
 
 void SymmetryHelpers::copyOutputsWithSymmetry(const float* src, float* dst, int nSize, int hSize, int wSize, int symmetry) {
-  copyWithSymmetry(src, dst, nSize, hSize, wSize, 1, false, symmetry, true);
+  copyWithSymmetry([src](int i) { return src[i]; }, dst, nSize, hSize, wSize, 1, false, symmetry, true);
+}
+
+void SymmetryHelpers::copyPackedInputsWithSymmetry(const uint8_t* src, float* dst, int nSize, int hSize, int wSize, int cSize, bool useNHWC, int symmetry) {
+  copyWithSymmetry(
+    [src](int i) { return (float)((src[i >> 3] >> (7 - (i & 7))) & 1); },
+    dst, nSize, hSize, wSize, cSize, useNHWC, symmetry, false
+  );
 }
 
 int SymmetryHelpers::invert(int symmetry) {
@@ -541,10 +572,135 @@ void SymmetryHelpers::getSymmetryDifferences(
 
 //-------------------------------------------------------------------------------------------------------------
 
+//Copy floats that are all 0-1 into bits, packing 8 to a byte, big-endian-style within each byte.
+void NNInputs::packBinaryRow(const float* binaryFloats, int len, uint8_t* bits) {
+  for(int i = 0; i < len; i += 8) {
+    if(i + 8 <= len) {
+      bits[i >> 3] =
+        ((uint8_t)binaryFloats[i + 0] << 7) |
+        ((uint8_t)binaryFloats[i + 1] << 6) |
+        ((uint8_t)binaryFloats[i + 2] << 5) |
+        ((uint8_t)binaryFloats[i + 3] << 4) |
+        ((uint8_t)binaryFloats[i + 4] << 3) |
+        ((uint8_t)binaryFloats[i + 5] << 2) |
+        ((uint8_t)binaryFloats[i + 6] << 1) |
+        ((uint8_t)binaryFloats[i + 7] << 0);
+    }
+    else {
+      bits[i >> 3] = 0;
+      for(int di = 0; i + di < len; di++) {
+        bits[i >> 3] |= ((uint8_t)binaryFloats[i + di] << (7-di));
+      }
+    }
+  }
+}
+
 static void setRowBin(float* rowBin, int pos, int feature, float value, int posStride, int featureStride) {
   rowBin[pos * posStride + feature * featureStride] = value;
 }
 
+//Renju forbidden points of the last position filled on this thread, indexed by loc.
+//Consecutive NN evaluations of a search thread are usually a few stones apart, typically a child after its parent,
+//so only the points whose lines see a changed stone, and the few whose result depended on more than that, are recomputed.
+namespace {
+  struct ForbiddenMapCache {
+    static const int MAX_CHANGED_STONES = 8; //Past this, recomputing everything is about as cheap
+    bool valid;
+    int xSize;
+    int ySize;
+    CForbiddenPointFinder fpf;
+    Color colors[Board::MAX_ARR_SIZE];
+    bool forbidden[Board::MAX_ARR_SIZE];
+    bool onlyDependsOnLines[Board::MAX_ARR_SIZE];
+    bool needsUpdate[Board::MAX_ARR_SIZE];
+
+    ForbiddenMapCache()
+      :valid(false),xSize(0),ySize(0),fpf()
+    {}
+
+    void update(int x, int y, Loc loc) {
+      bool onlyLines = true;
+      forbidden[loc] = fpf.isForbidden(x, y, onlyLines);
+      onlyDependsOnLines[loc] = onlyLines;
+    }
+
+    const bool* get(const Board& board) {
+      bool reuse = valid && xSize == board.x_size && ySize == board.y_size;
+      Loc changed[MAX_CHANGED_STONES];
+      int numChanged = 0;
+      if(reuse) {
+        for(int y = 0; y < ySize && reuse; y++) {
+          for(int x = 0; x < xSize; x++) {
+            Loc loc = Location::getLoc(x, y, xSize);
+            if(colors[loc] != board.colors[loc]) {
+              if(numChanged >= MAX_CHANGED_STONES) {
+                reuse = false;
+                break;
+              }
+              changed[numChanged++] = loc;
+            }
+          }
+        }
+      }
+
+      if(!reuse) {
+        xSize = board.x_size;
+        ySize = board.y_size;
+        fpf = CForbiddenPointFinder(xSize);
+        std::copy(board.colors, board.colors + Board::MAX_ARR_SIZE, colors);
+        for(int y = 0; y < ySize; y++)
+          for(int x = 0; x < xSize; x++)
+            fpf.SetStone(x, y, colors[Location::getLoc(x, y, xSize)]);
+        for(int y = 0; y < ySize; y++)
+          for(int x = 0; x < xSize; x++)
+            update(x, y, Location::getLoc(x, y, xSize));
+        valid = true;
+        return forbidden;
+      }
+
+      if(numChanged == 0)
+        return forbidden;
+
+      for(int y = 0; y < ySize; y++)
+        for(int x = 0; x < xSize; x++) {
+          Loc loc = Location::getLoc(x, y, xSize);
+          needsUpdate[loc] = !onlyDependsOnLines[loc];
+        }
+      static const int dx[4] = {1, 0, 1, 1};
+      static const int dy[4] = {0, 1, 1, -1};
+      for(int i = 0; i < numChanged; i++) {
+        Loc loc = changed[i];
+        int x = Location::getX(loc, xSize);
+        int y = Location::getY(loc, xSize);
+        colors[loc] = board.colors[loc];
+        fpf.SetStone(x, y, colors[loc]);
+        for(int d = 0; d < 4; d++) {
+          for(int k = -5; k <= 5; k++) {
+            int x2 = x + k * dx[d];
+            int y2 = y + k * dy[d];
+            if(x2 >= 0 && x2 < xSize && y2 >= 0 && y2 < ySize)
+              needsUpdate[Location::getLoc(x2, y2, xSize)] = true;
+          }
+        }
+      }
+      for(int y = 0; y < ySize; y++)
+        for(int x = 0; x < xSize; x++) {
+          Loc loc = Location::getLoc(x, y, xSize);
+          if(needsUpdate[loc])
+            update(x, y, loc);
+        }
+      return forbidden;
+    }
+  };
+}
+
+static const bool* getForbiddenMap(const Board& board) {
+  static thread_local ForbiddenMapCache cache;
+  return cache.get(board);
+}
+
+static Hash128 getHashFromSituationRulesHash(Hash128 hash, const BoardHistory& hist, const MiscNNInputParams& nnInputParams);
+
 //Currently does NOT depend on history (except for marking ko-illegal spots)
 Hash128 NNInputs::getHash(
   const Board& board, const BoardHistory& hist, Player nextPlayer,
@@ -554,7 +710,57 @@ Hash128 NNInputs::getHash(
   //  BoardHistory::getSituationRulesHash(board, hist, nextPlayer);
   Hash128 hash = BoardHistory::getSituationRulesHash(
     board, hist, nextPlayer /*, nnInputParams.noResultUtilityForWhite * 0.5 + 0.5*/);
+  return getHashFromSituationRulesHash(hash, hist, nnInputParams);
+}
+
+Hash128 NNInputs::getCanonicalHash(
+  const Board& board, const BoardHistory& hist, Player nextPlayer,
+  const MiscNNInputParams& nnInputParams, int& canonicalSymmetry
+) {
+  //Only the stones in the position hash depend on the orientation, so take them out and put them back transformed
+  int stoneXs[Board::MAX_PLAY_SIZE];
+  int stoneYs[Board::MAX_PLAY_SIZE];
+  Color stoneColors[Board::MAX_PLAY_SIZE];
+  int numStones = 0;
+  Hash128 posHashWithoutStones = board.pos_hash;
+  for(int y = 0; y<board.y_size; y++) {
+    for(int x = 0; x<board.x_size; x++) {
+      Loc loc = Location::getLoc(x,y,board.x_size);
+      Color color = board.colors[loc];
+      if(color != C_BLACK && color != C_WHITE)
+        continue;
+      stoneXs[numStones] = x;
+      stoneYs[numStones] = y;
+      stoneColors[numStones] = color;
+      numStones++;
+      posHashWithoutStones ^= Board::ZOBRIST_BOARD_HASH[loc][color];
+      posHashWithoutStones ^= Board::ZOBRIST_BOARD_HASH[loc][C_EMPTY];
+    }
+  }
 
+  int numSymmetries =
+    board.x_size == board.y_size ? SymmetryHelpers::NUM_SYMMETRIES : SymmetryHelpers::NUM_SYMMETRIES_WITHOUT_TRANSPOSE;
+  Hash128 canonicalHash;
+  canonicalSymmetry = 0;
+  for(int symmetry = 0; symmetry<numSymmetries; symmetry++) {
+    Hash128 posHash = posHashWithoutStones;
+    for(int i = 0; i<numStones; i++) {
+      Loc symLoc = SymmetryHelpers::getSymLoc(stoneXs[i],stoneYs[i],board,symmetry);
+      posHash ^= Board::ZOBRIST_BOARD_HASH[symLoc][stoneColors[i]];
+      posHash ^= Board::ZOBRIST_BOARD_HASH[symLoc][C_EMPTY];
+    }
+    Hash128 hash = getHashFromSituationRulesHash(
+      BoardHistory::getSituationRulesHash(posHash, hist, nextPlayer), hist, nnInputParams
+    );
+    if(symmetry == 0 || hash < canonicalHash) {
+      canonicalHash = hash;
+      canonicalSymmetry = symmetry;
+    }
+  }
+  return canonicalHash;
+}
+
+static Hash128 getHashFromSituationRulesHash(Hash128 hash, const BoardHistory& hist, const MiscNNInputParams& nnInputParams) {
 
   //Fold in whether the game is over or not, since this affects how we compute input features
   //but is not a function necessarily of previous hashed values.
@@ -748,14 +954,7 @@ void NNInputs::fillRowV7(
 
   bool hasForbiddenFeature = nnInputParams.useForbiddenInput && hist.rules.basicRule == Rules::BASICRULE_RENJU;
 
-  CForbiddenPointFinder fpf(board.x_size);
-  if (hasForbiddenFeature) {
-
-    for (int x = 0; x < board.x_size; x++)
-      for (int y = 0; y < board.y_size; y++) {
-        fpf.SetStone(x, y, board.colors[Location::getLoc(x, y, board.x_size)]);
-      }
-  }
+  const bool* forbiddenMap = hasForbiddenFeature ? getForbiddenMap(board) : NULL;
 
   for (int y = 0; y < ySize; y++) {
     for (int x = 0; x < xSize; x++) {
@@ -776,10 +975,10 @@ void NNInputs::fillRowV7(
       if (hasForbiddenFeature)
       {
         if (pla == C_BLACK) {
-          if (fpf.isForbidden(x, y)) setRowBin(rowBin, pos, 3, 1.0f, posStride, featureStride);
+          if (forbiddenMap[loc]) setRowBin(rowBin, pos, 3, 1.0f, posStride, featureStride);
         }
         else if (pla == C_WHITE) {
-          if (fpf.isForbidden(x, y)) setRowBin(rowBin, pos, 4, 1.0f, posStride, featureStride);
+          if (forbiddenMap[loc]) setRowBin(rowBin, pos, 4, 1.0f, posStride, featureStride);
         }
       }
     }
@@ -913,13 +1112,7 @@ void NNInputs::fillRowV10(
   bool hasForbiddenFeature = nnInputParams.useForbiddenInput && hist.rules.basicRule == Rules::BASICRULE_RENJU;
   rowGlobal[6] = hasForbiddenFeature;
 
-  CForbiddenPointFinder fpf(board.x_size);
-  if (hasForbiddenFeature) {
-    for (int x = 0; x < board.x_size; x++)
-      for (int y = 0; y < board.y_size; y++) {
-        fpf.SetStone(x, y, board.colors[Location::getLoc(x, y, board.x_size)]);
-      }
-  }
+  const bool* forbiddenMap = hasForbiddenFeature ? getForbiddenMap(board) : NULL;
 
   for (int y = 0; y < ySize; y++) {
     for (int x = 0; x < xSize; x++) {
@@ -939,11 +1132,11 @@ void NNInputs::fillRowV10(
 
       if (hasForbiddenFeature) {
         if (pla == C_BLACK) {
-          if (fpf.isForbidden(x, y))
+          if (forbiddenMap[loc])
             setRowBin(rowBin, pos, 3, 1.0f, posStride, featureStride);
         }
         else if (pla == C_WHITE) {
-          if (fpf.isForbidden(x, y))
+          if (forbiddenMap[loc])
             setRowBin(rowBin, pos, 4, 1.0f, posStride, featureStride);
         }
       }
@@ -1155,13 +1348,7 @@ void NNInputs::fillRowV101(
 
   bool hasForbiddenFeature = nnInputParams.useForbiddenInput && hist.rules.basicRule == Rules::BASICRULE_RENJU;
   
-  CForbiddenPointFinder fpf(board.x_size);
-  if (hasForbiddenFeature) {
-    for (int x = 0; x < board.x_size; x++)
-      for (int y = 0; y < board.y_size; y++)  {
-        fpf.SetStone(x, y, board.colors[Location::getLoc(x, y, board.x_size)]);
-      }
-  }
+  const bool* forbiddenMap = hasForbiddenFeature ? getForbiddenMap(board) : NULL;
 
   for (int y = 0; y < ySize; y++) {
     for (int x = 0; x < xSize; x++) {
@@ -1181,10 +1368,10 @@ void NNInputs::fillRowV101(
 
       if (hasForbiddenFeature)  {
         if (pla == C_BLACK) {
-          if (fpf.isForbidden(x, y)) setRowBin(rowBin, pos, 3, 1.0f, posStride, featureStride);
+          if (forbiddenMap[loc]) setRowBin(rowBin, pos, 3, 1.0f, posStride, featureStride);
         }
         else if (pla == C_WHITE) {
-          if (fpf.isForbidden(x, y)) setRowBin(rowBin, pos, 4, 1.0f, posStride, featureStride);
+          if (forbiddenMap[loc]) setRowBin(rowBin, pos, 4, 1.0f, posStride, featureStride);
         }
       }
     }
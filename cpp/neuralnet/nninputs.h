@@ -35,6 +35,17 @@ namespace NNInputs {
   constexpr int SYMMETRY_ALL = -2;
 }
 
+//Priority classes of neural net evaluations, for evaluators shared between workloads, see NNEvaluator::evaluate
+namespace NNPriority {
+  constexpr int HIGH = 0;
+  constexpr int NORMAL = 1;
+  constexpr int LOW = 2;
+  constexpr int NUM_PRIORITIES = 3;
+
+  int parse(const std::string& s);
+  std::string toString(int priority);
+}
+
 struct MiscNNInputParams {
   double noResultUtilityForWhite = 0.0;
   double fourAttackPolicyReduce = 0.0;
@@ -44,6 +55,8 @@ struct MiscNNInputParams {
   // If no symmetry is specified, it will use default or random based on config, unless node is already cached.
   int symmetry = NNInputs::SYMMETRY_NOTSPECIFIED;
   double policyOptimism = 0.0;
+  // Which lane of the evaluator's queue this eval goes in, does not affect the result.
+  int priority = NNPriority::NORMAL;
   //int maxHistory = 1000;
   // bool disableUnnecessaryPass = false;  // only allow passes when VCN or FPW or Renju black at the end of the game
   bool useForbiddenInput = true;
@@ -70,6 +83,13 @@ namespace NNInputs {
     const Board& board, const BoardHistory& boardHistory, Player nextPlayer,
     const MiscNNInputParams& nnInputParams
   );
+  //The smallest getHash over the orientations of the board, that is, the same for any two boards that are symmetries of
+  //each other. Sets canonicalSymmetry to a symmetry that takes the board to the orientation with that hash.
+  //Non-square boards are only reflected, not transposed.
+  Hash128 getCanonicalHash(
+    const Board& board, const BoardHistory& boardHistory, Player nextPlayer,
+    const MiscNNInputParams& nnInputParams, int& canonicalSymmetry
+  );
   /*
   void fillRowV97(
     const Board& board, const BoardHistory& boardHistory, Player nextPlayer,
@@ -91,7 +111,11 @@ namespace NNInputs {
     const Board& board, const BoardHistory& boardHistory, Player nextPlayer,
     const MiscNNInputParams& nnInputParams, int nnXLen, int nnYLen, bool useNHWC, float* rowBin, float* rowGlobal
   );
-  
+
+  //All spatial features are 0 or 1, so rows are passed from the search threads to the backends packed 8 to a byte,
+  //big-endian-style within each byte, in the same order as filled. See SymmetryHelpers::copyPackedInputsWithSymmetry.
+  void packBinaryRow(const float* binaryFloats, int len, uint8_t* bits);
+  inline int getPackedRowLen(int len) { return (len + 7) / 8; }
 
 }
 
@@ -225,6 +249,8 @@ namespace SymmetryHelpers {
   //copyOutputsWithSymmetry performs the inverse of symmetry.
   void copyInputsWithSymmetry(const float* src, float* dst, int nSize, int hSize, int wSize, int cSize, bool useNHWC, int symmetry);
   void copyOutputsWithSymmetry(const float* src, float* dst, int nSize, int hSize, int wSize, int symmetry);
+  //Same as copyInputsWithSymmetry, unpacking a row packed by NNInputs::packBinaryRow on the way
+  void copyPackedInputsWithSymmetry(const uint8_t* src, float* dst, int nSize, int hSize, int wSize, int cSize, bool useNHWC, int symmetry);
 
   //Applies a symmetry to a location
   Loc getSymLoc(int x, int y, const Board& board, int symmetry);
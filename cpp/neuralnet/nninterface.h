@@ -56,6 +56,8 @@ namespace NeuralNet {
     const std::string& openCLTunerFile,
     const std::string& homeDataDirOverride,
     bool openCLReTunePerBoardSize,
+    //Threads that each compute handle splits a single batch between, only used by the Eigen backend
+    int numEigenIntraOpThreads,
     enabled_t useFP16Mode,
     enabled_t useNHWCMode,
     const LoadedModel* loadedModel
@@ -101,7 +103,7 @@ namespace NeuralNet {
   //Perform Neural Net Evals ---------------------------------------------------------
 
   // Preconditions:
-  // buffers inputBufs[nIdx]->{rowSpatial,rowGlobal} have been filled with input data for all values of nIdx in [0,numBatchEltsFilled-1]
+  // buffers inputBufs[nIdx]->{rowSpatialPacked,rowGlobal} have been filled with input data for all values of nIdx in [0,numBatchEltsFilled-1]
   // outputs has length numBatchEltsFilled containing allocated but possibly-uninitialized NNOutput structs.
 
   // Result: mutably writes the results of the numBatchEltsFilled many parallel neural net evaluations
@@ -0,0 +1,297 @@
+#include "../neuralnet/nnpersistentcache.h"
+
+#include <cstring>
+#include "../core/makedir.h"
+#include "../core/os.h"
+
+#ifdef OS_IS_UNIX_OR_APPLE
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+  //Bump if the layout of the file or of CompactNNOutputCodec records changes
+  const uint32_t FILE_VERSION = 1;
+  const char FILE_MAGIC[8] = {'K','G','N','N','C','A','C','H'};
+  //Zobrist hashes and locations depend on the maximum board size the program was compiled for
+  const uint32_t FILE_MAX_BOARD_LEN = Board::MAX_LEN;
+  const int FILE_POLICY_BITS = 16;
+  const int64_t NUM_MISSES_PER_REFRESH = 1024;
+
+  struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t maxBoardLen;
+    uint32_t nnXLen;
+    uint32_t nnYLen;
+    uint32_t policyBits;
+    uint32_t recordBytes;
+    char modelSha256[64];
+  };
+  static_assert(sizeof(FileHeader) % 8 == 0, "");
+}
+
+PersistentNNCache::PersistentNNCache(
+  const string& dir,
+  const string& modelSha256,
+  int nnXLen,
+  int nnYLen,
+  bool rOnly,
+  int64_t maxFBytes,
+  Logger* lg
+)
+  :codec(FILE_POLICY_BITS,nnXLen,nnYLen),
+   diskRecordBytes(codec.recordBytes + sizeof(uint64_t)),
+   fileName(dir + "/" + modelSha256 + "-" + Global::intToString(nnXLen) + "x" + Global::intToString(nnYLen) + ".nncache"),
+   readOnly(rOnly),
+   maxFileBytes(maxFBytes),
+   logger(lg),
+   fd(-1),
+   mappingMutex(),
+   mapping(NULL),
+   mappedBytes(0),
+   indexedBytes(sizeof(FileHeader)),
+   offsetByHash0(),
+   numBadRecords(0),
+   writeMutex(),
+   isFull(false),
+   numMissesSinceRefresh(0)
+{
+  if(modelSha256.size() != sizeof(FileHeader::modelSha256))
+    throw StringError("PersistentNNCache: Unexpected model sha256: " + modelSha256);
+
+#ifdef OS_IS_UNIX_OR_APPLE
+  if(!readOnly)
+    MakeDir::make(dir);
+  fd = open(fileName.c_str(), readOnly ? O_RDONLY : (O_RDWR | O_CREAT), 0644);
+  if(fd < 0) {
+    if(readOnly && errno == ENOENT) {
+      if(logger != NULL)
+        logger->write("Persistent neural net cache " + fileName + " does not exist yet, read only so not creating it");
+      return;
+    }
+    throw StringError("PersistentNNCache: Could not open " + fileName + ": " + strerror(errno));
+  }
+
+  FileHeader expected;
+  std::memset(&expected, 0, sizeof(expected));
+  std::memcpy(expected.magic, FILE_MAGIC, sizeof(expected.magic));
+  expected.version = FILE_VERSION;
+  expected.maxBoardLen = FILE_MAX_BOARD_LEN;
+  expected.nnXLen = (uint32_t)nnXLen;
+  expected.nnYLen = (uint32_t)nnYLen;
+  expected.policyBits = FILE_POLICY_BITS;
+  expected.recordBytes = (uint32_t)diskRecordBytes;
+  std::memcpy(expected.modelSha256, modelSha256.data(), sizeof(expected.modelSha256));
+
+  //Whoever creates the file writes the header, under the lock so that nobody reads it half written
+  flock(fd, readOnly ? LOCK_SH : LOCK_EX);
+  struct stat st;
+  fstat(fd, &st);
+  bool headerOk;
+  if(st.st_size == 0 && !readOnly)
+    headerOk = pwrite(fd, &expected, sizeof(expected), 0) == (ssize_t)sizeof(expected);
+  else {
+    FileHeader header;
+    headerOk =
+      pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+      std::memcmp(&header, &expected, sizeof(header)) == 0;
+  }
+  flock(fd, LOCK_UN);
+  if(!headerOk) {
+    close(fd);
+    fd = -1;
+    throw StringError(
+      "PersistentNNCache: " + fileName + " was written by an incompatible version or build of this program, "
+      "or is corrupt, delete it or use a different directory"
+    );
+  }
+
+  refresh();
+  if(logger != NULL) {
+    logger->write(
+      "Persistent neural net cache " + fileName + ": " + Global::uint64ToString(getNumEntries()) + " entries" +
+      (numBadRecords > 0 ? ", skipped " + Global::int64ToString(numBadRecords) + " corrupt ones" : "") +
+      (readOnly ? " (read only)" : "")
+    );
+  }
+#else
+  (void)nnXLen;
+  (void)nnYLen;
+  throw StringError("PersistentNNCache: Persistent neural net caches are not supported on this OS");
+#endif
+}
+
+PersistentNNCache::~PersistentNNCache() {
+#ifdef OS_IS_UNIX_OR_APPLE
+  if(mapping != NULL)
+    munmap(const_cast<uint8_t*>(mapping), mappedBytes);
+  if(fd >= 0)
+    close(fd);
+#endif
+}
+
+const string& PersistentNNCache::getFileName() const {
+  return fileName;
+}
+
+size_t PersistentNNCache::getNumEntries() {
+  std::shared_lock<std::shared_mutex> lock(mappingMutex);
+  return offsetByHash0.size();
+}
+
+uint64_t PersistentNNCache::computeChecksum(const uint8_t* record) const {
+  uint64_t h = 0x2bd1a1c4c4a8c0b5ULL;
+  for(size_t i = 0; i<codec.recordBytes; i += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, record + i, sizeof(word));
+    h = Hash::splitMix64(h ^ word);
+  }
+  return h;
+}
+
+void PersistentNNCache::refresh() {
+#ifdef OS_IS_UNIX_OR_APPLE
+  if(fd < 0)
+    return;
+  size_t alreadyIndexedBytes;
+  {
+    std::shared_lock<std::shared_mutex> lock(mappingMutex);
+    alreadyIndexedBytes = indexedBytes;
+  }
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (size_t)st.st_size < alreadyIndexedBytes + diskRecordBytes)
+    return;
+
+  //flock locks belong to the open file, not the thread, so taking and dropping a shared lock here while add holds the
+  //exclusive one would release it in the middle of the append. Lock order is writeMutex, then mappingMutex.
+  std::lock_guard<std::mutex> writeLock(writeMutex);
+  std::unique_lock<std::shared_mutex> lock(mappingMutex);
+  //Shared with other readers, but keeps out appenders from other processes, so that no record is seen half written
+  flock(fd, LOCK_SH);
+  fstat(fd, &st);
+  size_t fileBytes = (size_t)st.st_size;
+  if(fileBytes > mappedBytes) {
+    if(mapping != NULL)
+      munmap(const_cast<uint8_t*>(mapping), mappedBytes);
+    void* newMapping = mmap(NULL, fileBytes, PROT_READ, MAP_SHARED, fd, 0);
+    if(newMapping == MAP_FAILED) {
+      mapping = NULL;
+      mappedBytes = 0;
+      indexedBytes = sizeof(FileHeader);
+      offsetByHash0.clear();
+      flock(fd, LOCK_UN);
+      if(logger != NULL)
+        logger->write("WARNING: Could not map persistent neural net cache " + fileName + ": " + strerror(errno));
+      return;
+    }
+    mapping = (const uint8_t*)newMapping;
+    mappedBytes = fileBytes;
+  }
+  while(indexedBytes + diskRecordBytes <= mappedBytes) {
+    const uint8_t* record = mapping + indexedBytes;
+    uint64_t checksum;
+    std::memcpy(&checksum, record + codec.recordBytes, sizeof(checksum));
+    if(checksum == computeChecksum(record)) {
+      const CompactNNOutputCodec::Header* header = (const CompactNNOutputCodec::Header*)record;
+      offsetByHash0[header->hash0] = indexedBytes;
+    }
+    else
+      numBadRecords += 1;
+    indexedBytes += diskRecordBytes;
+  }
+  flock(fd, LOCK_UN);
+#endif
+}
+
+bool PersistentNNCache::get(Hash128 nnHash, shared_ptr<NNOutput>& ret) {
+  if(ret != nullptr)
+    ret.reset();
+
+  static thread_local std::vector<uint8_t> recordBuf;
+  if(recordBuf.size() < codec.recordBytes)
+    recordBuf.resize(codec.recordBytes);
+
+  bool found = false;
+  {
+    std::shared_lock<std::shared_mutex> lock(mappingMutex);
+    auto iter = offsetByHash0.find(nnHash.hash0);
+    if(iter != offsetByHash0.end() && iter->second + diskRecordBytes <= mappedBytes) {
+      const uint8_t* record = mapping + iter->second;
+      if(CompactNNOutputCodec::matches(record,nnHash)) {
+        std::memcpy(recordBuf.data(), record, codec.recordBytes);
+        found = true;
+      }
+    }
+  }
+
+  if(!found) {
+    if(numMissesSinceRefresh.fetch_add(1,std::memory_order_relaxed) + 1 >= NUM_MISSES_PER_REFRESH) {
+      numMissesSinceRefresh.store(0,std::memory_order_relaxed);
+      refresh();
+    }
+    return false;
+  }
+  ret = std::make_shared<NNOutput>();
+  codec.decode(recordBuf.data(), *ret);
+  return true;
+}
+
+void PersistentNNCache::add(const NNOutput& output) {
+#ifdef OS_IS_UNIX_OR_APPLE
+  if(readOnly || fd < 0 || isFull.load(std::memory_order_relaxed))
+    return;
+  {
+    std::shared_lock<std::shared_mutex> lock(mappingMutex);
+    if(offsetByHash0.find(output.nnHash.hash0) != offsetByHash0.end())
+      return;
+  }
+
+  static thread_local std::vector<uint8_t> recordBuf;
+  if(recordBuf.size() < diskRecordBytes)
+    recordBuf.resize(diskRecordBytes);
+  codec.encode(output, recordBuf.data());
+  uint64_t checksum = computeChecksum(recordBuf.data());
+  std::memcpy(recordBuf.data() + codec.recordBytes, &checksum, sizeof(checksum));
+
+  std::lock_guard<std::mutex> writeLock(writeMutex);
+  flock(fd, LOCK_EX);
+  struct stat st;
+  fstat(fd, &st);
+  size_t fileBytes = (size_t)st.st_size;
+  //Cut off a partial record left by a writer that died in the middle
+  size_t offset = sizeof(FileHeader) + (fileBytes - sizeof(FileHeader)) / diskRecordBytes * diskRecordBytes;
+  if(offset != fileBytes && ftruncate(fd, (off_t)offset) != 0) {
+    flock(fd, LOCK_UN);
+    return;
+  }
+  if((int64_t)(offset + diskRecordBytes) > maxFileBytes) {
+    flock(fd, LOCK_UN);
+    isFull.store(true,std::memory_order_relaxed);
+    if(logger != NULL)
+      logger->write("Persistent neural net cache " + fileName + " is full, no longer adding to it");
+    return;
+  }
+  size_t numWritten = 0;
+  while(numWritten < diskRecordBytes) {
+    ssize_t n = pwrite(fd, recordBuf.data() + numWritten, diskRecordBytes - numWritten, (off_t)(offset + numWritten));
+    if(n <= 0)
+      break;
+    numWritten += (size_t)n;
+  }
+  flock(fd, LOCK_UN);
+
+  if(numWritten == diskRecordBytes) {
+    std::unique_lock<std::shared_mutex> lock(mappingMutex);
+    offsetByHash0[output.nnHash.hash0] = offset;
+  }
+#else
+  (void)output;
+#endif
+}
@@ -0,0 +1,75 @@
+#ifndef NEURALNET_NNPERSISTENTCACHE_H_
+#define NEURALNET_NNPERSISTENTCACHE_H_
+
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "../core/global.h"
+#include "../core/hash.h"
+#include "../core/logger.h"
+#include "../neuralnet/nneval.h"
+
+//Cache of neural net evaluations kept in a file, so that jobs that keep evaluating the same positions with the same model,
+//such as the openings of matches or book generation, can reuse them across runs. There is one file per model sha256 and
+//nn size, of CompactNNOutputCodec records with 16 bit policies, which is only ever appended to.
+//The file is memory-mapped and indexed when opened, and again every so often on misses to pick up what other processes
+//appended in the meantime. Any number of processes can read and append to the same file at once, appends are serialized
+//by an exclusive flock on it. A process that crashed mid-append leaves a partial record, cut off by the next append.
+//Only supported on unix-like systems.
+class PersistentNNCache {
+ public:
+  //Opens or creates the file for this model and size in dir. If readOnly, never writes, and a missing file is just empty.
+  //Stops appending once the file would exceed maxFileBytes.
+  PersistentNNCache(
+    const std::string& dir,
+    const std::string& modelSha256,
+    int nnXLen,
+    int nnYLen,
+    bool readOnly,
+    int64_t maxFileBytes,
+    Logger* logger
+  );
+  ~PersistentNNCache();
+
+  PersistentNNCache(const PersistentNNCache& other) = delete;
+  PersistentNNCache& operator=(const PersistentNNCache& other) = delete;
+
+  //These are thread-safe. For get, ret will be set to nullptr upon a failure to find.
+  bool get(Hash128 nnHash, std::shared_ptr<NNOutput>& ret);
+  //Appends output to the file, unless it's already there, the file is full, or this cache is read only.
+  void add(const NNOutput& output);
+
+  const std::string& getFileName() const;
+  size_t getNumEntries();
+
+ private:
+  const CompactNNOutputCodec codec;
+  const size_t diskRecordBytes; //A codec record followed by a checksum
+  const std::string fileName;
+  const bool readOnly;
+  const int64_t maxFileBytes;
+  Logger* logger;
+  int fd;
+
+  //Guards the mapping and the index, held shared for lookups and exclusively to change them
+  std::shared_mutex mappingMutex;
+  const uint8_t* mapping;
+  size_t mappedBytes;
+  size_t indexedBytes;
+  //Records appended by this process can be past the end of the mapping until the next refresh
+  std::unordered_map<uint64_t,size_t> offsetByHash0;
+  int64_t numBadRecords;
+
+  //Serializes this process's use of the flock on fd, held by add and refresh
+  std::mutex writeMutex;
+  std::atomic<bool> isFull;
+  std::atomic<int64_t> numMissesSinceRefresh;
+
+  uint64_t computeChecksum(const uint8_t* record) const;
+  //Maps any part of the file that appeared since the last call and indexes the records in it
+  void refresh();
+};
+
+#endif  // NEURALNET_NNPERSISTENTCACHE_H_
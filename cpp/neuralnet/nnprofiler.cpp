@@ -0,0 +1,189 @@
+#include "../neuralnet/nnprofiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "../core/fileutils.h"
+#include "../external/nlohmann_json/json.hpp"
+
+using namespace std;
+using nlohmann::json;
+
+namespace {
+  struct Totals {
+    double totalSeconds = 0.0;
+    int64_t numCalls = 0;
+  };
+  struct Event {
+    int keyIdx;
+    int threadIdx;
+    int64_t startMicros;
+    int64_t durationMicros;
+  };
+
+  //Bounds the memory used by a trace, events past this are only counted
+  const size_t MAX_TRACE_EVENTS = 1 << 21;
+
+  std::atomic<bool> profilerEnabled(false);
+  std::mutex profilerMutex;
+  bool recordingTrace = false;
+  NNProfiler::TimePoint traceOrigin;
+  //Names are copied on first use, so that events stay valid after the layers that recorded them are freed
+  map<pair<string,string>,int> keyIdxs;
+  vector<pair<string,string>> keys;
+  vector<Totals> totalsByKey;
+  vector<Event> traceEvents;
+  int64_t numDroppedEvents = 0;
+  map<std::thread::id,int> threadIdxs;
+}
+
+void NNProfiler::setEnabled(bool enabled, bool recordTrace) {
+  std::lock_guard<std::mutex> lock(profilerMutex);
+  recordingTrace = enabled && recordTrace;
+  if(recordingTrace && traceEvents.size() <= 0)
+    traceOrigin = std::chrono::steady_clock::now();
+  profilerEnabled.store(enabled,std::memory_order_release);
+}
+
+bool NNProfiler::isEnabled() {
+  return profilerEnabled.load(std::memory_order_relaxed);
+}
+
+void NNProfiler::clear() {
+  std::lock_guard<std::mutex> lock(profilerMutex);
+  keyIdxs.clear();
+  keys.clear();
+  totalsByKey.clear();
+  traceEvents.clear();
+  numDroppedEvents = 0;
+  threadIdxs.clear();
+  traceOrigin = std::chrono::steady_clock::now();
+}
+
+void NNProfiler::record(const char* category, const char* name, TimePoint start, TimePoint end) {
+  double seconds = std::chrono::duration<double>(end - start).count();
+  std::lock_guard<std::mutex> lock(profilerMutex);
+  pair<string,string> key(category,name);
+  auto keyIter = keyIdxs.find(key);
+  int keyIdx;
+  if(keyIter == keyIdxs.end()) {
+    keyIdx = (int)keys.size();
+    keyIdxs[key] = keyIdx;
+    keys.push_back(key);
+    totalsByKey.push_back(Totals());
+  }
+  else
+    keyIdx = keyIter->second;
+  Totals& totals = totalsByKey[keyIdx];
+  totals.totalSeconds += seconds;
+  totals.numCalls += 1;
+
+  if(!recordingTrace)
+    return;
+  if(traceEvents.size() >= MAX_TRACE_EVENTS) {
+    numDroppedEvents += 1;
+    return;
+  }
+  std::thread::id id = std::this_thread::get_id();
+  auto iter = threadIdxs.find(id);
+  int threadIdx;
+  if(iter == threadIdxs.end()) {
+    threadIdx = (int)threadIdxs.size();
+    threadIdxs[id] = threadIdx;
+  }
+  else
+    threadIdx = iter->second;
+
+  Event event;
+  event.keyIdx = keyIdx;
+  event.threadIdx = threadIdx;
+  event.startMicros = std::chrono::duration_cast<std::chrono::microseconds>(start - traceOrigin).count();
+  event.durationMicros = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+  traceEvents.push_back(event);
+}
+
+//Sorted by category, then by decreasing total time
+static vector<pair<pair<string,string>,Totals>> getSortedTotals() {
+  std::lock_guard<std::mutex> lock(profilerMutex);
+  vector<pair<pair<string,string>,Totals>> sorted;
+  for(size_t i = 0; i<keys.size(); i++)
+    sorted.push_back(make_pair(keys[i],totalsByKey[i]));
+  std::sort(
+    sorted.begin(),sorted.end(),
+    [](const pair<pair<string,string>,Totals>& a, const pair<pair<string,string>,Totals>& b) {
+      if(a.first.first != b.first.first)
+        return a.first.first < b.first.first;
+      return a.second.totalSeconds > b.second.totalSeconds;
+    }
+  );
+  return sorted;
+}
+
+string NNProfiler::getTableString() {
+  vector<pair<pair<string,string>,Totals>> sorted = getSortedTotals();
+  map<string,double> categoryTotals;
+  for(const auto& elt: sorted)
+    categoryTotals[elt.first.first] += elt.second.totalSeconds;
+
+  ostringstream out;
+  out << Global::strprintf("%-16s %-32s %12s %12s %12s %7s", "category", "name", "total(s)", "calls", "avg(us)", "%cat") << "\n";
+  string prevCategory;
+  for(const auto& elt: sorted) {
+    const string& category = elt.first.first;
+    if(category != prevCategory && prevCategory.size() > 0)
+      out << "\n";
+    prevCategory = category;
+    const Totals& totals = elt.second;
+    double catTotal = categoryTotals[category];
+    out << Global::strprintf(
+      "%-16s %-32s %12.4f %12lld %12.2f %6.1f%%",
+      category.c_str(), elt.first.second.c_str(),
+      totals.totalSeconds, (long long)totals.numCalls,
+      totals.numCalls > 0 ? totals.totalSeconds * 1e6 / totals.numCalls : 0.0,
+      catTotal > 0 ? 100.0 * totals.totalSeconds / catTotal : 0.0
+    ) << "\n";
+  }
+  return out.str();
+}
+
+void NNProfiler::writeJson(const string& file) {
+  vector<pair<pair<string,string>,Totals>> sorted = getSortedTotals();
+  json entries = json::array();
+  for(const auto& elt: sorted) {
+    json entry;
+    entry["category"] = elt.first.first;
+    entry["name"] = elt.first.second;
+    entry["totalSeconds"] = elt.second.totalSeconds;
+    entry["calls"] = elt.second.numCalls;
+    entries.push_back(entry);
+  }
+  json ret;
+  ret["entries"] = entries;
+  ofstream out;
+  FileUtils::open(out,file);
+  out << ret.dump(1) << endl;
+  out.close();
+}
+
+void NNProfiler::writeChromeTrace(const string& file) {
+  std::lock_guard<std::mutex> lock(profilerMutex);
+  ofstream out;
+  FileUtils::open(out,file);
+  //Written by hand rather than through a json object, traces can have millions of events
+  out << "{\"traceEvents\":[\n";
+  for(size_t i = 0; i<traceEvents.size(); i++) {
+    const Event& event = traceEvents[i];
+    json name = keys[event.keyIdx].second;
+    json category = keys[event.keyIdx].first;
+    out << "{\"name\":" << name.dump() << ",\"cat\":" << category.dump()
+        << ",\"ph\":\"X\",\"ts\":" << event.startMicros << ",\"dur\":" << event.durationMicros
+        << ",\"pid\":0,\"tid\":" << event.threadIdx << "}";
+    out << (i+1 < traceEvents.size() ? ",\n" : "\n");
+  }
+  out << "],\"otherData\":{\"droppedEvents\":" << numDroppedEvents << "}}" << endl;
+  out.close();
+}
@@ -0,0 +1,56 @@
+#ifndef NEURALNET_NNPROFILER_H_
+#define NEURALNET_NNPROFILER_H_
+
+#include <chrono>
+
+#include "../core/global.h"
+
+//Optional timing of the phases of neural net evaluation - client side input filling and postprocessing,
+//server side queue waits and backend calls, and for backends that support it, individual layers.
+//Disabled by default, in which case a Section costs a single relaxed atomic load.
+//Times are summed per (category, name), and optionally also kept as individual events for a chrome trace.
+namespace NNProfiler {
+  typedef std::chrono::steady_clock::time_point TimePoint;
+
+  void setEnabled(bool enabled, bool recordTrace);
+  bool isEnabled();
+  //Drops all the times and events recorded so far
+  void clear();
+
+  //Thread-safe, serialized by a single mutex, so per-layer sections are only meant for benchmarking
+  void record(const char* category, const char* name, TimePoint start, TimePoint end);
+
+  //Per (category, name) total time, number of calls and average, grouped by category and sorted by total time
+  std::string getTableString();
+  void writeJson(const std::string& file);
+  //Format understood by chrome://tracing and https://ui.perfetto.dev
+  void writeChromeTrace(const std::string& file);
+
+  struct Section {
+    const char* category;
+    const char* name;
+    bool active;
+    TimePoint start;
+
+    inline Section(const char* c, const char* n)
+      :category(c),name(n),active(isEnabled())
+    {
+      if(active)
+        start = std::chrono::steady_clock::now();
+    }
+    inline ~Section() {
+      stop();
+    }
+    //Ends the section before the end of its scope
+    inline void stop() {
+      if(active)
+        record(category,name,start,std::chrono::steady_clock::now());
+      active = false;
+    }
+
+    Section(const Section& other) = delete;
+    Section& operator=(const Section& other) = delete;
+  };
+}
+
+#endif  // NEURALNET_NNPROFILER_H_
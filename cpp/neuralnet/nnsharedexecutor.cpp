@@ -0,0 +1,135 @@
+#include "../neuralnet/nnsharedexecutor.h"
+
+#include <sstream>
+
+using namespace std;
+
+NNSharedExecutor::NNSharedExecutor(int nSlots)
+  :numSlots(nSlots),
+   mutex(),
+   slotFreed(),
+   numFreeSlots(nSlots),
+   clients()
+{
+  if(numSlots <= 0)
+    throw StringError("NNSharedExecutor: numSlots must be positive");
+}
+
+NNSharedExecutor::~NNSharedExecutor()
+{}
+
+int NNSharedExecutor::getNumSlots() const {
+  return numSlots;
+}
+
+int NNSharedExecutor::addClient(const string& name, double weight) {
+  if(!(weight > 0.0))
+    throw StringError("NNSharedExecutor: weight must be positive");
+  lock_guard<std::mutex> lock(mutex);
+  Client client;
+  client.name = name;
+  client.weight = weight;
+  client.removed = false;
+  client.virtualTime = 0.0;
+  client.numWaiting = 0;
+  client.numRunning = 0;
+  client.numBatches = 0;
+  client.totalSeconds = 0.0;
+  client.totalWaitSeconds = 0.0;
+  //Reuse the entry of a removed client, so that evaluators coming and going over a long run don't grow the list
+  for(int i = 0; i<(int)clients.size(); i++) {
+    if(clients[i].removed) {
+      clients[i] = client;
+      return i;
+    }
+  }
+  clients.push_back(client);
+  return (int)clients.size()-1;
+}
+
+void NNSharedExecutor::removeClient(int clientId) {
+  lock_guard<std::mutex> lock(mutex);
+  assert(clientId >= 0 && clientId < (int)clients.size());
+  assert(clients[clientId].numWaiting == 0 && clients[clientId].numRunning == 0);
+  clients[clientId].removed = true;
+}
+
+int NNSharedExecutor::getNextClientUnsynchronized() const {
+  int best = -1;
+  for(int i = 0; i<(int)clients.size(); i++) {
+    if(clients[i].numWaiting > 0 && (best < 0 || clients[i].virtualTime < clients[best].virtualTime))
+      best = i;
+  }
+  return best;
+}
+
+void NNSharedExecutor::acquire(int clientId) {
+  std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+  unique_lock<std::mutex> lock(mutex);
+  assert(clientId >= 0 && clientId < (int)clients.size());
+  {
+    Client& client = clients[clientId];
+    if(client.numWaiting <= 0 && client.numRunning <= 0) {
+      double minActiveVirtualTime = -1.0;
+      for(const Client& other: clients) {
+        if((other.numWaiting > 0 || other.numRunning > 0) && (minActiveVirtualTime < 0.0 || other.virtualTime < minActiveVirtualTime))
+          minActiveVirtualTime = other.virtualTime;
+      }
+      client.virtualTime = std::max(client.virtualTime, minActiveVirtualTime);
+    }
+    client.numWaiting++;
+  }
+  while(numFreeSlots <= 0 || getNextClientUnsynchronized() != clientId)
+    slotFreed.wait(lock);
+  //Looked up again, addClient while waiting can reallocate clients
+  Client& client = clients[clientId];
+  client.numWaiting--;
+  client.numRunning++;
+  numFreeSlots--;
+  client.totalWaitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+  //Another slot might still be free for a different client
+  if(numFreeSlots > 0)
+    slotFreed.notify_all();
+}
+
+void NNSharedExecutor::release(int clientId, double secondsUsed) {
+  lock_guard<std::mutex> lock(mutex);
+  assert(clientId >= 0 && clientId < (int)clients.size());
+  Client& client = clients[clientId];
+  assert(client.numRunning > 0);
+  client.numRunning--;
+  client.virtualTime += secondsUsed / client.weight;
+  client.numBatches += 1;
+  client.totalSeconds += secondsUsed;
+  numFreeSlots++;
+  slotFreed.notify_all();
+}
+
+string NNSharedExecutor::getStatsString() {
+  lock_guard<std::mutex> lock(mutex);
+  ostringstream out;
+  out << "Shared neural net executor with " << numSlots << " slots:";
+  for(const Client& client: clients) {
+    if(client.removed)
+      continue;
+    out << "\n" << Global::strprintf(
+      "  %s weight %.2f: %lld batches, %.3fs running, %.3fs waiting for slots",
+      client.name.c_str(), client.weight, (long long)client.numBatches, client.totalSeconds, client.totalWaitSeconds
+    );
+  }
+  return out.str();
+}
+
+NNSharedExecutor::Slot::Slot(NNSharedExecutor* e, int id)
+  :executor(e),clientId(id)
+{
+  if(executor != NULL) {
+    executor->acquire(clientId);
+    start = std::chrono::steady_clock::now();
+  }
+}
+
+NNSharedExecutor::Slot::~Slot() {
+  if(executor != NULL)
+    executor->release(clientId, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
@@ -0,0 +1,77 @@
+#ifndef NEURALNET_NNSHAREDEXECUTOR_H_
+#define NEURALNET_NNSHAREDEXECUTOR_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "../core/global.h"
+
+//Lets several NNEvaluators, such as for the different models live during a model transition in selfplay or the two
+//sides of a gating match, share a fixed number of concurrent backend calls, so that on a CPU their server threads
+//together don't run more batches at once than there are cores for.
+//Each evaluator keeps its own queue, server threads, and backend handles, but a server thread must hold one of the
+//slots of the executor while the backend runs a batch. Free slots go to the evaluators waiting for one in weighted
+//fair order: each evaluator accumulates backend time divided by its weight, and the waiting one with the least goes
+//first. An evaluator that was idle starts again from the least of the active ones, rather than from what it had,
+//so that idling doesn't build up credit.
+class NNSharedExecutor {
+ public:
+  NNSharedExecutor(int numSlots);
+  ~NNSharedExecutor();
+
+  NNSharedExecutor(const NNSharedExecutor& other) = delete;
+  NNSharedExecutor& operator=(const NNSharedExecutor& other) = delete;
+
+  int getNumSlots() const;
+
+  //All of these are thread-safe.
+  //Returns the id for the new client to use below. Clients are served in proportion to weight when competing.
+  //The ids of removed clients are given out again.
+  int addClient(const std::string& name, double weight);
+  void removeClient(int clientId);
+  //Wait for a slot and take it
+  void acquire(int clientId);
+  //Give back a slot, which was used for this many seconds
+  void release(int clientId, double secondsUsed);
+
+  //For logging, per client the number of batches, backend time, and time waited for slots
+  std::string getStatsString();
+
+  //RAII holder of a slot, does nothing if executor is NULL
+  struct Slot {
+    NNSharedExecutor* executor;
+    int clientId;
+    std::chrono::steady_clock::time_point start;
+
+    Slot(NNSharedExecutor* executor, int clientId);
+    ~Slot();
+    Slot(const Slot& other) = delete;
+    Slot& operator=(const Slot& other) = delete;
+  };
+
+ private:
+  struct Client {
+    std::string name;
+    double weight;
+    bool removed;
+    double virtualTime;
+    int numWaiting;
+    int numRunning;
+    int64_t numBatches;
+    double totalSeconds;
+    double totalWaitSeconds;
+  };
+
+  const int numSlots;
+  std::mutex mutex;
+  std::condition_variable slotFreed;
+  int numFreeSlots;
+  //Indexed by client id. Only hold references into it while the mutex is held and not waited on.
+  std::vector<Client> clients;
+
+  //The waiting client with the least virtual time, or -1 if none. Call with the mutex held.
+  int getNextClientUnsynchronized() const;
+};
+
+#endif  // NEURALNET_NNSHAREDEXECUTOR_H_
@@ -53,6 +53,7 @@ ComputeContext* NeuralNet::createComputeContext(
   const string& openCLTunerFile,
   const string& homeDataDirOverride,
   bool openCLReTunePerBoardSize,
+  int numEigenIntraOpThreads,
   enabled_t useFP16Mode,
   enabled_t useNHWCMode,
   const LoadedModel* loadedModel) {
@@ -60,6 +61,7 @@ ComputeContext* NeuralNet::createComputeContext(
   (void)logger;
   (void)openCLTunerFile;
   (void)openCLReTunePerBoardSize;
+  (void)numEigenIntraOpThreads;
   (void)loadedModel;
 
   if(useNHWCMode == enabled_t::True) {
@@ -1658,7 +1660,7 @@ void NeuralNet::getOutput(
     float* rowMetaInput = &inputBuffers->metaInputs[inputBuffers->singleInputMetaElts * nIdx];
 
     const float* rowGlobal = inputBufs[nIdx]->rowGlobalBuf.data();
-    const float* rowSpatial = inputBufs[nIdx]->rowSpatialBuf.data();
+    const uint8_t* rowSpatial = inputBufs[nIdx]->rowSpatialPackedBuf.data();
     const float* rowMeta = inputBufs[nIdx]->rowMetaBuf.data();
     const bool hasRowMeta = inputBufs[nIdx]->hasRowMeta;
     //copy(rowGlobal, rowGlobal + numGlobalFeatures, rowGlobalInput);
@@ -1671,7 +1673,7 @@ void NeuralNet::getOutput(
     else {
       testAssert(!hasRowMeta);
     }
-    SymmetryHelpers::copyInputsWithSymmetry(
+    SymmetryHelpers::copyPackedInputsWithSymmetry(
       rowSpatial, rowSpatialInput, 1, nnYLen, nnXLen, numSpatialFeatures, false, inputBufs[nIdx]->symmetry);
     std::copy(rowSpatialInput, rowSpatialInput + inputBuffers->singleMaskElts, rowMaskInput);
   }
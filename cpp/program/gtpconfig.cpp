@@ -176,6 +176,10 @@ $$MAX_TIME
 
 # Ponder on the opponent's turn?
 $$PONDERING
+# When pondering for a long time, keep the search tree within this many
+# nodes or roughly this many bytes by pruning its least visited parts.
+# maxTreeNodesPondering = 20000000
+# maxTreeBytesPondering = 8e9
 
 # ------------------------------
 # Other search limits and behavior
@@ -185,6 +189,29 @@ $$PONDERING
 # move a bit faster assuming there is this much lag per move.
 lagBuffer = 1.0
 
+# Under time controls, move as fast as allowed when the move is already
+# decided before searching (a five, the only defence against a four, or a
+# winning four/VCF). In byo-yomi overtime with one move per period, spend this
+# proportion of the saved time on later moves. With main time left the saved
+# time simply stays on the clock, and with a fixed time per move it is lost.
+# Costs an extra VCF solve at the root of every search under time controls.
+# useTacticalTimeManagement = false
+# tacticalTimeBankFactor = 0.5
+
+# Before each search, search the root for a VCF with this many threads and a
+# much larger node limit than the one used for every node during search.
+# A win found this way becomes the only root move. Under time controls the
+# time limit is also capped to a quarter of the recommended time for the move.
+# rootVCFNumThreads = 4
+# rootVCFMaxNodes = 2000000
+# rootVCFMaxTime = 1.0
+
+# VCF is solved for both sides at every position evaluated by the neural net.
+# If the proportion of those solves finding a VCF, for positions with about as
+# many stones on the board, is below this, skip most of them and report the
+# VCF as unknown. Positions where no VCF is possible at all are always skipped.
+# vcfMinHitRate = 0.0
+
 # Number of threads to use in search
 numSearchThreads = $$NUM_SEARCH_THREADS
 
@@ -322,6 +349,13 @@ $$MULTIPLE_GPUS
 # Improve the quality of evals under heavy multithreading
 # useNoisePruning = true
 
+# Back up playouts into nodes by the delta of the one child that changed
+# rather than re-summing all children. Only takes effect when
+# valueWeightExponent = 0, useNoisePruning = false and
+# subtreeValueBiasFactor = 0.
+# useIncrementalBackup = false
+# incrementalBackupFullRecomputeInterval = 64
+
 )%%";
 
 
@@ -1164,6 +1164,7 @@ bool MatchPairer::getMatchup(BotSpec& botSpecB, BotSpec& botSpecW, Logger& logge
         logger.write("NN rows: " + Global::int64ToString(nnEvals[i]->numRowsProcessed()));
         logger.write("NN batches: " + Global::int64ToString(nnEvals[i]->numBatchesProcessed()));
         logger.write("NN avg batch size: " + Global::doubleToString(nnEvals[i]->averageProcessedBatchSize()));
+        logger.write("NN latency: " + nnEvals[i]->getPriorityStatsString());
       }
     }
   }
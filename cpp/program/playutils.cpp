@@ -456,6 +456,7 @@ void PlayUtils::printGenmoveLog(
   out << "NN rows: " << nnEval->numRowsProcessed() << endl;
   out << "NN batches: " << nnEval->numBatchesProcessed() << endl;
   out << "NN avg batch size: " << nnEval->averageProcessedBatchSize() << endl;
+  out << "NN latency: " << nnEval->getPriorityStatsString() << endl;
   if(search->searchParams.playoutDoublingAdvantage != 0)
     out << "PlayoutDoublingAdvantage: " << (
       search->getRootPla() == getOpp(search->getPlayoutDoublingAdvantagePla()) ?
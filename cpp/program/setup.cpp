@@ -3,8 +3,11 @@
 #include "../core/datetime.h"
 #include "../core/makedir.h"
 #include "../core/fileutils.h"
+#include "../core/numa.h"
 #include "../neuralnet/nninterface.h"
+#include "../neuralnet/nnsharedexecutor.h"
 #include "../search/patternbonustable.h"
+#include "../vcfsolver/VCFsolver.h"
 
 using namespace std;
 
@@ -59,6 +62,48 @@ NNEvaluator* Setup::initializeNNEvaluator(
   return nnEvals[0];
 }
 
+//Shared by all the evaluators in the process set up with nnSharedExecutorSlots. Never freed, since evaluators using it
+//can be created and destroyed at any point in the run, such as by selfplay switching models.
+static NNSharedExecutor* getSharedExecutor(int numSlots, Logger& logger) {
+  static std::mutex sharedExecutorMutex;
+  static NNSharedExecutor* sharedExecutor = NULL;
+  std::lock_guard<std::mutex> lock(sharedExecutorMutex);
+  if(sharedExecutor == NULL) {
+    sharedExecutor = new NNSharedExecutor(numSlots);
+    logger.write("Neural net evaluators will share " + Global::intToString(numSlots) + " concurrent batches");
+  }
+  else if(sharedExecutor->getNumSlots() != numSlots) {
+    logger.write(
+      "WARNING: nnSharedExecutorSlots changed to " + Global::intToString(numSlots) + ", still using the first value " +
+      Global::intToString(sharedExecutor->getNumSlots())
+    );
+  }
+  return sharedExecutor;
+}
+
+//Process-wide, so applied by the first call only, before anything that should be pinned or interleaved is created.
+//The keys are still read on every call so that they count as used.
+static void applyNUMASettings(ConfigParser& cfg, Logger& logger) {
+  bool pinThreads = cfg.contains("numaPinThreads") ? cfg.getBool("numaPinThreads") : false;
+  bool interleaveTables = cfg.contains("numaInterleaveTables") ? cfg.getBool("numaInterleaveTables") : false;
+
+  static std::once_flag numaSettingsFlag;
+  std::call_once(numaSettingsFlag, [&]() {
+    if(NUMA::getNumNodes() > 1 || pinThreads || interleaveTables)
+      logger.write(NUMA::getTopologyString());
+    NUMA::setPinThreads(pinThreads);
+    NUMA::setInterleaveTables(interleaveTables);
+    if(pinThreads)
+      logger.write("Pinning search and neural net server threads to NUMA nodes round robin");
+    if(interleaveTables) {
+      logger.write("Interleaving neural net cache and VCF hash table across NUMA nodes");
+#ifdef USE_VCF
+      VCFsolver::hashtable.interleaveMemory();
+#endif
+    }
+  });
+}
+
 vector<NNEvaluator*> Setup::initializeNNEvaluators(
   const vector<string>& nnModelNames,
   const vector<string>& nnModelFiles,
@@ -76,6 +121,7 @@ vector<NNEvaluator*> Setup::initializeNNEvaluators(
 ) {
   vector<NNEvaluator*> nnEvals;
   assert(nnModelNames.size() == nnModelFiles.size());
+  applyNUMASettings(cfg, logger);
   assert(expectedSha256s.size() == 0 || expectedSha256s.size() == nnModelFiles.size());
 
   #if defined(USE_CUDA_BACKEND)
@@ -170,13 +216,17 @@ vector<NNEvaluator*> Setup::initializeNNEvaluators(
 #ifndef USE_EIGEN_BACKEND
     (void)expectedConcurrentEvals;
     cfg.markAllKeysUsedWithPrefix("numEigenThreadsPerModel");
+    cfg.markAllKeysUsedWithPrefix("numEigenIntraOpThreads");
+    int numEigenIntraOpThreads = 1;
     int numNNServerThreadsPerModel =
       cfg.contains("numNNServerThreadsPerModel") ? cfg.getInt("numNNServerThreadsPerModel",1,1024) : 1;
 #else
     cfg.markAllKeysUsedWithPrefix("numNNServerThreadsPerModel");
+    int numEigenIntraOpThreads =
+      cfg.contains("numEigenIntraOpThreads") ? cfg.getInt("numEigenIntraOpThreads",1,1024) : 1;
     int numNNServerThreadsPerModel =
       cfg.contains("numEigenThreadsPerModel") ? cfg.getInt("numEigenThreadsPerModel",1,1024) :
-      computeDefaultEigenBackendThreads(expectedConcurrentEvals,logger);
+      computeDefaultEigenBackendThreads(expectedConcurrentEvals,numEigenIntraOpThreads,logger);
 #endif
 
     vector<int> gpuIdxByServerThread;
@@ -275,6 +325,14 @@ vector<NNEvaluator*> Setup::initializeNNEvaluators(
       setupFor == SETUP_FOR_ANALYSIS ? 17 :
       cfg.getInt("nnMutexPoolSizePowerOfTwo", -1, 24);
 
+    //If set, a compact cache of this size is used instead of the nnCacheSizePowerOfTwo one
+    int64_t nnCacheMemoryBytes =
+      cfg.contains("nnCacheMemoryMB") ? (int64_t)(cfg.getDouble("nnCacheMemoryMB", 0.0, 1.0e8) * 1024.0 * 1024.0) : 0;
+    int nnCachePolicyBits =
+      cfg.contains("nnCachePolicyBits") ? cfg.getInt("nnCachePolicyBits", 8, 16) : 16;
+    if(nnCachePolicyBits != 8 && nnCachePolicyBits != 16)
+      throw StringError("nnCachePolicyBits must be 8 or 16");
+
 #ifndef USE_EIGEN_BACKEND
     int nnMaxBatchSize;
     if(setupFor == SETUP_FOR_BENCHMARK || setupFor == SETUP_FOR_DISTRIBUTED) {
@@ -314,10 +372,13 @@ vector<NNEvaluator*> Setup::initializeNNEvaluators(
       inputsUseNHWC,
       nnCacheSizePowerOfTwo,
       nnMutexPoolSizePowerOfTwo,
+      nnCacheMemoryBytes,
+      nnCachePolicyBits,
       debugSkipNeuralNet,
       openCLTunerFile,
       homeDataDirOverride,
       openCLReTunePerBoardSize,
+      numEigenIntraOpThreads,
       useFP16Mode,
       useNHWCMode,
       numNNServerThreadsPerModel,
@@ -327,6 +388,34 @@ vector<NNEvaluator*> Setup::initializeNNEvaluators(
       defaultSymmetry
     );
 
+    if(cfg.contains("nnPersistentCacheDir")) {
+      string nnPersistentCacheDir = cfg.getString("nnPersistentCacheDir");
+      bool nnPersistentCacheReadOnly = cfg.contains("nnPersistentCacheReadOnly") ? cfg.getBool("nnPersistentCacheReadOnly") : false;
+      double nnPersistentCacheMaxMB = cfg.contains("nnPersistentCacheMaxMB") ? cfg.getDouble("nnPersistentCacheMaxMB", 1.0, 1.0e8) : 4096.0;
+      int nnPersistentCacheMaxTurns = cfg.contains("nnPersistentCacheMaxTurns") ? cfg.getInt("nnPersistentCacheMaxTurns", -1, 100000) : -1;
+      nnEval->openPersistentCache(
+        nnPersistentCacheDir,
+        nnPersistentCacheReadOnly,
+        (int64_t)(nnPersistentCacheMaxMB * 1024.0 * 1024.0),
+        nnPersistentCacheMaxTurns
+      );
+    }
+    if(cfg.contains("nnCacheCanonicalSymmetry"))
+      nnEval->setUseCanonicalCacheKeys(cfg.getBool("nnCacheCanonicalSymmetry"));
+    if(cfg.contains("nnPriorityStarvationLimit"))
+      nnEval->setPriorityStarvationLimit(cfg.getInt64("nnPriorityStarvationLimit", 0, (int64_t)1 << 40));
+    if(cfg.contains("nnBatchFillMaxWaitMs"))
+      nnEval->setMaxBatchFillWait(cfg.getDouble("nnBatchFillMaxWaitMs", 0.0, 1000.0) * 0.001);
+    if(cfg.contains("nnSharedExecutorSlots") && setupFor != SETUP_FOR_DISTRIBUTED) {
+      int nnSharedExecutorSlots = cfg.getInt("nnSharedExecutorSlots", 0, 1024);
+      double nnSharedExecutorWeight =
+        cfg.contains("nnSharedExecutorWeight"+idxStr) ? cfg.getDouble("nnSharedExecutorWeight"+idxStr, 0.001, 1000.0) :
+        cfg.contains("nnSharedExecutorWeight") ? cfg.getDouble("nnSharedExecutorWeight", 0.001, 1000.0) :
+        1.0;
+      if(nnSharedExecutorSlots > 0)
+        nnEval->setSharedExecutor(getSharedExecutor(nnSharedExecutorSlots, logger), nnSharedExecutorWeight);
+    }
+
     nnEval->spawnServerThreads();
 
     nnEvals.push_back(nnEval);
@@ -335,7 +424,7 @@ vector<NNEvaluator*> Setup::initializeNNEvaluators(
   return nnEvals;
 }
 
-int Setup::computeDefaultEigenBackendThreads(int expectedConcurrentEvals, Logger& logger) {
+int Setup::computeDefaultEigenBackendThreads(int expectedConcurrentEvals, int numEigenIntraOpThreads, Logger& logger) {
   auto getNumCores = [&logger]() {
     int numCores = (int)std::thread::hardware_concurrency();
     if(numCores <= 0) {
@@ -345,7 +434,7 @@ int Setup::computeDefaultEigenBackendThreads(int expectedConcurrentEvals, Logger
     }
     return numCores;
   };
-  return std::min(expectedConcurrentEvals, getNumCores());
+  return std::min(expectedConcurrentEvals, std::max(1, getNumCores() / std::max(1, numEigenIntraOpThreads)));
 }
 
 string Setup::loadHomeDataDirOverride(
@@ -420,6 +509,10 @@ vector<SearchParams> Setup::loadParams(
       throw ConfigParsingError("The config for this command cannot have numBots > 0");
   }
 
+  //The VCF solver is shared by all bots in the process
+  if(cfg.contains("vcfMinHitRate"))
+    VCFsolver::minHitRateToSolve = cfg.getDouble("vcfMinHitRate",0.0,1.0);
+
   for(int i = 0; i<numBots; i++) {
     SearchParams params;
 
@@ -441,6 +534,12 @@ vector<SearchParams> Setup::loadParams(
     if(cfg.contains("maxTimePondering"+idxStr)) params.maxTimePondering = cfg.getDouble("maxTimePondering"+idxStr, 0.0, 1.0e20);
     else if(cfg.contains("maxTimePondering"))   params.maxTimePondering = cfg.getDouble("maxTimePondering",        0.0, 1.0e20);
     else                                        params.maxTimePondering = 1.0e20;
+    if(cfg.contains("maxTreeNodesPondering"+idxStr)) params.maxTreeNodesPondering = cfg.getInt64("maxTreeNodesPondering"+idxStr, (int64_t)1000, (int64_t)1 << 50);
+    else if(cfg.contains("maxTreeNodesPondering"))   params.maxTreeNodesPondering = cfg.getInt64("maxTreeNodesPondering",        (int64_t)1000, (int64_t)1 << 50);
+    else                                             params.maxTreeNodesPondering = (int64_t)1 << 50;
+    if(cfg.contains("maxTreeBytesPondering"+idxStr)) params.maxTreeBytesPondering = cfg.getDouble("maxTreeBytesPondering"+idxStr, 1.0e6, 1.0e20);
+    else if(cfg.contains("maxTreeBytesPondering"))   params.maxTreeBytesPondering = cfg.getDouble("maxTreeBytesPondering",        1.0e6, 1.0e20);
+    else                                             params.maxTreeBytesPondering = 1.0e20;
 
     if(cfg.contains("lagBuffer"+idxStr)) params.lagBuffer = cfg.getDouble("lagBuffer"+idxStr, 0.0, 3600.0);
     else if(cfg.contains("lagBuffer"))   params.lagBuffer = cfg.getDouble("lagBuffer",        0.0, 3600.0);
@@ -529,6 +628,12 @@ vector<SearchParams> Setup::loadParams(
     if(cfg.contains("noisePruningCap"+idxStr)) params.noisePruningCap = cfg.getDouble("noisePruningCap"+idxStr, 0.0, 1e50);
     else if(cfg.contains("noisePruningCap"))   params.noisePruningCap = cfg.getDouble("noisePruningCap", 0.0, 1e50);
     else                                       params.noisePruningCap = 1e50;
+    if(cfg.contains("useIncrementalBackup"+idxStr)) params.useIncrementalBackup = cfg.getBool("useIncrementalBackup"+idxStr);
+    else if(cfg.contains("useIncrementalBackup"))   params.useIncrementalBackup = cfg.getBool("useIncrementalBackup");
+    else                                            params.useIncrementalBackup = false;
+    if(cfg.contains("incrementalBackupFullRecomputeInterval"+idxStr)) params.incrementalBackupFullRecomputeInterval = cfg.getInt("incrementalBackupFullRecomputeInterval"+idxStr, 1, 1 << 30);
+    else if(cfg.contains("incrementalBackupFullRecomputeInterval"))   params.incrementalBackupFullRecomputeInterval = cfg.getInt("incrementalBackupFullRecomputeInterval", 1, 1 << 30);
+    else                                                              params.incrementalBackupFullRecomputeInterval = 64;
 
 
     if(cfg.contains("useUncertainty"+idxStr)) params.useUncertainty = cfg.getBool("useUncertainty"+idxStr);
@@ -674,6 +779,12 @@ vector<SearchParams> Setup::loadParams(
       params.nnPolicyTemperature = cfg.getFloat("nnPolicyTemperature",0.01f,5.0f);
     else
       params.nnPolicyTemperature = 1.0f;
+    if(cfg.contains("nnEvalPriority"+idxStr))
+      params.nnEvalPriority = NNPriority::parse(cfg.getString("nnEvalPriority"+idxStr));
+    else if(cfg.contains("nnEvalPriority"))
+      params.nnEvalPriority = NNPriority::parse(cfg.getString("nnEvalPriority"));
+    else
+      params.nnEvalPriority = NNPriority::NORMAL;
     /*
     if(cfg.contains("ignorePreRootHistory" + idxStr))
       params.ignorePreRootHistory = cfg.getBool("ignorePreRootHistory" + idxStr);
@@ -769,6 +880,21 @@ vector<SearchParams> Setup::loadParams(
     if(cfg.contains("obviousMovesPolicySurpriseTolerance"+idxStr)) params.obviousMovesPolicySurpriseTolerance = cfg.getDouble("obviousMovesPolicySurpriseTolerance"+idxStr,0.001,2.0);
     else if(cfg.contains("obviousMovesPolicySurpriseTolerance"))   params.obviousMovesPolicySurpriseTolerance = cfg.getDouble("obviousMovesPolicySurpriseTolerance",0.001,2.0);
     else                                                           params.obviousMovesPolicySurpriseTolerance = 0.15;
+    if(cfg.contains("useTacticalTimeManagement"+idxStr)) params.useTacticalTimeManagement = cfg.getBool("useTacticalTimeManagement"+idxStr);
+    else if(cfg.contains("useTacticalTimeManagement"))   params.useTacticalTimeManagement = cfg.getBool("useTacticalTimeManagement");
+    else                                                 params.useTacticalTimeManagement = false;
+    if(cfg.contains("tacticalTimeBankFactor"+idxStr)) params.tacticalTimeBankFactor = cfg.getDouble("tacticalTimeBankFactor"+idxStr,0.0,1.0);
+    else if(cfg.contains("tacticalTimeBankFactor"))   params.tacticalTimeBankFactor = cfg.getDouble("tacticalTimeBankFactor",0.0,1.0);
+    else                                              params.tacticalTimeBankFactor = 0.5;
+    if(cfg.contains("rootVCFNumThreads"+idxStr)) params.rootVCFNumThreads = cfg.getInt("rootVCFNumThreads"+idxStr,0,1024);
+    else if(cfg.contains("rootVCFNumThreads"))   params.rootVCFNumThreads = cfg.getInt("rootVCFNumThreads",        0,1024);
+    else                                         params.rootVCFNumThreads = 0;
+    if(cfg.contains("rootVCFMaxNodes"+idxStr)) params.rootVCFMaxNodes = cfg.getInt64("rootVCFMaxNodes"+idxStr,(int64_t)1,(int64_t)1 << 50);
+    else if(cfg.contains("rootVCFMaxNodes"))   params.rootVCFMaxNodes = cfg.getInt64("rootVCFMaxNodes",        (int64_t)1,(int64_t)1 << 50);
+    else                                       params.rootVCFMaxNodes = 2000000;
+    if(cfg.contains("rootVCFMaxTime"+idxStr)) params.rootVCFMaxTime = cfg.getDouble("rootVCFMaxTime"+idxStr,0.0,1.0e20);
+    else if(cfg.contains("rootVCFMaxTime"))   params.rootVCFMaxTime = cfg.getDouble("rootVCFMaxTime",        0.0,1.0e20);
+    else                                      params.rootVCFMaxTime = 1.0;
     if(cfg.contains("futileVisitsThreshold"+idxStr)) params.futileVisitsThreshold = cfg.getDouble("futileVisitsThreshold"+idxStr,0.01,1.0);
     else if(cfg.contains("futileVisitsThreshold"))   params.futileVisitsThreshold = cfg.getDouble("futileVisitsThreshold",0.01,1.0);
     else                                             params.futileVisitsThreshold = 0.0;
@@ -88,6 +88,14 @@ Search* AsyncBot::getSearchStopAndWait() {
   stopAndWait();
   return search;
 }
+Search* AsyncBot::swapSearch(Search* newSearch) {
+  assert(newSearch != NULL);
+  stopAndWait();
+  std::lock_guard<std::mutex> lock(controlMutex);
+  Search* oldSearch = search;
+  search = newSearch;
+  return oldSearch;
+}
 const Search* AsyncBot::getSearch() const {
   return search;
 }
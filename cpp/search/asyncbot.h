@@ -37,6 +37,9 @@ class AsyncBot {
   //Get the search, after stopping and waiting to terminate any existing search
   //Note that one still should NOT mind any threading issues using this search object and other asyncBot calls at the same time.
   Search* getSearchStopAndWait();
+  //Replace the search of this bot with newSearch after stopping and waiting, returning the old one, which the caller then owns.
+  //newSearch is used as it is, so it should already have the position and params that the caller wants.
+  Search* swapSearch(Search* newSearch);
 
   //Setup, same as in search.h
   //Calling any of these will stop any ongoing search, waiting for a full stop.
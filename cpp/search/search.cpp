@@ -84,6 +84,11 @@ Search::Search(SearchParams params, NNEvaluator* nnEval, NNEvaluator* humanEval,
    plaThatSearchIsFor(C_EMPTY),plaThatSearchIsForLastSearch(C_EMPTY),
    lastSearchNumPlayouts(0),
    effectiveSearchTimeCarriedOver(0.0),
+   tacticalTimeBank(0.0),
+   rootTacticallyDecided(false),
+   tacticalTimeSavedThisSearch(0.0),
+   tacticalTimeBankSpentThisSearch(0.0),
+   rootVCFWinLoc(Board::NULL_LOC),
    randSeed(rSeed),
    valueWeightDistribution(NULL),
    patternBonusTable(NULL),
@@ -169,6 +174,7 @@ void Search::setPosition(Player pla, const Board& board, const BoardHistory& his
   plaThatSearchIsFor = C_EMPTY;
   rootBoard = board;
   rootHistory = history;
+  rootVCFWinLoc = Board::NULL_LOC;
   avoidMoveUntilByLocBlack.clear();
   avoidMoveUntilByLocWhite.clear();
 }
@@ -176,6 +182,7 @@ void Search::setPosition(Player pla, const Board& board, const BoardHistory& his
 void Search::setPlayerAndClearHistory(Player pla) {
   clearSearch();
   rootPla = pla;
+  rootVCFWinLoc = Board::NULL_LOC;
   plaThatSearchIsFor = C_EMPTY;
   Rules rules = rootHistory.rules;
   //Preserve this value even when we get multiple moves in a row by some player
@@ -270,6 +277,8 @@ void Search::setNNEval(NNEvaluator* nnEval) {
 
 void Search::clearSearch() {
   effectiveSearchTimeCarriedOver = 0.0;
+  tacticalTimeBank = 0.0;
+  tacticalTimeBankSpentThisSearch = 0.0;
   if(rootNode != NULL) {
     deleteAllTableNodesMulithreaded();
     //Root is not stored in node table
@@ -299,6 +308,7 @@ bool Search::makeMove(Loc moveLoc, Player movePla) {
 
   rootHistory.makeBoardMoveAssumeLegal(rootBoard, moveLoc, rootPla);
   rootPla = getOpp(rootPla);
+  rootVCFWinLoc = Board::NULL_LOC;
 
   if(rootNode != NULL) {
     SearchNode* child = NULL;
@@ -408,6 +418,9 @@ void Search::runWholeSearch(
   if(!std::atomic_is_lock_free(&shouldStopNow))
     logger->write("Warning: bool atomic shouldStopNow is not lock free");
 
+  //Before beginSearch, so that the root evaluation sees the result and existing root children can be filtered by it
+  solveRootVCF(pondering, tc);
+
   //Do this first, just in case this causes us to clear things and have 0 effective time carried over
   beginSearch(pondering);
   if(searchBegun != NULL)
@@ -444,6 +457,11 @@ void Search::runWholeSearch(
   std::atomic<double> upperBoundVisitsLeftDueToTime(TimeControls::UNLIMITED_TIME_DEFAULT);  
   const bool hasMaxTime = maxTime < TimeControls::UNLIMITED_TIME_MAX;
   const bool hasTc = !pondering && !tc.isEffectivelyUnlimitedTime();
+  const int64_t treeNodeCap = pondering ? getPonderingTreeNodeCap() : ((int64_t)1 << 62);
+  std::atomic<bool> treeNeedsPruning(false);
+  rootTacticallyDecided = hasTc && searchParams.useTacticalTimeManagement && computeRootTacticallyDecided();
+  tacticalTimeSavedThisSearch = 0.0;
+  tacticalTimeBankSpentThisSearch = 0.0;
   if(!pondering && (hasTc || hasMaxTime)) {
     int64_t rootVisits = numPlayoutsShared.load(std::memory_order_relaxed) + numNonPlayoutVisits;
     double timeUsed = timer.getSeconds();
@@ -458,7 +476,7 @@ void Search::runWholeSearch(
 
   std::function<void(int)> searchLoop = [
     this,&timer,&numPlayoutsShared,numNonPlayoutVisits,&tcMaxTime,&upperBoundVisitsLeftDueToTime,&tc,
-    &hasMaxTime,&hasTc,
+    &hasMaxTime,&hasTc,treeNodeCap,&treeNeedsPruning,
     &shouldStopNow,maxVisits,maxPlayouts,maxTime,pondering,searchFactor
   ](int threadIdx) {
     SearchThread* stbuf = new SearchThread(threadIdx,*this);
@@ -491,6 +509,12 @@ void Search::runWholeSearch(
           break;
         }
 
+        //Tree is too big, pause so that it can be pruned, see below
+        if(nodeTable->numNodes.load(std::memory_order_relaxed) > treeNodeCap) {
+          treeNeedsPruning.store(true,std::memory_order_relaxed);
+          break;
+        }
+
         //Thread 0 alone is responsible for recomputing time limits every once in a while
         //Cap of 10 times per second.
         if(!pondering && (hasTc || hasMaxTime) && threadIdx == 0 && timeUsed >= lastTimeUsedRecomputingTcLimit + 0.1) {
@@ -533,7 +557,25 @@ void Search::runWholeSearch(
   };
 
   double actualSearchStartTime = timer.getSeconds();
-  performTaskWithThreads(&searchLoop, capThreads);
+  while(true) {
+    performTaskWithThreads(&searchLoop, capThreads);
+    if(!treeNeedsPruning.load(std::memory_order_relaxed) || shouldStopNow.load(std::memory_order_relaxed))
+      break;
+    treeNeedsPruning.store(false,std::memory_order_relaxed);
+
+    //Prune well below the cap so that we don't need to do it again too soon.
+    int64_t numNodesBefore = nodeTable->numNodes.load(std::memory_order_relaxed);
+    pruneTreeToNodeCount(treeNodeCap / 4 * 3);
+    int64_t numNodesAfter = nodeTable->numNodes.load(std::memory_order_relaxed);
+    logger->write(
+      "Pruned search tree while pondering from " + Global::int64ToString(numNodesBefore) +
+      " to " + Global::int64ToString(numNodesAfter) + " nodes"
+    );
+    if(numNodesAfter > treeNodeCap) {
+      logger->write("Could not prune search tree below cap, stopping pondering");
+      break;
+    }
+  }
 
   // If the search did not actually do anything, we need to still make sure to update the root node if it needs
   // such an update (since root params may differ from tree params).
@@ -551,6 +593,8 @@ void Search::runWholeSearch(
   //Relaxed load is fine since numPlayoutsShared should be synchronized already due to the joins
   lastSearchNumPlayouts = numPlayoutsShared.load(std::memory_order_relaxed);
   effectiveSearchTimeCarriedOver += timer.getSeconds() - actualSearchStartTime;
+  if(hasTc)
+    updateTacticalTimeBank(timer.getSeconds());
 }
 
 //If we're being asked to search from a position where the game is over, this is fine. Just keep going, the boardhistory
@@ -720,7 +764,7 @@ void Search::beginSearch(bool pondering) {
         node.statsLock.clear(std::memory_order_release);
 
         //Update all other stats
-        recomputeNodeStats(node, dummyThread, 0, true);
+        recomputeNodeStats(node, dummyThread, 0, true, -1);
       }
     }
 
@@ -811,6 +855,7 @@ SearchNode* Search::allocateOrFindNode(SearchThread& thread, Player nextPla, Loc
 
       //Insert into map! Use insertLoc as hint.
       nodeMap.insert(insertLoc, std::make_pair(childHash,child));
+      nodeTable->numNodes.fetch_add(1,std::memory_order_relaxed);
     }
     break;
   }
@@ -849,6 +894,7 @@ void Search::deleteAllOldOrAllNewTableNodesAndSubtreeValueBiasMulithreaded(bool
   std::function<void(int)> g = [&](int threadIdx) {
     size_t idx0 = (size_t)((uint64_t)(threadIdx) * nodeTable->entries.size() / (numAdditionalThreads+1));
     size_t idx1 = (size_t)((uint64_t)(threadIdx+1) * nodeTable->entries.size() / (numAdditionalThreads+1));
+    int64_t numDeleted = 0;
     for(size_t i = idx0; i<idx1; i++) {
       std::map<Hash128,SearchNode*>& nodeMap = nodeTable->entries[i];
       for(auto it = nodeMap.cbegin(); it != nodeMap.cend();) {
@@ -857,11 +903,13 @@ void Search::deleteAllOldOrAllNewTableNodesAndSubtreeValueBiasMulithreaded(bool
           removeSubtreeValueBias(node);
           delete node;
           it = nodeMap.erase(it);
+          numDeleted++;
         }
         else
           ++it;
       }
     }
+    nodeTable->numNodes.fetch_sub(numDeleted,std::memory_order_relaxed);
   };
   performTaskWithThreads(&g, 0x3FFFffff);
 }
@@ -883,6 +931,96 @@ void Search::deleteAllTableNodesMulithreaded() {
     }
   };
   performTaskWithThreads(&g, 0x3FFFffff);
+  nodeTable->numNodes.store(0,std::memory_order_relaxed);
+}
+
+//Rough memory used per node of the search tree, including its nnOutput, a few children and its table entry.
+double Search::estimatedBytesPerTreeNode() const {
+  return (double)(sizeof(SearchNode) + sizeof(NNOutput) + policySize * sizeof(float) + 8 * sizeof(SearchChildPointer) + 64);
+}
+
+double Search::getApproxTreeBytes() const {
+  if(rootNode == NULL)
+    return 0.0;
+  //Root is not stored in node table
+  return (nodeTable->numNodes.load(std::memory_order_relaxed) + 1) * estimatedBytesPerTreeNode();
+}
+
+double Search::getApproxFixedBytes() const {
+  double bytes = (double)sizeof(Search);
+  bytes += nodeTable->entries.size() * (double)(sizeof(std::map<Hash128,SearchNode*>) + sizeof(std::mutex));
+  bytes += mutexPool->getNumMutexes() * (double)sizeof(std::mutex);
+  if(subtreeValueBiasTable != NULL)
+    bytes += subtreeValueBiasTable->entries.size() * (double)(sizeof(std::map<Hash128,std::shared_ptr<SubtreeValueBiasEntry>>) + sizeof(std::mutex));
+  return bytes;
+}
+
+int64_t Search::getPonderingTreeNodeCap() const {
+  double cap = std::min((double)searchParams.maxTreeNodesPondering, searchParams.maxTreeBytesPondering / estimatedBytesPerTreeNode());
+  return (int64_t)std::min(cap, (double)((int64_t)1 << 62));
+}
+
+//Shrink the table to at most targetNumNodes nodes by turning the least visited nodes into leaves and deleting whatever is
+//no longer reachable. Collapsed nodes keep their stats as they are, summarizing the dropped subtree, so nothing else in the
+//tree changes. If search reaches them again, they regrow children, with those stats frozen in SearchNode::collapsedSums
+//taking the place of their own nn evaluation, so their values and visits carry on smoothly.
+//Like the other functions here, must not be called concurrently with search.
+void Search::pruneTreeToNodeCount(int64_t targetNumNodes) {
+  if(rootNode == NULL)
+    return;
+  int64_t rootVisits = rootNode->stats.visits.load(std::memory_order_acquire);
+  for(int64_t visitThreshold = 2; visitThreshold <= rootVisits; visitThreshold *= 2) {
+    if(nodeTable->numNodes.load(std::memory_order_relaxed) <= targetNumNodes)
+      break;
+
+    //Find everything to collapse first and only then modify, so that we never free children arrays another thread is walking.
+    std::vector<std::vector<SearchNode*>> nodesToCollapse(numAdditionalThreadsToUseForTasks()+1);
+    std::function<void(SearchNode*,int)> f = [&](SearchNode* node, int threadIdx) {
+      if(node != rootNode &&
+         node->stats.visits.load(std::memory_order_acquire) < visitThreshold &&
+         node->getChildren().iterateAndCountChildren() > 0)
+        nodesToCollapse[threadIdx].push_back(node);
+    };
+    applyRecursivelyAnyOrderMulithreaded({rootNode}, &f);
+
+    for(const std::vector<SearchNode*>& nodes: nodesToCollapse) {
+      for(SearchNode* node: nodes) {
+        NodeStats stats(node->stats);
+        if(stats.weightSum > 0.0) {
+          std::unique_ptr<ChildValueSums> sums = std::make_unique<ChildValueSums>();
+          //Without the pattern bonus, which recomputeNodeStats adds on top of the sums
+          double utilityAvg = stats.utilityAvg - getPatternBonus(node->patternBonusHash,getOpp(node->nextPla));
+          double utilitySqAvg = stats.utilitySqAvg - (stats.utilityAvg * stats.utilityAvg - utilityAvg * utilityAvg);
+          sums->weightSum = stats.weightSum;
+          sums->winLossValueSum = stats.winLossValueAvg * stats.weightSum;
+          sums->noResultValueSum = stats.noResultValueAvg * stats.weightSum;
+          sums->utilitySum = utilityAvg * stats.weightSum;
+          sums->utilitySqSum = utilitySqAvg * stats.weightSum;
+          sums->weightSqSum = stats.weightSqSum;
+          node->collapsedSums = std::move(sums);
+        }
+        SearchNodeChildrenReference children = node->getChildren();
+        int childrenCapacity = children.getCapacity();
+        for(int i = 0; i<childrenCapacity; i++) {
+          children[i].store(NULL);
+          children[i].setEdgeVisits(0);
+          children[i].setMoveLoc(Board::NULL_LOC);
+        }
+        node->collapseChildrenCapacity(0);
+        //Anything cached about the old children is no longer valid
+        node->incrementalBackup.reset();
+        node->selectionCacheVisits.store(-1,std::memory_order_release);
+      }
+    }
+
+    //Sweep over the tree marking everything reachable, and delete the rest.
+    applyRecursivelyAnyOrderMulithreaded({rootNode}, NULL);
+    bool old = true;
+    deleteAllOldOrAllNewTableNodesAndSubtreeValueBiasMulithreaded(old);
+  }
+
+  if(searchParams.subtreeValueBiasFactor != 0 && subtreeValueBiasTable != NULL)
+    subtreeValueBiasTable->clearUnusedSynchronous();
 }
 
 //This function should NOT ever be called concurrently with any other threads modifying the search tree.
@@ -951,6 +1089,11 @@ void Search::recursivelyRecomputeStats(SearchNode& n) {
         double newUtilityAvg = resultUtility;
         newUtilityAvg += getPatternBonus(node->patternBonusHash,getOpp(node->nextPla));
         double newUtilitySqAvg = newUtilityAvg * newUtilityAvg;
+        //Keep the frozen stats of a pruned node in line, they're what its stats will be recomputed from if it regrows
+        if(node->collapsedSums != nullptr) {
+          node->collapsedSums->utilitySum = resultUtility * node->collapsedSums->weightSum;
+          node->collapsedSums->utilitySqSum = resultUtility * resultUtility * node->collapsedSums->weightSum;
+        }
 
         while(node->statsLock.test_and_set(std::memory_order_acquire));
         node->stats.utilityAvg.store(newUtilityAvg,std::memory_order_release);
@@ -960,7 +1103,7 @@ void Search::recursivelyRecomputeStats(SearchNode& n) {
     }
     else {
       //Otherwise recompute it using the usual method
-      recomputeNodeStats(*node, thread, 0, isRoot);
+      recomputeNodeStats(*node, thread, 0, isRoot, -1);
     }
   };
 
@@ -1198,7 +1341,7 @@ bool Search::playoutDescend(
       //Instead just add edge visits and treat that as a visit.
       //If we're not counting edge visits, then we're deliberately trying to add child visits beyond edge visits, don't return early
       if(countEdgeVisit && maybeCatchUpEdgeVisits(thread, node, child, nodeState, bestChildIdx)) {
-        updateStatsAfterPlayout(node,thread,isRoot);
+        updateStatsAfterPlayout(node,thread,isRoot,bestChildIdx);
         child->virtualLosses.fetch_add(-1,std::memory_order_release);
         return true;
       }
@@ -1215,7 +1358,7 @@ bool Search::playoutDescend(
       //Instead just add edge visits and treat that as a visit.
       //If we're not counting edge visits, then we're deliberately trying to add child visits beyond edge visits, don't return early
       if(countEdgeVisit && maybeCatchUpEdgeVisits(thread, node, child, nodeState, bestChildIdx)) {
-        updateStatsAfterPlayout(node,thread,isRoot);
+        updateStatsAfterPlayout(node,thread,isRoot,bestChildIdx);
         // Regardless of whether we count an edge visit or not here, we
         // leave thread.shouldCountPlayout as true so that if we repeatedly are stuck searching a cycle
         // we don't go forever, and eventually hit a visits/playouts limit.
@@ -1245,7 +1388,7 @@ bool Search::playoutDescend(
       if(countEdgeVisit) {
         SearchNodeChildrenReference children = node.getChildren(nodeState);
         children[bestChildIdx].addEdgeVisits(1);
-        updateStatsAfterPlayout(node,thread,isRoot);
+        updateStatsAfterPlayout(node,thread,isRoot,bestChildIdx);
         thread.shouldCountPlayout = true;
       }
       child->virtualLosses.fetch_add(-1,std::memory_order_release);
@@ -1263,7 +1406,7 @@ bool Search::playoutDescend(
     nodeState = node.state.load(std::memory_order_acquire);
     SearchNodeChildrenReference children = node.getChildren(nodeState);
     children[bestChildIdx].addEdgeVisits(1);
-    updateStatsAfterPlayout(node,thread,isRoot);
+    updateStatsAfterPlayout(node,thread,isRoot,bestChildIdx);
   }
   child->virtualLosses.fetch_add(-1,std::memory_order_release);
 
@@ -32,6 +32,7 @@ struct DistributionTable;
 struct PatternBonusTable;
 struct PolicySortEntry;
 struct MoreNodeStats;
+struct ChildValueSums;
 struct ReportedSearchValues;
 struct SearchChildPointer;
 struct SubtreeValueBiasTable;
@@ -119,6 +120,11 @@ struct Search {
   Player plaThatSearchIsForLastSearch;
   int64_t lastSearchNumPlayouts;
   double effectiveSearchTimeCarriedOver; //Effective search time carried over from previous moves due to ponder/tree reuse
+  double tacticalTimeBank; //Time saved by moving instantly on tactically decided moves, still to be spent on later moves
+  bool rootTacticallyDecided; //Whether ResultsBeforeNN found the root move forced or proven before the current search
+  double tacticalTimeSavedThisSearch; //Time the current search would have planned if the root were not tactically decided
+  double tacticalTimeBankSpentThisSearch; //Time from tacticalTimeBank added to the current search's planned time
+  Loc rootVCFWinLoc; //Winning move found by solveRootVCF before the current search, the only allowed root move if not NULL_LOC
 
   std::string randSeed;
 
@@ -234,6 +240,8 @@ struct Search {
   //Calling this is never necessary, it may just reduce some resource use.
   //searchmultithreadhelpers.cpp
   void respawnThreads();
+  //Stop all the threads in the thread pool, for a search that will sit idle for a while. They are spawned again when needed.
+  void releaseThreads();
 
   //Just directly clear search without changing anything
   void clearSearch();
@@ -326,6 +334,10 @@ struct Search {
 
   //Get the number of visits recorded for the root node
   int64_t getRootVisits() const;
+  //Approximate memory used by the nodes of the current tree
+  double getApproxTreeBytes() const;
+  //Approximate memory used by this search whatever the tree, by its tables and their shards
+  double getApproxFixedBytes() const;
   //Get the root node's policy prediction
   bool getPolicy(float policyProbs[NNPos::MAX_NN_POLICY_SIZE]) const;
   bool getPolicy(const SearchNode* node, float policyProbs[NNPos::MAX_NN_POLICY_SIZE]) const;
@@ -416,6 +428,7 @@ private:
   // searchhelpers.cpp
   //----------------------------------------------------------------------------------------
   bool isAllowedRootMove(Loc moveLoc) const;
+  void solveRootVCF(bool pondering, const TimeControls& tc);
   double getPatternBonus(Hash128 patternBonusHash, Player prevMovePla) const;
   bool shouldSuppressPass(const SearchNode* n) const;
 
@@ -461,6 +474,8 @@ private:
     int64_t rootVisits, double timeUsed, double plannedTimeLimit
   );
   double recomputeSearchTimeLimit(const TimeControls& tc, double timeUsed, double searchFactor, int64_t rootVisits);
+  bool computeRootTacticallyDecided() const;
+  void updateTacticalTimeBank(double timeSearched);
 
   //----------------------------------------------------------------------------------------
   // Neural net queries
@@ -543,10 +558,15 @@ private:
     double bestChildExploreSelectionValue
   ) const;
 
+  double getUtilityStdevFactor(int64_t visits, double weightSum, double utilityAvg, double utilitySqAvg) const;
   double getFpuValueForChildrenAssumeVisited(
     const SearchNode& node, Player pla, bool isRoot, double policyProbMassVisited,
     double& parentUtility, double& parentWeightPerVisit, double& parentUtilityStdevFactor
   ) const;
+  double getFpuValueForChildrenAssumeVisited(
+    const SearchNode& node, Player pla, bool isRoot, double policyProbMassVisited, bool useSelectionCache,
+    double& parentUtility, double& parentWeightPerVisit, double& parentUtilityStdevFactor
+  ) const;
 
   void selectBestChildToDescend(
     SearchThread& thread, const SearchNode& node, SearchNodeState nodeState,
@@ -571,8 +591,13 @@ private:
 
   double computeWeightFromNNOutput(const NNOutput* nnOutput) const;
 
-  void updateStatsAfterPlayout(SearchNode& node, SearchThread& thread, bool isRoot);
-  void recomputeNodeStats(SearchNode& node, SearchThread& thread, int32_t numVisitsToAdd, bool isRoot);
+  void updateStatsAfterPlayout(SearchNode& node, SearchThread& thread, bool isRoot, int changedChildIdx);
+  void recomputeNodeStats(SearchNode& node, SearchThread& thread, int32_t numVisitsToAdd, bool isRoot, int changedChildIdx);
+
+  bool canBackupIncrementally(bool isRoot) const;
+  void computeChildValueSums(const SearchChildPointer& childPointer, const NNOutput* nnOutput, ChildValueSums& ret) const;
+  bool maybeRecomputeNodeStatsIncrementally(SearchNode& node, int32_t numVisitsToAdd, int changedChildIdx);
+  void storeNodeStatsFromSums(SearchNode& node, int32_t numVisitsToAdd, const ChildValueSums& sums, double selectionMaxChildWeight);
 
   void downweightBadChildrenAndNormalizeWeight(
     int numChildren,
@@ -596,6 +621,9 @@ private:
   void removeSubtreeValueBias(SearchNode* node);
   void deleteAllOldOrAllNewTableNodesAndSubtreeValueBiasMulithreaded(bool old);
   void deleteAllTableNodesMulithreaded();
+  double estimatedBytesPerTreeNode() const;
+  int64_t getPonderingTreeNodeCap() const;
+  void pruneTreeToNodeCount(int64_t targetNumNodes);
 
   //----------------------------------------------------------------------------------------
   // Initialization and core search logic
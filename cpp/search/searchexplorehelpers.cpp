@@ -268,30 +268,18 @@ double Search::getReducedPlaySelectionWeight(
   return childWeight;
 }
 
-double Search::getFpuValueForChildrenAssumeVisited(
-  const SearchNode& node, Player pla, bool isRoot, double policyProbMassVisited,
-  double& parentUtility, double& parentWeightPerVisit, double& parentUtilityStdevFactor
-) const {
-  int64_t visits = node.stats.visits.load(std::memory_order_acquire);
-  double weightSum = node.stats.weightSum.load(std::memory_order_acquire);
-  double utilityAvg = node.stats.utilityAvg.load(std::memory_order_acquire);
-  double utilitySqAvg = node.stats.utilitySqAvg.load(std::memory_order_acquire);
-
-  assert(visits > 0);
-  assert(weightSum > 0.0);
-  parentWeightPerVisit = weightSum / visits;
-  parentUtility = utilityAvg;
+double Search::getUtilityStdevFactor(int64_t visits, double weightSum, double utilityAvg, double utilitySqAvg) const {
   double variancePrior = searchParams.cpuctUtilityStdevPrior * searchParams.cpuctUtilityStdevPrior;
   double variancePriorWeight = searchParams.cpuctUtilityStdevPriorWeight;
-  double parentUtilityStdev;
+  double utilityStdev;
   if(visits <= 0 || weightSum <= 1)
-    parentUtilityStdev = searchParams.cpuctUtilityStdevPrior;
+    utilityStdev = searchParams.cpuctUtilityStdevPrior;
   else {
-    double utilitySq = parentUtility * parentUtility;
+    double utilitySq = utilityAvg * utilityAvg;
     //Make sure we're robust to numerical precision issues or threading desync of these values, so we don't observe negative variance
     if(utilitySqAvg < utilitySq)
       utilitySqAvg = utilitySq;
-    parentUtilityStdev = sqrt(
+    utilityStdev = sqrt(
       std::max(
         0.0,
         ((utilitySq + variancePrior) * variancePriorWeight + utilitySqAvg * weightSum)
@@ -300,7 +288,38 @@ double Search::getFpuValueForChildrenAssumeVisited(
       )
     );
   }
-  parentUtilityStdevFactor = 1.0 + searchParams.cpuctUtilityStdevScale * (parentUtilityStdev / searchParams.cpuctUtilityStdevPrior - 1.0);
+  return 1.0 + searchParams.cpuctUtilityStdevScale * (utilityStdev / searchParams.cpuctUtilityStdevPrior - 1.0);
+}
+
+double Search::getFpuValueForChildrenAssumeVisited(
+  const SearchNode& node, Player pla, bool isRoot, double policyProbMassVisited,
+  double& parentUtility, double& parentWeightPerVisit, double& parentUtilityStdevFactor
+) const {
+  bool useSelectionCache = false;
+  return getFpuValueForChildrenAssumeVisited(
+    node, pla, isRoot, policyProbMassVisited, useSelectionCache,
+    parentUtility, parentWeightPerVisit, parentUtilityStdevFactor
+  );
+}
+
+double Search::getFpuValueForChildrenAssumeVisited(
+  const SearchNode& node, Player pla, bool isRoot, double policyProbMassVisited, bool useSelectionCache,
+  double& parentUtility, double& parentWeightPerVisit, double& parentUtilityStdevFactor
+) const {
+  int64_t visits = node.stats.visits.load(std::memory_order_acquire);
+  double weightSum = node.stats.weightSum.load(std::memory_order_acquire);
+  double utilityAvg = node.stats.utilityAvg.load(std::memory_order_acquire);
+
+  assert(visits > 0);
+  assert(weightSum > 0.0);
+  parentWeightPerVisit = weightSum / visits;
+  parentUtility = utilityAvg;
+  if(useSelectionCache)
+    parentUtilityStdevFactor = node.selectionUtilityStdevFactor.load(std::memory_order_acquire);
+  else {
+    double utilitySqAvg = node.stats.utilitySqAvg.load(std::memory_order_acquire);
+    parentUtilityStdevFactor = getUtilityStdevFactor(visits, weightSum, utilityAvg, utilitySqAvg);
+  }
 
   double parentUtilityForFPU = parentUtility;
   if(searchParams.fpuParentWeightByVisitedPolicy) {
@@ -351,7 +370,29 @@ void Search::selectBestChildToDescend(
 #ifndef QUANTIZED_OUTPUT
   const float* policyProbs = nnOutput?nnOutput->getPolicyProbsMaybeNoised():NULL;
 #endif
-  for(int i = 0; i<childrenCapacity; i++) {
+
+  //Use the aggregates left by the last recomputeNodeStats if nothing was backed up through this node since then.
+  //Not at the root, whose policy may be swapped mid-search for a noised or re-symmetrized one.
+  //Not with graph search either, where a transposed child can gain weight through another parent without this node's visits changing.
+  bool useSelectionCache = false;
+  if(!isRoot && !searchParams.useGraphSearch) {
+    int64_t selectionCacheVisits = node.selectionCacheVisits.load(std::memory_order_acquire);
+    if(selectionCacheVisits == node.stats.visits.load(std::memory_order_acquire)) {
+      policyProbMassVisited = node.selectionPolicyProbMassVisited.load(std::memory_order_acquire);
+      totalChildWeight = node.selectionTotalChildWeight.load(std::memory_order_acquire);
+      maxChildWeight = node.selectionMaxChildWeight.load(std::memory_order_acquire);
+      //The writer invalidates selectionCacheVisits before storing the aggregates, so if it is unchanged they weren't torn
+      if(node.selectionCacheVisits.load(std::memory_order_acquire) == selectionCacheVisits)
+        useSelectionCache = true;
+      else {
+        policyProbMassVisited = 0.0;
+        totalChildWeight = 0.0;
+        maxChildWeight = 0.0;
+      }
+    }
+  }
+
+  for(int i = 0; i<childrenCapacity && !useSelectionCache; i++) {
     const SearchChildPointer& childPointer = children[i];
     const SearchNode* child = childPointer.getIfAllocated();
     if(child == NULL)
@@ -464,7 +505,7 @@ void Search::selectBestChildToDescend(
   double parentWeightPerVisit;
   double parentUtilityStdevFactor;
   double fpuValue = getFpuValueForChildrenAssumeVisited(
-    node, thread.pla, isRoot, policyProbMassVisited,
+    node, thread.pla, isRoot, policyProbMassVisited, useSelectionCache,
     parentUtility, parentWeightPerVisit, parentUtilityStdevFactor
   );
 
@@ -4,6 +4,7 @@
 #include "../core/test.h"
 #include "../search/searchnode.h"
 #include "../search/patternbonustable.h"
+#include "../vcfsolver/VCFsolver.h"
 
 //------------------------
 #include "../core/using.h"
@@ -288,9 +289,51 @@ bool Search::isAllowedRootMove(Loc moveLoc) const {
   if(searchParams.rootSymmetryPruning && moveLoc != Board::PASS_LOC && rootSymDupLoc[moveLoc]) {
     return false;
   }
+  if(rootVCFWinLoc != Board::NULL_LOC && moveLoc != rootVCFWinLoc)
+    return false;
   return true;
 }
 
+//The VCF solved for every node during search has a small node limit. At the root a deeper one is worth it, using the cores that
+//would otherwise be idle before the search threads start.
+void Search::solveRootVCF(bool pondering, const TimeControls& tc) {
+  rootVCFWinLoc = Board::NULL_LOC;
+#ifdef USE_VCF
+  if(searchParams.rootVCFNumThreads <= 0 || rootHistory.rules.maxMoves != 0 || rootHistory.isGameFinished)
+    return;
+
+  double maxTime = searchParams.rootVCFMaxTime;
+  if(!pondering && !tc.isEffectivelyUnlimitedTime()) {
+    double tcMin;
+    double tcRec;
+    double tcMax;
+    tc.getTime(rootBoard,rootHistory,searchParams.lagBuffer,tcMin,tcRec,tcMax);
+    maxTime = std::min(maxTime, 0.25 * tcRec);
+  }
+  if(!(maxTime > 0.0))
+    return;
+
+  ClockTimer timer;
+  uint8_t res;
+  uint16_t loc;
+  VCFsolver::runParallel(
+    rootBoard, rootHistory.rules, rootPla, res, loc,
+    searchParams.rootVCFNumThreads, (uint64_t)searchParams.rootVCFMaxNodes, maxTime
+  );
+  if(res == 1 && rootBoard.isOnBoard(loc) && rootHistory.isLegal(rootBoard,loc,rootPla)) {
+    rootVCFWinLoc = loc;
+    if(logger != NULL)
+      logger->write(
+        "Root VCF found for " + PlayerIO::playerToString(rootPla) + " at " + Location::toString(loc,rootBoard) +
+        " in " + Global::doubleToString(timer.getSeconds()) + "s"
+      );
+  }
+#else
+  (void)pondering;
+  (void)tc;
+#endif
+}
+
 double Search::getPatternBonus(Hash128 patternBonusHash, Player prevMovePla) const {
   if(patternBonusTable == NULL || prevMovePla != plaThatSearchIsFor)
     return 0;
@@ -1,5 +1,6 @@
 #include "../search/search.h"
 
+#include "../core/numa.h"
 #include "../search/searchnode.h"
 
 //------------------------
@@ -7,6 +8,8 @@
 //------------------------
 
 static void threadTaskLoop(Search* search, int threadIdx) {
+  //Before doing any work, so that what this thread allocates is local to the node it runs on
+  NUMA::maybePinCurrentThread(threadIdx);
   while(true) {
     std::function<void(int)>* task;
     bool suc = search->threadTasks[threadIdx-1].waitPop(task);
@@ -74,6 +77,10 @@ void Search::respawnThreads() {
   spawnThreadsIfNeeded();
 }
 
+void Search::releaseThreads() {
+  killThreads();
+}
+
 void Search::performTaskWithThreads(std::function<void(int)>* task, int capThreads) {
   spawnThreadsIfNeeded();
   int numAdditionalThreadsToUse = std::min(capThreads-1, numAdditionalThreadsToUseForTasks());
@@ -22,6 +22,7 @@ void Search::computeRootNNEvaluation(NNResultBuf& nnResultBuf) {
   nnInputParams.useForbiddenInput = searchParams.useForbiddenInput;
   nnInputParams.suppressPass = searchParams.suppressPass;
   nnInputParams.fourAttackPolicyReduce = searchParams.fourAttackPolicyReduce;
+  nnInputParams.priority = std::max(searchParams.nnEvalPriority - 1, (int)NNPriority::HIGH);
 
   if(searchParams.playoutDoublingAdvantage != 0) {
     Player playoutDoublingAdvantagePla = getPlayoutDoublingAdvantagePla();
@@ -68,6 +69,8 @@ bool Search::initNodeNNOutput(
   nnInputParams.useForbiddenInput = searchParams.useForbiddenInput;
   nnInputParams.suppressPass = searchParams.suppressPass;
   nnInputParams.fourAttackPolicyReduce = searchParams.fourAttackPolicyReduce;
+  //The root is evaluated once per search and gates all the rest of it, so it gets ahead of the search's other evals
+  nnInputParams.priority = isRoot ? std::max(searchParams.nnEvalPriority - 1, (int)NNPriority::HIGH) : searchParams.nnEvalPriority;
 
   if(searchParams.playoutDoublingAdvantage != 0) {
     Player playoutDoublingAdvantagePla = getPlayoutDoublingAdvantagePla();
@@ -74,6 +74,43 @@ MoreNodeStats::~MoreNodeStats()
 //----------------------------------------------------------------------------------------
 
 
+ChildValueSums::ChildValueSums()
+  :weightSum(0.0),
+   winLossValueSum(0.0),
+   noResultValueSum(0.0),
+   utilitySum(0.0),
+   utilitySqSum(0.0),
+   weightSqSum(0.0),
+   selectionPolicyProbMass(0.0),
+   selectionWeightSum(0.0)
+{}
+ChildValueSums::~ChildValueSums()
+{}
+
+void ChildValueSums::addDelta(const ChildValueSums& newSums, const ChildValueSums& oldSums) {
+  weightSum += newSums.weightSum - oldSums.weightSum;
+  winLossValueSum += newSums.winLossValueSum - oldSums.winLossValueSum;
+  noResultValueSum += newSums.noResultValueSum - oldSums.noResultValueSum;
+  utilitySum += newSums.utilitySum - oldSums.utilitySum;
+  utilitySqSum += newSums.utilitySqSum - oldSums.utilitySqSum;
+  weightSqSum += newSums.weightSqSum - oldSums.weightSqSum;
+  selectionPolicyProbMass += newSums.selectionPolicyProbMass - oldSums.selectionPolicyProbMass;
+  selectionWeightSum += newSums.selectionWeightSum - oldSums.selectionWeightSum;
+}
+
+IncrementalBackupStats::IncrementalBackupStats()
+  :childSums(),
+   totalSums(),
+   selectionMaxChildWeight(0.0),
+   visitsSinceFullRecompute(0)
+{}
+IncrementalBackupStats::~IncrementalBackupStats()
+{}
+
+
+//----------------------------------------------------------------------------------------
+
+
 SearchChildPointer::SearchChildPointer():
   data(NULL),
   edgeVisits(0),
@@ -166,6 +203,13 @@ SearchNode::SearchNode(Player pla, bool fnt, uint32_t mIdx)
    children2(NULL),
    stats(),
    virtualLosses(0),
+   selectionCacheVisits(-1),
+   selectionPolicyProbMassVisited(0.0),
+   selectionTotalChildWeight(0.0),
+   selectionMaxChildWeight(0.0),
+   selectionUtilityStdevFactor(1.0),
+   incrementalBackup(),
+   collapsedSums(),
    lastSubtreeValueBiasDeltaSum(0.0),
    lastSubtreeValueBiasWeight(0.0),
    subtreeValueBiasTableEntry(),
@@ -187,6 +231,13 @@ SearchNode::SearchNode(const SearchNode& other, bool fnt, bool copySubtreeValueB
    children2(NULL),
    stats(other.stats),
    virtualLosses(other.virtualLosses.load(std::memory_order_acquire)),
+   selectionCacheVisits(-1),
+   selectionPolicyProbMassVisited(0.0),
+   selectionTotalChildWeight(0.0),
+   selectionMaxChildWeight(0.0),
+   selectionUtilityStdevFactor(1.0),
+   incrementalBackup(),
+   collapsedSums(other.collapsedSums == nullptr ? nullptr : std::make_unique<ChildValueSums>(*(other.collapsedSums))),
    lastSubtreeValueBiasDeltaSum(0.0),
    lastSubtreeValueBiasWeight(0.0),
    subtreeValueBiasTableEntry(),
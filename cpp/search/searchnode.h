@@ -101,6 +101,45 @@ struct MoreNodeStats {
 };
 
 
+//Weighted sums contributed by one child (or by all children) to a node's stats in recomputeNodeStats,
+//before the node's own evaluation is added in.
+struct ChildValueSums {
+  double weightSum;
+  double winLossValueSum;
+  double noResultValueSum;
+  double utilitySum;
+  double utilitySqSum;
+  double weightSqSum;
+  //Same aggregates as selectBestChildToDescend uses, see SearchNode::selectionPolicyProbMassVisited
+  double selectionPolicyProbMass;
+  double selectionWeightSum;
+
+  ChildValueSums();
+  ~ChildValueSums();
+
+  ChildValueSums(const ChildValueSums&) = default;
+  ChildValueSums& operator=(const ChildValueSums&) = default;
+
+  void addDelta(const ChildValueSums& newSums, const ChildValueSums& oldSums);
+};
+
+//Running sums for SearchParams::useIncrementalBackup.
+//Only ever accessed by the thread currently performing recomputeNodeStats for the node, which is exclusive
+//due to the dirtyCounter mechanism in updateStatsAfterPlayout.
+struct IncrementalBackupStats {
+  std::vector<ChildValueSums> childSums; //Indexed the same as the children of the node
+  ChildValueSums totalSums;
+  double selectionMaxChildWeight;
+  int64_t visitsSinceFullRecompute;
+
+  IncrementalBackupStats();
+  ~IncrementalBackupStats();
+
+  IncrementalBackupStats(const IncrementalBackupStats&) = delete;
+  IncrementalBackupStats& operator=(const IncrementalBackupStats&) = delete;
+};
+
+
 struct SearchChildPointer {
 private:
   std::atomic<SearchNode*> data;
@@ -217,6 +256,23 @@ struct SearchNode {
   NodeStatsAtomic stats;
   std::atomic<int32_t> virtualLosses;
 
+  //Aggregates over the children for selectBestChildToDescend, refreshed by recomputeNodeStats in the same pass over the
+  //children that computes stats, so that selection does not need its own pass. Protected under statsLock for writing.
+  //selectionCacheVisits is the value of stats.visits when these were written, -1 while they are being written. Readers check it
+  //before and after reading them and fall back to a full pass on mismatch. Unused with graph search.
+  std::atomic<int64_t> selectionCacheVisits;
+  std::atomic<double> selectionPolicyProbMassVisited;
+  std::atomic<double> selectionTotalChildWeight;
+  std::atomic<double> selectionMaxChildWeight;
+  std::atomic<double> selectionUtilityStdevFactor;
+
+  //Allocated by recomputeNodeStats only if SearchParams::useIncrementalBackup is in effect for this node.
+  std::unique_ptr<IncrementalBackupStats> incrementalBackup;
+  //Set by Search::pruneTreeToNodeCount when it drops the children of this node, to the stats the node had then, as sums.
+  //Stands in for the node's own evaluation in recomputeNodeStats from then on, like a frozen child summarizing the
+  //dropped subtree, so that regrown children add to those stats rather than replace them.
+  std::unique_ptr<ChildValueSums> collapsedSums;
+
   //Protected under the entryLock in subtreeValueBiasTableEntry
   //Used only if subtreeValueBiasTableEntry is not nullptr.
   //During search, subtreeValueBiasTableEntry itself is set upon creation of the node and remains constant
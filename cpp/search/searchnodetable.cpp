@@ -5,7 +5,10 @@
 
 SearchNodeTable::SearchNodeTable(int numShardsPowerOfTwo) {
   numShards = (uint32_t)1 << numShardsPowerOfTwo;
+  numNodes.store(0,std::memory_order_relaxed);
   mutexPool = new MutexPool(numShards);
+  //Not interleaved, the shard maps themselves are small and the nodes are allocated by whichever search thread
+  //creates them, so with numaPinThreads they land on that thread's node by first touch.
   entries.resize(numShards);
 }
 SearchNodeTable::~SearchNodeTable() {
@@ -13,6 +13,8 @@ struct SearchNodeTable {
   std::vector<std::map<Hash128,SearchNode*>> entries;
   MutexPool* mutexPool;
   uint32_t numShards;
+  //Number of nodes in entries, maintained by whoever inserts or deletes them
+  std::atomic<int64_t> numNodes;
 
   SearchNodeTable(int numShardsPowerOfTwo);
   ~SearchNodeTable();
@@ -1,5 +1,7 @@
 #include "../search/searchparams.h"
 
+#include "../neuralnet/nninputs.h"
+
 using nlohmann::json;
 
 //Default search params
@@ -27,6 +29,8 @@ SearchParams::SearchParams()
    useNoisePruning(false),
    noisePruneUtilityScale(0.15),
    noisePruningCap(1e50),
+   useIncrementalBackup(false),
+   incrementalBackupFullRecomputeInterval(64),
    useUncertainty(false),
    uncertaintyCoeff(0.2),
    uncertaintyExponent(1.0),
@@ -61,6 +65,7 @@ SearchParams::SearchParams()
    playoutDoublingAdvantagePla(C_EMPTY),
    avoidRepeatedPatternUtility(0.0),
    nnPolicyTemperature(1.0f),
+   nnEvalPriority(NNPriority::NORMAL),
    subtreeValueBiasFactor(0.0),
    subtreeValueBiasTableNumShards(65536),
    subtreeValueBiasFreeProp(0.8),
@@ -75,6 +80,8 @@ SearchParams::SearchParams()
    maxVisitsPondering(((int64_t)1) << 50),
    maxPlayoutsPondering(((int64_t)1) << 50),
    maxTimePondering(1.0e20),
+   maxTreeNodesPondering(((int64_t)1) << 50),
+   maxTreeBytesPondering(1.0e20),
    lagBuffer(0.0),
    treeReuseCarryOverTimeFactor(0.0),
    overallocateTimeFactor(1.0),
@@ -84,6 +91,11 @@ SearchParams::SearchParams()
    obviousMovesTimeFactor(1.0),
    obviousMovesPolicyEntropyTolerance(0.30),
    obviousMovesPolicySurpriseTolerance(0.15),
+   useTacticalTimeManagement(false),
+   tacticalTimeBankFactor(0.5),
+   rootVCFNumThreads(0),
+   rootVCFMaxNodes(2000000),
+   rootVCFMaxTime(1.0),
    futileVisitsThreshold(0.0),
    humanSLProfile(),
    humanSLCpuctExploration(1.0),
@@ -136,6 +148,8 @@ bool SearchParams::operator==(const SearchParams& other) const {
     useNoisePruning == other.useNoisePruning &&
     noisePruneUtilityScale == other.noisePruneUtilityScale &&
     noisePruningCap == other.noisePruningCap &&
+    useIncrementalBackup == other.useIncrementalBackup &&
+    incrementalBackupFullRecomputeInterval == other.incrementalBackupFullRecomputeInterval &&
 
     useUncertainty == other.useUncertainty &&
     uncertaintyCoeff == other.uncertaintyCoeff &&
@@ -182,6 +196,7 @@ bool SearchParams::operator==(const SearchParams& other) const {
     avoidRepeatedPatternUtility == other.avoidRepeatedPatternUtility &&
 
     nnPolicyTemperature == other.nnPolicyTemperature &&
+    nnEvalPriority == other.nnEvalPriority &&
 
     subtreeValueBiasFactor == other.subtreeValueBiasFactor &&
     subtreeValueBiasTableNumShards == other.subtreeValueBiasTableNumShards &&
@@ -200,6 +215,8 @@ bool SearchParams::operator==(const SearchParams& other) const {
     maxVisitsPondering == other.maxVisitsPondering &&
     maxPlayoutsPondering == other.maxPlayoutsPondering &&
     maxTimePondering == other.maxTimePondering &&
+    maxTreeNodesPondering == other.maxTreeNodesPondering &&
+    maxTreeBytesPondering == other.maxTreeBytesPondering &&
 
     lagBuffer == other.lagBuffer &&
 
@@ -211,6 +228,11 @@ bool SearchParams::operator==(const SearchParams& other) const {
     obviousMovesTimeFactor == other.obviousMovesTimeFactor &&
     obviousMovesPolicyEntropyTolerance == other.obviousMovesPolicyEntropyTolerance &&
     obviousMovesPolicySurpriseTolerance == other.obviousMovesPolicySurpriseTolerance &&
+    useTacticalTimeManagement == other.useTacticalTimeManagement &&
+    tacticalTimeBankFactor == other.tacticalTimeBankFactor &&
+    rootVCFNumThreads == other.rootVCFNumThreads &&
+    rootVCFMaxNodes == other.rootVCFMaxNodes &&
+    rootVCFMaxTime == other.rootVCFMaxTime &&
 
     futileVisitsThreshold == other.futileVisitsThreshold &&
 
@@ -341,6 +363,8 @@ json SearchParams::changeableParametersToJson() const {
   ret["useNoisePruning"] = useNoisePruning;
   ret["noisePruneUtilityScale"] = noisePruneUtilityScale;
   ret["noisePruningCap"] = noisePruningCap;
+  ret["useIncrementalBackup"] = useIncrementalBackup;
+  ret["incrementalBackupFullRecomputeInterval"] = incrementalBackupFullRecomputeInterval;
 
   ret["useUncertainty"] = useUncertainty;
   ret["uncertaintyCoeff"] = uncertaintyCoeff;
@@ -389,6 +413,7 @@ json SearchParams::changeableParametersToJson() const {
   // ret["avoidRepeatedPatternUtility"] = avoidRepeatedPatternUtility;
 
   ret["nnPolicyTemperature"] = nnPolicyTemperature;
+  ret["nnEvalPriority"] = NNPriority::toString(nnEvalPriority);
   // Special handling in GTP
   // ret["antiMirror"] = antiMirror;
 
@@ -409,6 +434,8 @@ json SearchParams::changeableParametersToJson() const {
   ret["maxVisitsPondering"] = maxVisitsPondering;
   ret["maxPlayoutsPondering"] = maxPlayoutsPondering;
   ret["maxTimePondering"] = maxTimePondering;
+  ret["maxTreeNodesPondering"] = maxTreeNodesPondering;
+  ret["maxTreeBytesPondering"] = maxTreeBytesPondering;
 
   ret["lagBuffer"] = lagBuffer;
 
@@ -420,6 +447,11 @@ json SearchParams::changeableParametersToJson() const {
   ret["obviousMovesTimeFactor"] = obviousMovesTimeFactor;
   ret["obviousMovesPolicyEntropyTolerance"] = obviousMovesPolicyEntropyTolerance;
   ret["obviousMovesPolicySurpriseTolerance"] = obviousMovesPolicySurpriseTolerance;
+  ret["useTacticalTimeManagement"] = useTacticalTimeManagement;
+  ret["tacticalTimeBankFactor"] = tacticalTimeBankFactor;
+  ret["rootVCFNumThreads"] = rootVCFNumThreads;
+  ret["rootVCFMaxNodes"] = rootVCFMaxNodes;
+  ret["rootVCFMaxTime"] = rootVCFMaxTime;
 
   ret["futileVisitsThreshold"] = futileVisitsThreshold;
 
@@ -468,6 +500,8 @@ void SearchParams::printParams(std::ostream& out) const {
   PRINTPARAM(useNoisePruning);
   PRINTPARAM(noisePruneUtilityScale);
   PRINTPARAM(noisePruningCap);
+  PRINTPARAM(useIncrementalBackup);
+  PRINTPARAM(incrementalBackupFullRecomputeInterval);
 
 
   PRINTPARAM(useUncertainty);
@@ -517,6 +551,7 @@ void SearchParams::printParams(std::ostream& out) const {
   PRINTPARAM(avoidRepeatedPatternUtility);
 
   PRINTPARAM(nnPolicyTemperature);
+  PRINTPARAM(nnEvalPriority);
   //PRINTPARAM(antiMirror);
 
   //PRINTPARAM(ignorePreRootHistory);
@@ -542,6 +577,8 @@ void SearchParams::printParams(std::ostream& out) const {
   PRINTPARAM(maxVisitsPondering);
   PRINTPARAM(maxPlayoutsPondering);
   PRINTPARAM(maxTimePondering);
+  PRINTPARAM(maxTreeNodesPondering);
+  PRINTPARAM(maxTreeBytesPondering);
 
 
   PRINTPARAM(lagBuffer);
@@ -555,6 +592,11 @@ void SearchParams::printParams(std::ostream& out) const {
   PRINTPARAM(obviousMovesTimeFactor);
   PRINTPARAM(obviousMovesPolicyEntropyTolerance);
   PRINTPARAM(obviousMovesPolicySurpriseTolerance);
+  PRINTPARAM(useTacticalTimeManagement);
+  PRINTPARAM(tacticalTimeBankFactor);
+  PRINTPARAM(rootVCFNumThreads);
+  PRINTPARAM(rootVCFMaxNodes);
+  PRINTPARAM(rootVCFMaxTime);
 
   PRINTPARAM(futileVisitsThreshold);
 
@@ -36,6 +36,8 @@ struct SearchParams {
   bool useNoisePruning; //For computation of value, prune out weight that greatly exceeds what is justified by policy prior
   double noisePruneUtilityScale; //The scale of the utility difference at which useNoisePruning has effect
   double noisePruningCap; //Maximum amount of weight that noisePruning can remove
+  bool useIncrementalBackup; //Back up playouts into non-root nodes by the delta of the changed child, where the above parameters allow it
+  int incrementalBackupFullRecomputeInterval; //If useIncrementalBackup, still recompute a node from all children every this many visits
 
   //Uncertainty weighting
   bool useUncertainty; //Weight visits by uncertainty
@@ -95,6 +97,7 @@ struct SearchParams {
   double avoidRepeatedPatternUtility; //Have the root player avoid repeating similar shapes, penalizing this much utility per instance.
 
   float nnPolicyTemperature; //Scale neural net policy probabilities by this temperature, applies everywhere in the tree
+  int nnEvalPriority; //NNPriority of this search's neural net evals in a shared evaluator, one higher for the root node
   /*
   bool antiMirror;        // Enable anti-mirroring logic
 
@@ -126,6 +129,9 @@ struct SearchParams {
   int64_t maxVisitsPondering;
   int64_t maxPlayoutsPondering;
   double maxTimePondering;
+  //When pondering, prune low-visit subtrees whenever the tree grows beyond this many nodes or roughly this many bytes
+  int64_t maxTreeNodesPondering;
+  double maxTreeBytesPondering;
 
   //Amount of time to reserve for lag when using a time control
   double lagBuffer;
@@ -139,6 +145,11 @@ struct SearchParams {
   double obviousMovesTimeFactor; //Think up to this factor longer on obvious moves, weighted by obviousness
   double obviousMovesPolicyEntropyTolerance; //What entropy does the policy need to be at most to be (1/e) obvious?
   double obviousMovesPolicySurpriseTolerance; //What logits of surprise does the search result need to be at most to be (1/e) obvious?
+  bool useTacticalTimeManagement; //Under time controls, move as fast as allowed if the root move is forced or proven (five, only defence, VCF)
+  double tacticalTimeBankFactor; //Proportion of the time saved by useTacticalTimeManagement to add to later moves, in byo-yomi overtime only
+  int rootVCFNumThreads; //Threads for a deeper VCF search of the root before each search, 0 to disable
+  int64_t rootVCFMaxNodes; //Total node limit of that VCF search
+  double rootVCFMaxTime; //Time limit of that VCF search, in seconds
 
   double futileVisitsThreshold; //If a move would not be able to match this proportion of the max visits move in the time or visit or playout cap remaining, prune it.
   //int64_t finishGameSearchDelayMicroseconds; //Avoid running "too fast" at the end of the game, to cost less CPU
@@ -1,6 +1,7 @@
 #include "../search/search.h"
 
 #include "../search/searchnode.h"
+#include "../game/gamelogic.h"
 
 //------------------------
 #include "../core/using.h"
@@ -34,6 +35,32 @@ double Search::computeUpperBoundVisitsLeftDueToTime(
   return ceil(proportionOfTimeThoughtLeft * rootVisits + searchParams.numThreads-1);
 }
 
+//Whether the move at the root is determined before searching at all - we have a five, a winning four or VCF, or there is only
+//a single move that doesn't lose immediately. In all these cases the nn policy is masked down to that one move anyways.
+bool Search::computeRootTacticallyDecided() const {
+  if(rootVCFWinLoc != Board::NULL_LOC)
+    return true;
+  GameLogic::ResultsBeforeNN resultsBeforeNN;
+  resultsBeforeNN.init(rootBoard, rootHistory, rootPla);
+  return resultsBeforeNN.myOnlyLoc != Board::NULL_LOC || resultsBeforeNN.myDefenceLocs.size() == 1;
+}
+
+//Whether time saved on tactically decided moves may be banked for later moves. Only in byo-yomi overtime with one move per
+//period, where time not used in a period is otherwise lost. With main time left (absolute, Fischer, gomocup timeout_match) the
+//saved time stays on the clock and getTime already spreads it over later moves, and with a per-move limit (gomocup
+//timeout_turn) there is nothing to spend it from.
+static bool canBankTacticalTime(const TimeControls& tc) {
+  return !tc.inTimePerMove && tc.inOvertime && tc.numStonesPerPeriod <= 1;
+}
+
+//Called at the end of a search under time controls, with the time it took.
+void Search::updateTacticalTimeBank(double timeSearched) {
+  if(rootTacticallyDecided)
+    tacticalTimeBank += searchParams.tacticalTimeBankFactor * std::max(0.0, tacticalTimeSavedThisSearch - timeSearched);
+  else
+    tacticalTimeBank = std::max(0.0, tacticalTimeBank - tacticalTimeBankSpentThisSearch);
+}
+
 double Search::recomputeSearchTimeLimit(
   const TimeControls& tc, double timeUsed, double searchFactor, int64_t rootVisits
 ) {
@@ -80,6 +107,20 @@ double Search::recomputeSearchTimeLimit(
     }
   }
 
+  bool canBank = canBankTacticalTime(tc);
+  if(!canBank)
+    tacticalTimeBank = 0.0;
+  if(rootTacticallyDecided) {
+    //Nothing to find by searching a forced or proven move, so stop as soon as we can and save the time for later.
+    tacticalTimeSavedThisSearch = canBank ? std::min(tcRec, tcMax) : 0.0;
+    return tcMin;
+  }
+  //Spend time saved on earlier tactically decided moves, at most doubling what we would otherwise plan.
+  if(tacticalTimeBank > 0.0) {
+    tacticalTimeBankSpentThisSearch = std::min(tacticalTimeBank, tcRec);
+    tcRec += tacticalTimeBankSpentThisSearch;
+  }
+
   if(tcRec > 1e-20) {
     double remainingTimeNeeded = tcRec - effectiveSearchTimeCarriedOver;
     double remainingTimeNeededFactor = remainingTimeNeeded/tcRec;
@@ -102,7 +102,8 @@ double Search::computeWeightFromNNOutput(const NNOutput* nnOutput) const {
 }
 
 
-void Search::updateStatsAfterPlayout(SearchNode& node, SearchThread& thread, bool isRoot) {
+//changedChildIdx is the index of the child the playout went through, or -1 if unknown.
+void Search::updateStatsAfterPlayout(SearchNode& node, SearchThread& thread, bool isRoot, int changedChildIdx) {
   //The thread that grabs a 0 from this peforms the recomputation of stats.
   int32_t oldDirtyCounter = node.dirtyCounter.fetch_add(1,std::memory_order_acq_rel);
   assert(oldDirtyCounter >= 0);
@@ -112,7 +113,9 @@ void Search::updateStatsAfterPlayout(SearchNode& node, SearchThread& thread, boo
   int32_t numVisitsCompleted = 1;
   while(true) {
     //Perform update
-    recomputeNodeStats(node,thread,numVisitsCompleted,isRoot);
+    recomputeNodeStats(node,thread,numVisitsCompleted,isRoot,changedChildIdx);
+    //Any further visits are those of other threads, through children we don't know.
+    changedChildIdx = -1;
     //Now attempt to undo the counter
     oldDirtyCounter = node.dirtyCounter.fetch_add(-numVisitsCompleted,std::memory_order_acq_rel);
     int32_t newDirtyCounter = oldDirtyCounter - numVisitsCompleted;
@@ -127,10 +130,181 @@ void Search::updateStatsAfterPlayout(SearchNode& node, SearchThread& thread, boo
   }
 }
 
+//Incremental backup is only equivalent to the full recomputation when children are weighted purely by their own weight,
+//without value-dependent reweighting, and when the node's own evaluation doesn't depend on the children.
+bool Search::canBackupIncrementally(bool isRoot) const {
+  return
+    searchParams.useIncrementalBackup &&
+    !isRoot &&
+    searchParams.valueWeightExponent == 0 &&
+    !searchParams.useNoisePruning &&
+    searchParams.subtreeValueBiasFactor == 0;
+}
+
+//What a single child contributes to the sums in recomputeNodeStats, assuming canBackupIncrementally.
+void Search::computeChildValueSums(const SearchChildPointer& childPointer, const NNOutput* nnOutput, ChildValueSums& ret) const {
+  ret = ChildValueSums();
+  const SearchNode* child = childPointer.getIfAllocated();
+  if(child == NULL)
+    return;
+
+  Loc moveLoc = childPointer.getMoveLocRelaxed();
+  int64_t edgeVisits = childPointer.getEdgeVisits();
+  NodeStats stats = NodeStats(child->stats);
+  double childWeight = stats.getChildWeight(edgeVisits);
+
+#ifdef QUANTIZED_OUTPUT
+  float policyProb = nnOutput->getPolicyProbMaybeNoised(getPos(moveLoc));
+#else
+  float policyProb = nnOutput->getPolicyProbsMaybeNoised()[getPos(moveLoc)];
+#endif
+  if(policyProb >= 0 && !(moveLoc == Board::PASS_LOC && searchParams.suppressPass)) {
+    ret.selectionPolicyProbMass = policyProb;
+    ret.selectionWeightSum = childWeight;
+  }
+
+  if(stats.visits <= 0 || stats.weightSum <= 0.0 || edgeVisits <= 0)
+    return;
+
+  double weightScaling = childWeight / stats.weightSum;
+  ret.weightSum = childWeight;
+  ret.winLossValueSum = childWeight * stats.winLossValueAvg;
+  ret.noResultValueSum = childWeight * stats.noResultValueAvg;
+  ret.utilitySum = childWeight * stats.utilityAvg;
+  ret.utilitySqSum = childWeight * stats.utilitySqAvg;
+  ret.weightSqSum = weightScaling * weightScaling * stats.weightSqSum;
+}
+
+//Update the stats of a node given that only the child at changedChildIdx changed since the last recomputation.
+//Returns false without doing anything if that can't be done and a full recomputation is needed instead.
+bool Search::maybeRecomputeNodeStatsIncrementally(SearchNode& node, int32_t numVisitsToAdd, int changedChildIdx) {
+  IncrementalBackupStats* incPtr = node.incrementalBackup.get();
+  if(incPtr == NULL || changedChildIdx < 0)
+    return false;
+  IncrementalBackupStats& inc = *incPtr;
+  //Periodically resum everything to pick up changes to other children through transpositions and to bound floating point drift.
+  if(inc.visitsSinceFullRecompute >= searchParams.incrementalBackupFullRecomputeInterval)
+    return false;
+
+  ConstSearchNodeChildrenReference children = node.getChildren();
+  if(changedChildIdx >= children.getCapacity())
+    return false;
+  const SearchChildPointer& childPointer = children[changedChildIdx];
+  if(childPointer.getIfAllocated() == NULL)
+    return false;
+
+  const NNOutput* nnOutput = node.getNNOutput();
+  assert(nnOutput != NULL);
+
+  if((size_t)changedChildIdx >= inc.childSums.size())
+    inc.childSums.resize(changedChildIdx+1);
+  ChildValueSums newChildSums;
+  computeChildValueSums(childPointer, nnOutput, newChildSums);
+  inc.totalSums.addDelta(newChildSums, inc.childSums[changedChildIdx]);
+  inc.childSums[changedChildIdx] = newChildSums;
+  //Only used at the root, which never backs up incrementally, so an upper bound is fine.
+  if(newChildSums.selectionWeightSum > inc.selectionMaxChildWeight)
+    inc.selectionMaxChildWeight = newChildSums.selectionWeightSum;
+  inc.visitsSinceFullRecompute += numVisitsToAdd;
+
+#ifndef NDEBUG
+  //With a single thread and no transpositions, no other child can have changed, so the sums should match a full sweep.
+  if(searchParams.numThreads <= 1 && !searchParams.useGraphSearch && humanEvaluator == NULL) {
+    ChildValueSums fullSums;
+    for(int i = 0; i<children.getCapacity(); i++) {
+      if(children[i].getIfAllocated() == NULL)
+        break;
+      ChildValueSums sums;
+      computeChildValueSums(children[i], nnOutput, sums);
+      fullSums.addDelta(sums, ChildValueSums());
+    }
+    assert(std::fabs(fullSums.weightSum - inc.totalSums.weightSum) <= 1e-6 * (1.0 + fullSums.weightSum));
+    assert(std::fabs(fullSums.utilitySum - inc.totalSums.utilitySum) <= 1e-6 * (1.0 + fullSums.weightSum));
+    assert(std::fabs(fullSums.winLossValueSum - inc.totalSums.winLossValueSum) <= 1e-6 * (1.0 + fullSums.weightSum));
+  }
+#endif
+
+  //Also add in the direct evaluation of this node, or what stands in for it, see SearchNode::collapsedSums.
+  ChildValueSums sums = inc.totalSums;
+  if(node.collapsedSums != nullptr) {
+    const ChildValueSums& collapsed = *(node.collapsedSums);
+    sums.winLossValueSum += collapsed.winLossValueSum;
+    sums.noResultValueSum += collapsed.noResultValueSum;
+    sums.utilitySum += collapsed.utilitySum;
+    sums.utilitySqSum += collapsed.utilitySqSum;
+    sums.weightSqSum += collapsed.weightSqSum;
+    sums.weightSum += collapsed.weightSum;
+  }
+  else {
+    double winProb = (double)nnOutput->whiteWinProb;
+    double lossProb = (double)nnOutput->whiteLossProb;
+    double noResultProb = (double)nnOutput->whiteNoResultProb;
+    double utility = getResultUtility(winProb-lossProb, noResultProb);
+    double weight = computeWeightFromNNOutput(nnOutput);
+    sums.winLossValueSum += (winProb - lossProb) * weight;
+    sums.noResultValueSum += noResultProb * weight;
+    sums.utilitySum += utility * weight;
+    sums.utilitySqSum += utility * utility * weight;
+    sums.weightSqSum += weight * weight;
+    sums.weightSum += weight;
+  }
+
+  storeNodeStatsFromSums(node, numVisitsToAdd, sums, inc.selectionMaxChildWeight);
+  return true;
+}
+
+//Finalize and store the stats of a node given the sums over its children plus its own evaluation.
+void Search::storeNodeStatsFromSums(SearchNode& node, int32_t numVisitsToAdd, const ChildValueSums& sums, double selectionMaxChildWeight) {
+  double weightSum = sums.weightSum;
+  double weightSqSum = sums.weightSqSum;
+  double winLossValueAvg = sums.winLossValueSum / weightSum;
+  double noResultValueAvg = sums.noResultValueSum / weightSum;
+  double utilityAvg = sums.utilitySum / weightSum;
+  double utilitySqAvg = sums.utilitySqSum / weightSum;
+
+  double oldUtilityAvg = utilityAvg;
+  utilityAvg += getPatternBonus(node.patternBonusHash,getOpp(node.nextPla));
+  utilitySqAvg = utilitySqAvg + (utilityAvg * utilityAvg - oldUtilityAvg * oldUtilityAvg);
+
+  //TODO statslock may be unnecessary now with the dirtyCounter mechanism?
+  while(node.statsLock.test_and_set(std::memory_order_acquire));
+  node.stats.winLossValueAvg.store(winLossValueAvg,std::memory_order_release);
+  node.stats.noResultValueAvg.store(noResultValueAvg,std::memory_order_release);
+  node.stats.utilityAvg.store(utilityAvg,std::memory_order_release);
+  node.stats.utilitySqAvg.store(utilitySqAvg,std::memory_order_release);
+  node.stats.weightSqSum.store(weightSqSum,std::memory_order_release);
+  node.stats.weightSum.store(weightSum,std::memory_order_release);
+  int64_t newVisits = node.stats.visits.fetch_add(numVisitsToAdd,std::memory_order_release) + numVisitsToAdd;
+  //Invalidated while the aggregates are written, readers don't take the stats lock and check it again afterwards
+  node.selectionCacheVisits.store(-1,std::memory_order_release);
+  node.selectionPolicyProbMassVisited.store(sums.selectionPolicyProbMass,std::memory_order_release);
+  node.selectionTotalChildWeight.store(sums.selectionWeightSum,std::memory_order_release);
+  node.selectionMaxChildWeight.store(selectionMaxChildWeight,std::memory_order_release);
+  node.selectionUtilityStdevFactor.store(getUtilityStdevFactor(newVisits,weightSum,utilityAvg,utilitySqAvg),std::memory_order_release);
+  node.selectionCacheVisits.store(newVisits,std::memory_order_release);
+  node.statsLock.clear(std::memory_order_release);
+}
+
 //Recompute all the stats of this node based on its children, except its visits and virtual losses, which are not child-dependent and
 //are updated in the manner specified.
+//changedChildIdx, if nonnegative, is the only child known to have changed since the last recomputation, which enables incremental backup.
 //Assumes this node has an nnOutput
-void Search::recomputeNodeStats(SearchNode& node, SearchThread& thread, int numVisitsToAdd, bool isRoot) {
+void Search::recomputeNodeStats(SearchNode& node, SearchThread& thread, int numVisitsToAdd, bool isRoot, int changedChildIdx) {
+  //If set, the running sums for incremental backup are rebuilt along the way, see computeChildValueSums
+  IncrementalBackupStats* inc = NULL;
+  if(canBackupIncrementally(isRoot)) {
+    if(numVisitsToAdd == 1 && maybeRecomputeNodeStatsIncrementally(node, numVisitsToAdd, changedChildIdx))
+      return;
+    if(node.incrementalBackup == nullptr)
+      node.incrementalBackup = std::make_unique<IncrementalBackupStats>();
+    inc = node.incrementalBackup.get();
+    inc->childSums.clear();
+    inc->totalSums = ChildValueSums();
+    inc->visitsSinceFullRecompute = 0;
+  }
+  else if(node.incrementalBackup != nullptr)
+    node.incrementalBackup.reset();
+
   //Find all children and compute weighting of the children based on their values
   vector<MoreNodeStats>& statsBuf = thread.statsBuf;
   int numGoodChildren = 0;
@@ -138,6 +312,17 @@ void Search::recomputeNodeStats(SearchNode& node, SearchThread& thread, int numV
   ConstSearchNodeChildrenReference children = node.getChildren();
   int childrenCapacity = children.getCapacity();
   double origTotalChildWeight = 0.0;
+
+  //Same aggregates that selectBestChildToDescend would compute, cached in the node for it.
+  const NNOutput* selectionNNOutput = node.getNNOutput();
+  assert(selectionNNOutput != NULL);
+#ifndef QUANTIZED_OUTPUT
+  const float* selectionPolicyProbs = selectionNNOutput->getPolicyProbsMaybeNoised();
+#endif
+  double selectionPolicyProbMassVisited = 0.0;
+  double selectionTotalChildWeight = 0.0;
+  double selectionMaxChildWeight = 0.0;
+
   for(int i = 0; i<childrenCapacity; i++) {
     const SearchChildPointer& childPointer = children[i];
     const SearchNode* child = childPointer.getIfAllocated();
@@ -149,8 +334,29 @@ void Search::recomputeNodeStats(SearchNode& node, SearchThread& thread, int numV
     int64_t edgeVisits = childPointer.getEdgeVisits();
     stats.stats = NodeStats(child->stats);
 
-    if(stats.stats.visits <= 0 || stats.stats.weightSum <= 0.0 || edgeVisits <= 0)
+#ifdef QUANTIZED_OUTPUT
+    float selectionPolicyProb = selectionNNOutput->getPolicyProbMaybeNoised(getPos(moveLoc));
+#else
+    float selectionPolicyProb = selectionPolicyProbs[getPos(moveLoc)];
+#endif
+    ChildValueSums childSums;
+    if(selectionPolicyProb >= 0 && !(moveLoc == Board::PASS_LOC && searchParams.suppressPass)) {
+      double selectionChildWeight = stats.stats.getChildWeight(edgeVisits);
+      selectionPolicyProbMassVisited += selectionPolicyProb;
+      selectionTotalChildWeight += selectionChildWeight;
+      if(selectionChildWeight > selectionMaxChildWeight)
+        selectionMaxChildWeight = selectionChildWeight;
+      childSums.selectionPolicyProbMass = selectionPolicyProb;
+      childSums.selectionWeightSum = selectionChildWeight;
+    }
+
+    if(stats.stats.visits <= 0 || stats.stats.weightSum <= 0.0 || edgeVisits <= 0) {
+      if(inc != NULL) {
+        inc->totalSums.addDelta(childSums, ChildValueSums());
+        inc->childSums.push_back(childSums);
+      }
       continue;
+    }
 
     double childUtility = stats.stats.utilityAvg;
     stats.selfUtility = node.nextPla == P_WHITE ? childUtility : -childUtility;
@@ -159,7 +365,22 @@ void Search::recomputeNodeStats(SearchNode& node, SearchThread& thread, int numV
 
     origTotalChildWeight += stats.weightAdjusted;
     numGoodChildren++;
+
+    //Incremental backup implies no reweighting of children below, so this is also what the child adds to the sums there
+    if(inc != NULL) {
+      double weightScaling = stats.weightAdjusted / stats.stats.weightSum;
+      childSums.weightSum = stats.weightAdjusted;
+      childSums.winLossValueSum = stats.weightAdjusted * stats.stats.winLossValueAvg;
+      childSums.noResultValueSum = stats.weightAdjusted * stats.stats.noResultValueAvg;
+      childSums.utilitySum = stats.weightAdjusted * stats.stats.utilityAvg;
+      childSums.utilitySqSum = stats.weightAdjusted * stats.stats.utilitySqAvg;
+      childSums.weightSqSum = weightScaling * weightScaling * stats.stats.weightSqSum;
+      inc->totalSums.addDelta(childSums, ChildValueSums());
+      inc->childSums.push_back(childSums);
+    }
   }
+  if(inc != NULL)
+    inc->selectionMaxChildWeight = selectionMaxChildWeight;
 
   //Always tracks the sum of statsBuf[i].weightAdjusted across the children.
   double currentTotalChildWeight = origTotalChildWeight;
@@ -220,8 +441,18 @@ void Search::recomputeNodeStats(SearchNode& node, SearchThread& thread, int numV
     weightSqSum += weightScaling * weightScaling * stats.weightSqSum;
   }
 
-  //Also add in the direct evaluation of this node.
-  {
+  //Also add in the direct evaluation of this node, or what stands in for it, see SearchNode::collapsedSums.
+  //Its contribution to the subtree value bias table was frozen along with it.
+  if(node.collapsedSums != nullptr) {
+    const ChildValueSums& collapsed = *(node.collapsedSums);
+    winLossValueSum += collapsed.winLossValueSum;
+    noResultValueSum += collapsed.noResultValueSum;
+    utilitySum += collapsed.utilitySum;
+    utilitySqSum += collapsed.utilitySqSum;
+    weightSqSum += collapsed.weightSqSum;
+    weightSum += collapsed.weightSum;
+  }
+  else {
     const NNOutput* nnOutput = node.getNNOutput();
     assert(nnOutput != NULL);
     double winProb = (double)nnOutput->whiteWinProb;
@@ -276,25 +507,16 @@ void Search::recomputeNodeStats(SearchNode& node, SearchThread& thread, int numV
     weightSum += weight;
   }
 
-  double winLossValueAvg = winLossValueSum / weightSum;
-  double noResultValueAvg = noResultValueSum / weightSum;
-  double utilityAvg = utilitySum / weightSum;
-  double utilitySqAvg = utilitySqSum / weightSum;
-
-  double oldUtilityAvg = utilityAvg;
-  utilityAvg += getPatternBonus(node.patternBonusHash,getOpp(node.nextPla));
-  utilitySqAvg = utilitySqAvg + (utilityAvg * utilityAvg - oldUtilityAvg * oldUtilityAvg);
-
-  //TODO statslock may be unnecessary now with the dirtyCounter mechanism?
-  while(node.statsLock.test_and_set(std::memory_order_acquire));
-  node.stats.winLossValueAvg.store(winLossValueAvg,std::memory_order_release);
-  node.stats.noResultValueAvg.store(noResultValueAvg,std::memory_order_release);
-  node.stats.utilityAvg.store(utilityAvg,std::memory_order_release);
-  node.stats.utilitySqAvg.store(utilitySqAvg,std::memory_order_release);
-  node.stats.weightSqSum.store(weightSqSum,std::memory_order_release);
-  node.stats.weightSum.store(weightSum,std::memory_order_release);
-  node.stats.visits.fetch_add(numVisitsToAdd,std::memory_order_release);
-  node.statsLock.clear(std::memory_order_release);
+  ChildValueSums sums;
+  sums.weightSum = weightSum;
+  sums.winLossValueSum = winLossValueSum;
+  sums.noResultValueSum = noResultValueSum;
+  sums.utilitySum = utilitySum;
+  sums.utilitySqSum = utilitySqSum;
+  sums.weightSqSum = weightSqSum;
+  sums.selectionPolicyProbMass = selectionPolicyProbMassVisited;
+  sums.selectionWeightSum = selectionTotalChildWeight;
+  storeNodeStatsFromSums(node, numVisitsToAdd, sums, selectionMaxChildWeight);
 }
 
 void Search::downweightBadChildrenAndNormalizeWeight(
@@ -17,7 +17,8 @@ TimeControls::TimeControls()
    numPeriodsLeftIncludingCurrent(0),
    numStonesLeftInPeriod(0),
    timeLeftInPeriod(0.0),
-   inTimePerMove(false)
+   inTimePerMove(false),
+   gomocupMatchTime(false)
 {}
 
 TimeControls::~TimeControls()
@@ -128,6 +129,8 @@ std::string TimeControls::toDebugString(const Board& board, const BoardHistory&
     out << " numStonesLeftInPeriod " << numStonesLeftInPeriod;
   if(timeLeftInPeriod != 0)
     out << " timeLeftInPeriod " << timeLeftInPeriod;
+  if(gomocupMatchTime)
+    out << " gomocupMatchTime";
 
   double minTime;
   double recommendedTime;
@@ -169,6 +172,8 @@ std::string TimeControls::toDebugString() const {
     out << "numStonesLeftInPeriod " << numStonesLeftInPeriod;
   if(timeLeftInPeriod != 0)
     out << "timeLeftInPeriod " << timeLeftInPeriod;
+  if(gomocupMatchTime)
+    out << "gomocupMatchTime";
   return out.str();
 }
 
@@ -202,7 +207,16 @@ void TimeControls::getTime(const Board& board, const BoardHistory& hist, double
   double approxTurnsLeftAbsolute;
   double approxTurnsLeftIncrement; //Turns left in which we plan to spend our main time
   double approxTurnsLeftByoYomi;   //Turns left in which we plan to spend our main time
-  {
+  if(gomocupMatchTime) {
+    //Gomoku games are much shorter than go games and rarely fill the board, around 40-60 stones on 15x15 is typical,
+    //so plan for somewhat longer than that and always keep enough time for a long tactical endgame.
+    double typicalGameLength = 0.30 * boardArea + 20.0;
+    double minApproxTurnsLeft = 0.08 * boardArea + 12.0;
+    approxTurnsLeftAbsolute = std::max(typicalGameLength - numStonesOnBoard, minApproxTurnsLeft) * 0.5;
+    approxTurnsLeftIncrement = approxTurnsLeftAbsolute;
+    approxTurnsLeftByoYomi = approxTurnsLeftAbsolute;
+  }
+  else {
     double typicalGameLengthToAllowForAbsolute = 0.95 * boardArea + 20.0;
     double typicalGameLengthToAllowForIncrement = 0.75 * boardArea + 15.0;
     double typicalGameLengthToAllowForByoYomi = 0.50 * boardArea + 10.0;
@@ -30,6 +30,8 @@ struct TimeControls {
   int numStonesLeftInPeriod;
   double timeLeftInPeriod;
   bool inTimePerMove;
+  //Budget main time by the typical length of a gomoku game rather than of a go game, as for gomocup timeout_match
+  bool gomocupMatchTime;
 
   //Construct a TimeControls with unlimited main time and otherwise zero initialized.
   TimeControls();
@@ -46,6 +46,7 @@ namespace Tests {
 
   //testsearchnonn.cpp
   void runNNLessSearchTests();
+  void runIncrementalBackupTests();
   //testsearch.cpp
   void runSearchTests(const std::string& modelFile, bool inputsNHWC, bool cudaNHWC, int symmetry, bool useFP16);
   //testsearchv3.cpp
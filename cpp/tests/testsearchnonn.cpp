@@ -0,0 +1,128 @@
+#include "../tests/tests.h"
+
+#include "../neuralnet/nneval.h"
+#include "../search/search.h"
+#include "../search/searchnode.h"
+
+//------------------------
+#include "../core/using.h"
+//------------------------
+
+//Evaluations are random, but the same sequence for the same seed, so with one search thread and one nn server thread
+//two searches of the same position get the same evaluations as long as their trees stay the same.
+static NNEvaluator* startNNLessEval(Logger& logger, const string& seed, int boardLen) {
+  NNEvaluator* nnEval = new NNEvaluator(
+    "nnless",
+    "/dev/null",
+    "",
+    &logger,
+    8,
+    boardLen,
+    boardLen,
+    false,
+    false,
+    16,
+    12,
+    0,
+    16,
+    true,
+    "",
+    "",
+    false,
+    1,
+    enabled_t::False,
+    enabled_t::False,
+    1,
+    {-1},
+    seed,
+    false,
+    0
+  );
+  nnEval->spawnServerThreads();
+  return nnEval;
+}
+
+static void checkSameStats(const SearchNode* a, const SearchNode* b, const string& path) {
+  NodeStats sa(a->stats);
+  NodeStats sb(b->stats);
+  auto near = [&](double x, double y) {
+    return std::fabs(x - y) <= 1e-9 * (1.0 + std::fabs(x) + std::fabs(y));
+  };
+  if(sa.visits != sb.visits || !near(sa.weightSum, sb.weightSum) || !near(sa.weightSqSum, sb.weightSqSum) ||
+     !near(sa.utilityAvg, sb.utilityAvg) || !near(sa.utilitySqAvg, sb.utilitySqAvg) || !near(sa.winLossValueAvg, sb.winLossValueAvg)) {
+    cout << "Incremental backup mismatch at " << path << ": visits " << sa.visits << " " << sb.visits
+         << " weightSum " << sa.weightSum << " " << sb.weightSum << " utilityAvg " << sa.utilityAvg << " " << sb.utilityAvg << endl;
+    testAssert(false);
+  }
+
+  ConstSearchNodeChildrenReference childrenA = a->getChildren();
+  ConstSearchNodeChildrenReference childrenB = b->getChildren();
+  for(int i = 0; i<childrenA.getCapacity(); i++) {
+    const SearchNode* childA = childrenA[i].getIfAllocated();
+    const SearchNode* childB = i < childrenB.getCapacity() ? childrenB[i].getIfAllocated() : NULL;
+    testAssert((childA == NULL) == (childB == NULL));
+    if(childA == NULL)
+      break;
+    testAssert(childrenA[i].getMoveLoc() == childrenB[i].getMoveLoc());
+    testAssert(childrenA[i].getEdgeVisits() == childrenB[i].getEdgeVisits());
+    checkSameStats(childA, childB, path + " " + Global::intToString(i));
+  }
+}
+
+void Tests::runIncrementalBackupTests() {
+  cout << "Running incremental backup tests" << endl;
+  const int boardLen = 15;
+  Logger logger(nullptr, false, false, false, false);
+
+  Rules rules;
+  rules.basicRule = Rules::BASICRULE_STANDARD;
+  vector<vector<Loc>> openings = {
+    {},
+    {Location::getLoc(7,7,boardLen), Location::getLoc(8,8,boardLen), Location::getLoc(8,6,boardLen)},
+    {
+      Location::getLoc(7,7,boardLen), Location::getLoc(7,8,boardLen), Location::getLoc(8,7,boardLen),
+      Location::getLoc(6,7,boardLen), Location::getLoc(8,8,boardLen), Location::getLoc(9,9,boardLen)
+    },
+  };
+
+  for(size_t openingIdx = 0; openingIdx<openings.size(); openingIdx++) {
+    Board board(boardLen,boardLen);
+    BoardHistory hist(board,P_BLACK,rules);
+    Player pla = P_BLACK;
+    for(Loc loc: openings[openingIdx]) {
+      hist.makeBoardMoveAssumeLegal(board,loc,pla);
+      pla = getOpp(pla);
+    }
+
+    //Everything that would rule out incremental backup is off, and no periodic full recomputation
+    SearchParams params;
+    params.numThreads = 1;
+    params.maxVisits = 1500;
+    params.useGraphSearch = false;
+    params.valueWeightExponent = 0.0;
+    params.useNoisePruning = false;
+    params.subtreeValueBiasFactor = 0.0;
+    params.incrementalBackupFullRecomputeInterval = 1 << 30;
+
+    string seed = "incremental backup test " + Global::uint64ToString(openingIdx);
+    vector<NNEvaluator*> nnEvals;
+    vector<Search*> searches;
+    for(int useIncrementalBackup = 0; useIncrementalBackup<2; useIncrementalBackup++) {
+      params.useIncrementalBackup = useIncrementalBackup != 0;
+      NNEvaluator* nnEval = startNNLessEval(logger, seed, boardLen);
+      Search* search = new Search(params, nnEval, &logger, seed);
+      search->setPosition(pla,board,hist);
+      search->runWholeSearch(pla);
+      nnEvals.push_back(nnEval);
+      searches.push_back(search);
+    }
+
+    testAssert(searches[0]->getRootVisits() == params.maxVisits);
+    checkSameStats(searches[0]->rootNode, searches[1]->rootNode, "root");
+
+    for(Search* search: searches)
+      delete search;
+    for(NNEvaluator* nnEval: nnEvals)
+      delete nnEval;
+  }
+}
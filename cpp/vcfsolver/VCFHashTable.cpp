@@ -1,5 +1,7 @@
 #include "VCFHashTable.h"
 
+#include "../core/numa.h"
+
 using namespace std;
 
 
@@ -17,6 +19,10 @@ VCFHashTable::~VCFHashTable() {
   delete mutexPool;
 }
 
+void VCFHashTable::interleaveMemory() {
+  NUMA::interleave(entries, tableSize * sizeof(Entry));
+}
+
 int64_t VCFHashTable::get(Hash128 hash) {
   //Free ret BEFORE locking, to avoid any expensive operations while locked.
 
@@ -27,10 +33,17 @@ int64_t VCFHashTable::get(Hash128 hash) {
   std::mutex& mutex = mutexPool->getMutex(mutexIdx);
 
   std::lock_guard<std::mutex> lock(mutex);
-#endif
   if (entry.hash == hash) {
     return entry.result;
   }
+#else
+  //No locks, the first half of the hash is stored xored with the result, so an entry torn by concurrent writes doesn't match
+  Hash128 entryHash = entry.hash;
+  int64_t result = entry.result;
+  if (entryHash.hash1 == hash.hash1 && (entryHash.hash0 ^ (uint64_t)result) == hash.hash0) {
+    return result;
+  }
+#endif
   return 0;
 }
 
@@ -52,7 +65,11 @@ void VCFHashTable::set(Hash128 hash, int64_t result) {
     std::lock_guard<std::mutex> lock(mutex);
 #endif
     //Perform a swap, to avoid any expensive free under the mutex.
+#ifndef FORGOMOCUP
     entry.hash = hash;
+#else
+    entry.hash = Hash128(hash.hash0 ^ (uint64_t)result, hash.hash1);
+#endif
     entry.result = result;
   }
 
@@ -48,4 +48,8 @@ public:
   //These are thread-safe. For get, ret will be set to nullptr upon a failure to find.
   int64_t get(Hash128 hash);
   void set(Hash128 hash, int64_t result);
+
+  //Spread the entries over the NUMA nodes, see NUMA::interleave. The table is static and built before the config is read,
+  //so this is called separately at startup.
+  void interleaveMemory();
 };
@@ -2,6 +2,8 @@
 #include <random>
 #include <iostream>
 #include <cassert>
+#include <memory>
+#include <thread>
 using namespace std;
 
 const Hash128 VCFsolver::zob_plaWhite = Hash128(0xb6f9e465597a77eeULL, 0xf1d583d960a4ce7fULL);
@@ -20,6 +22,9 @@ uint64_t VCFsolver::totalAborted;
 uint64_t VCFsolver::totalSolved;
 uint64_t VCFsolver::totalnodenum;
 
+VCFsolver::CallStats VCFsolver::callStats[VCFsolver::NUM_STATS_BUCKETS];
+double VCFsolver::minHitRateToSolve = 0.0;
+
 inline bool resultNotSure(int32_t result)
 {
   return result <= 0 && result != -10000;
@@ -213,10 +218,291 @@ void VCFsolver::addNeighborSix(int y, int x, uint8_t pla,int factor)
     stonecount[t][y1][x1] += factor;
 }
 
+void VCFsolver::run(const Board& board, const Rules& rules, uint8_t pla, uint8_t& res, uint16_t& loc)
+{
+#ifndef NOVCF
+  //Below this many solves in a bucket the hit rate isn't trusted, and of the skipped solves, still do one in this many to keep it up to date
+  static const int64_t MIN_SOLVES_FOR_HIT_RATE = 2000;
+  static const int64_t SKIPPED_SOLVE_PERIOD = 16;
+
+  CallStats& stats = callStats[std::min(board.numStonesOnBoard() / STATS_BUCKET_STONES, NUM_STATS_BUCKETS - 1)];
+  int64_t callIdx = stats.numCalls.fetch_add(1, std::memory_order_relaxed);
+
+  //Consecutive calls in one thread are mostly for positions a move or two apart, one solver for each side to solve for
+  thread_local std::unique_ptr<VCFsolver> solvers[2];
+  std::unique_ptr<VCFsolver>& solver = solvers[pla == C_BLACK ? 0 : 1];
+  if (solver == nullptr || !(solver->rules == rules))
+    solver.reset(new VCFsolver(rules));
+  if (zob_board[0][0][0].hash0 == 0)cout << "VCFSolver::zob_board not init";
+  int32_t rootResult = solver->setBoardIncremental(board, pla);
+  //A VCF needs a first four, so a five-window with three stones of pla and none of the opponent, which findRootThreats
+  //lists from the incrementally kept stone counts, unless the opponent's four forces a defence first
+  if (rootResult == 0 && solver->threeCount == 0 && solver->oppFourPos == -1)
+  {
+    stats.numFiltered.fetch_add(1, std::memory_order_relaxed);
+    res = 2;
+    loc = Board::NULL_LOC;
+    return;
+  }
+  if (minHitRateToSolve > 0 && callIdx % SKIPPED_SOLVE_PERIOD != 0)
+  {
+    int64_t numSolved = stats.numSolved.load(std::memory_order_relaxed);
+    int64_t numWins = stats.numWins.load(std::memory_order_relaxed);
+    if (numSolved >= MIN_SOLVES_FOR_HIT_RATE && numWins < minHitRateToSolve * numSolved)
+    {
+      stats.numSkipped.fetch_add(1, std::memory_order_relaxed);
+      res = 3;
+      loc = Board::NULL_LOC;
+      return;
+    }
+  }
+
+  solver->solveFromRoot(rootResult, res, loc);
+  stats.numSolved.fetch_add(1, std::memory_order_relaxed);
+  if (res == 1)
+    stats.numWins.fetch_add(1, std::memory_order_relaxed);
+  else if (res == 3)
+    stats.numAborted.fetch_add(1, std::memory_order_relaxed);
+#else
+  res = 2;
+  loc = Board::NULL_LOC;
+#endif
+}
+
+string VCFsolver::getStatsString()
+{
+  string s = "VCF solver calls by stones on board (calls, no VCF possible, skipped, solved, found, hit the node limit):";
+  for (int i = 0; i < NUM_STATS_BUCKETS; i++)
+  {
+    const CallStats& stats = callStats[i];
+    int64_t numCalls = stats.numCalls.load(std::memory_order_relaxed);
+    if (numCalls == 0)continue;
+    int64_t numSolved = stats.numSolved.load(std::memory_order_relaxed);
+    int64_t numWins = stats.numWins.load(std::memory_order_relaxed);
+    string bucketName = i == NUM_STATS_BUCKETS - 1 ?
+      Global::intToString(i * STATS_BUCKET_STONES) + "+" :
+      Global::intToString(i * STATS_BUCKET_STONES) + "-" + Global::intToString((i + 1) * STATS_BUCKET_STONES - 1);
+    s += "\n" + bucketName + ": " +
+      Global::int64ToString(numCalls) + " " +
+      Global::int64ToString(stats.numFiltered.load(std::memory_order_relaxed)) + " " +
+      Global::int64ToString(stats.numSkipped.load(std::memory_order_relaxed)) + " " +
+      Global::int64ToString(numSolved) + " " +
+      Global::int64ToString(numWins) + " " +
+      Global::int64ToString(stats.numAborted.load(std::memory_order_relaxed)) +
+      " hit rate " + Global::doubleToString(numSolved > 0 ? (double)numWins / numSolved : 0.0);
+  }
+  return s;
+}
+
+void VCFsolver::runParallel(
+  const Board& board, const Rules& rules, uint8_t pla, uint8_t& res, uint16_t& loc,
+  int numThreads, uint64_t maxNodes, double maxTime)
+{
+#ifndef NOVCF
+  if (zob_board[0][0][0].hash0 == 0)cout << "VCFSolver::zob_board not init";
+  SharedBudget budget;
+  budget.stop.store(false, std::memory_order_relaxed);
+  budget.numNodes.store(0, std::memory_order_relaxed);
+  budget.maxNodes = maxNodes;
+  budget.maxTime = maxTime;
+
+  vector<unique_ptr<VCFsolver>> solvers;
+  solvers.emplace_back(new VCFsolver(rules));
+  VCFsolver& rootSolver = *solvers[0];
+  int32_t result = rootSolver.setBoard(board, pla);
+  if (resultNotSure(result))
+  {
+    auto resultAndLoc = hashtable.get(rootSolver.boardhash);
+    result = resultAndLoc & 0xFFFFFFFF;
+    rootSolver.rootresultpos = resultAndLoc >> 32;
+  }
+  bool anyAborted = false;
+  if (resultNotSure(result))
+  {
+    //A forced defence or a single three at the root leaves nothing to split
+    if (rootSolver.oppFourPos != -1 || rootSolver.threeCount < 2)
+      numThreads = 1;
+    numThreads = std::max(1, std::min(numThreads, (int)rootSolver.threeCount));
+    for (int i = 1; i < numThreads; i++)
+    {
+      solvers.emplace_back(new VCFsolver(rules));
+      solvers[i]->setBoard(board, pla);
+    }
+    vector<int32_t> results(numThreads);
+    auto runWorker = [&](int i)
+    {
+      VCFsolver& solver = *solvers[i];
+      solver.budget = &budget;
+      solver.maxNodes = maxNodes;
+      solver.rootSplitIdx = i;
+      solver.rootSplitNum = numThreads;
+      results[i] = solver.solveIter(true);
+    };
+    vector<std::thread> threads;
+    for (int i = 1; i < numThreads; i++)
+      threads.push_back(std::thread(runWorker, i));
+    runWorker(0);
+    for (size_t i = 0; i < threads.size(); i++)
+      threads[i].join();
+
+    //Any win is a win, otherwise there is no VCF only if every worker finished its moves
+    int bestIdx = 0;
+    for (int i = 0; i < numThreads; i++)
+    {
+      if (results[i] > results[bestIdx])bestIdx = i;
+      if (solvers[i]->aborted)anyAborted = true;
+    }
+    result = results[bestIdx];
+    rootSolver.rootresultpos = solvers[bestIdx]->rootresultpos;
+    if (result > 0 || !anyAborted)
+      hashtable.set(rootSolver.boardhash, (int64_t(rootSolver.rootresultpos) << 32) | int64_t(result));
+  }
+  if (result > 0)res = 1;
+  else if (result == -10000 && !anyAborted)res = 2;
+  else res = 3;
+  int x = rootSolver.rootresultpos % sz, y = rootSolver.rootresultpos / sz;
+  loc = x + 1 + (y + 1) * (rootSolver.xsize + 1);
+#else
+  (void)numThreads;
+  (void)maxNodes;
+  (void)maxTime;
+  res = 2;
+  loc = Board::NULL_LOC;
+#endif
+}
+
+bool VCFsolver::findDefence(const Board& board, const Rules& rules, uint8_t pla, vector<Loc>& defenceLocs)
+{
+  defenceLocs.clear();
+#ifndef NOVCF
+  //The verification below solves a VCF for every candidate, more than this and it's cheaper to let the search find the defence
+  static const int MAX_CANDIDATES = 64;
+
+  uint8_t opp = getOpp(pla);
+  uint8_t res;
+  uint16_t loc;
+  VCFsolver attacker(rules);
+  attacker.solve(board, opp, res, loc);
+  if (res != 1)
+    return false;
+
+  //A move can only refute the VCF if it is near the line: in a window of one of its fours, within reach of the defence points
+  //(pla's forced stones could make a four together with it, or in renju, it could change whether a defence point is forbidden),
+  //or a four of pla itself
+  bool isCandidate[sz][sz];
+  for (int y = 0; y < sz; y++)
+    for (int x = 0; x < sz; x++)
+      isCandidate[y][x] = false;
+  auto markLines = [&](int x, int y, int dist)
+  {
+    static const int dirs[4][2] = { {1,0},{0,1},{1,1},{1,-1} };
+    for (int d = 0; d < 4; d++)
+      for (int i = -dist; i <= dist; i++)
+      {
+        int x1 = x + i * dirs[d][0], y1 = y + i * dirs[d][1];
+        if (x1 >= 0 && x1 < attacker.xsize && y1 >= 0 && y1 < attacker.ysize)
+          isCandidate[y1][x1] = true;
+      }
+  };
+
+  //Walk the line, the solution of each position is in the hashtable unless it was overwritten since
+  for (int step = 0; ; step++)
+  {
+    int pos = attacker.rootresultpos;
+    if (step >= 2 * sz * sz || pos < 0 || attacker.board[pos / sz][pos % sz] != C_EM)
+      return false;
+    int x = pos % sz, y = pos / sz;
+    markLines(x, y, 4);
+    int32_t result = attacker.play(x, y, C_MY, true);
+    if (result > 0)
+    {
+      //Double four or live four, the five points are all within these lines
+      markLines(x, y, 5);
+      break;
+    }
+    if (result < 0)
+      return false;
+    uint32_t defendPos = attacker.findDefendPosOfFive(y, x);
+    if (defendPos == uint32_t(-1))
+      return false;
+    int dx = defendPos % sz, dy = defendPos / sz;
+    markLines(dx, dy, 5);
+    result = attacker.play(dx, dy, C_OPP, true);
+    if (result > 0)
+      break;//The forced defence is forbidden
+    if (result < 0)
+      return false;
+
+    if (attacker.oppFourPos != -1)
+      attacker.rootresultpos = attacker.oppFourPos;
+    else
+    {
+      auto resultAndLoc = hashtable.get(attacker.boardhash);
+      if (int32_t(resultAndLoc & 0xFFFFFFFF) > 0)
+        attacker.rootresultpos = resultAndLoc >> 32;
+      else
+      {
+        attacker.bestmovenum = 10000;
+        attacker.nodenum = 0;
+        attacker.aborted = false;
+        if (attacker.solveIter(true) <= 0)
+          return false;
+      }
+    }
+  }
+
+  VCFsolver defender(rules);
+  defender.setBoard(board, pla);
+  for (uint64_t i = 0; i < defender.threeCount; i++)
+  {
+    int64_t threeEntry = defender.threes[i];
+    uint16_t pos1 = threeEntry & 0xFFFF, pos2 = (threeEntry >> 16) & 0xFFFF;
+    isCandidate[pos1 / sz][pos1 % sz] = true;
+    isCandidate[pos2 / sz][pos2 % sz] = true;
+  }
+
+  vector<Loc> candidates;
+  for (int y = 0; y < defender.ysize; y++)
+    for (int x = 0; x < defender.xsize; x++)
+    {
+      if (!isCandidate[y][x] || defender.board[y][x] != C_EM)continue;
+      if (rules.basicRule == Rules::BASICRULE_RENJU && defender.forbiddenSide == C_MY && defender.isForbiddenMove(y, x))continue;
+      candidates.push_back(Location::getLoc(x, y, defender.xsize));
+    }
+  if (candidates.size() > MAX_CANDIDATES)
+    return false;
+
+  //Solved directly rather than through run, so that these don't count towards callStats or get skipped by minHitRateToSolve.
+  //Consecutive candidates differ by two stones, which setBoardIncremental applies cheaply.
+  VCFsolver checker(rules);
+  Board copy(board);
+  for (size_t i = 0; i < candidates.size(); i++)
+  {
+    copy.setStone(candidates[i], pla);
+    checker.solve(copy, opp, res, loc);
+    copy.setStone(candidates[i], C_EMPTY);
+    //Unknown counts as a defence, it is only allowed moves that are being narrowed down
+    if (res != 1)
+      defenceLocs.push_back(candidates[i]);
+  }
+  return true;
+#else
+  (void)board;
+  (void)rules;
+  (void)pla;
+  return false;
+#endif
+}
+
 void VCFsolver::solve(const Board& kataboard, uint8_t pla, uint8_t& res, uint16_t& loc)
 {
   if (zob_board[0][0][0].hash0 == 0)cout << "VCFSolver::zob_board not init";
-  int32_t result=setBoard(kataboard,pla); 
+  int32_t result=setBoardIncremental(kataboard,pla); 
+  solveFromRoot(result, res, loc);
+}
+
+void VCFsolver::solveFromRoot(int32_t result, uint8_t& res, uint16_t& loc)
+{
   if (resultNotSure(result))
   {
     auto resultAndLoc = hashtable.get(boardhash);
@@ -224,7 +510,7 @@ void VCFsolver::solve(const Board& kataboard, uint8_t pla, uint8_t& res, uint16_
     rootresultpos = resultAndLoc >> 32;
   }
   if(resultNotSure(result))result=solveIter(true);
-  if (nodenum >= MAXNODE && result <= 0)res = 3;
+  if (aborted && result <= 0)res = 3;
   else if (result > 0)res = 1;
   else if (result == -10000)res = 2;
   else
@@ -244,7 +530,7 @@ void VCFsolver::solve(const Board& kataboard, uint8_t pla, uint8_t& res, uint16_
   //  cout << "nodenum " << nodenum << "  res " << int(res) << endl;
  //   print();
   }
-  if (nodenum >= MAXNODE)
+  if (aborted)
   {
     totalAborted++;
 //    cout << "Hit vcf upper bound: nodenum=" << nodenum << endl;
@@ -312,19 +598,18 @@ int32_t VCFsolver::setBoard(const Board& b, uint8_t pla)
 {
   xsize = b.x_size;
   ysize = b.y_size;
+  myColor = pla;
+  hasRootBoard = true;
   if(rules.basicRule==Rules::BASICRULE_RENJU)
     forbiddenSide = (pla == C_BLACK) ? C_MY : C_OPP;//If you are a black chess, it is 1, otherwise it is 2
   movenum = 0;
   bestmovenum = 10000;
   nodenum = 0;
-  threeCount = 0;
-  oppFourPos = -1;
+  aborted = false;
   boardhash = Rules::ZOBRIST_BASIC_RULE_HASH[rules.basicRule];
   if (pla == C_WHITE)boardhash ^= zob_plaWhite;
   else boardhash ^= zob_plaBlack;
 
-  int32_t result = 0;
-
   //clear
   for (int i = 0; i < 4; i++)
     for (int j = 0; j < sz; j++)
@@ -419,7 +704,66 @@ int32_t VCFsolver::setBoard(const Board& b, uint8_t pla)
       oppstonecount[3][y][x] += oppcount;
     }
 
-  
+  return findRootThreats();
+}
+
+int32_t VCFsolver::setBoardIncremental(const Board& b, uint8_t pla)
+{
+  //More changed stones than this, and it is cheaper to just rebuild everything
+  static const int MAX_INCREMENTAL_CHANGES = 16;
+
+  if (!hasRootBoard || pla != myColor || b.x_size != xsize || b.y_size != ysize)
+    return setBoard(b, pla);
+
+  int numChanges = 0;
+  int16_t changedPos[MAX_INCREMENTAL_CHANGES];
+  uint8_t changedColor[MAX_INCREMENTAL_CHANGES];
+  for (int y = 0; y < ysize; y++)
+    for (int x = 0; x < xsize; x++)
+    {
+      short loc = (x + 1) + (y + 1)*(xsize + 1);
+      auto c = b.colors[loc];
+      uint8_t color = (c == 0) ? C_EM : (c == pla) ? C_MY : C_OPP;
+      if (color == rootboard[y][x])continue;
+      if (numChanges >= MAX_INCREMENTAL_CHANGES)return setBoard(b, pla);
+      changedPos[numChanges] = y * sz + x;
+      changedColor[numChanges] = color;
+      numChanges++;
+    }
+
+  for (int i = 0; i < numChanges; i++)
+  {
+    int x = changedPos[i] % sz, y = changedPos[i] / sz;
+    auto oldColor = rootboard[y][x];
+    if (oldColor != C_EM)
+    {
+      board[y][x] = C_EM;
+      boardhash ^= zob_board[oldColor - 1][y][x];
+      if (oldColor == C_MY)movenum--;
+      updateStoneCounts(x, y, oldColor, -1);
+    }
+    auto newColor = changedColor[i];
+    if (newColor != C_EM)
+    {
+      board[y][x] = newColor;
+      boardhash ^= zob_board[newColor - 1][y][x];
+      if (newColor == C_MY)movenum++;
+      updateStoneCounts(x, y, newColor, 1);
+    }
+    rootboard[y][x] = newColor;
+  }
+
+  bestmovenum = 10000;
+  nodenum = 0;
+  aborted = false;
+  return findRootThreats();
+}
+
+int32_t VCFsolver::findRootThreats()
+{
+  threeCount = 0;
+  oppFourPos = -1;
+  int32_t result = 0;
 
   for (int t = 0; t < 4; t++)
     for (int y = 0; y < ysize; y++)
@@ -809,17 +1153,21 @@ void VCFsolver::undo(int x, int y, int64_t oppFourPos1, uint64_t threeCount1, bo
   board[y][x] = 0;
 
 
+  if (updateHash) boardhash ^= zob_board[pla - 1][y][x];
+  if (pla == C_MY)movenum--;
+  updateStoneCounts(x, y, pla, -1);
+}
+
+void VCFsolver::updateStoneCounts(int x, int y, uint8_t pla, int delta)
+{
   bool isPlaForbidden_forRenju = rules.basicRule==Rules::BASICRULE_RENJU && forbiddenSide== pla; //only for renju
   if(rules.basicRule==Rules::BASICRULE_STANDARD ||
       isPlaForbidden_forRenju)
-    addNeighborSix(y, x, pla, -6);
-
-  if (updateHash) boardhash ^= zob_board[pla - 1][y][x];
+    addNeighborSix(y, x, pla, 6 * delta);
 
   //The code reuse in this place is very bad. If you want to change it, you need to change a lot.
   if (pla == C_MY)
   {
-    movenum--;
     //x
     //todo standard renju:-6 
     for (int i = 0; i < 5; i++)
@@ -827,7 +1175,7 @@ void VCFsolver::undo(int x, int y, int64_t oppFourPos1, uint64_t threeCount1, bo
       int x1 = x - i;
       if (x1 < 0)break;
       if (x1 >= xsize - 4)continue;
-      mystonecount[0][y][x1]--;
+      mystonecount[0][y][x1] += delta;
     }
     //y
     for (int i = 0; i < 5; i++)
@@ -835,7 +1183,7 @@ void VCFsolver::undo(int x, int y, int64_t oppFourPos1, uint64_t threeCount1, bo
       int y1 = y - i;
       if (y1 < 0)break;
       if (y1 >= ysize - 4)continue;
-      mystonecount[1][y1][x]--;
+      mystonecount[1][y1][x] += delta;
     }
     //+x+y
     for (int i = 0; i < 5; i++)
@@ -846,7 +1194,7 @@ void VCFsolver::undo(int x, int y, int64_t oppFourPos1, uint64_t threeCount1, bo
       if (y1 < 0)break;
       if (x1 >= xsize - 4)continue;
       if (y1 >= ysize - 4)continue;
-      mystonecount[2][y1][x1]--;
+      mystonecount[2][y1][x1] += delta;
     }
     //+x+y
     for (int i = 0; i < 5; i++)
@@ -857,7 +1205,7 @@ void VCFsolver::undo(int x, int y, int64_t oppFourPos1, uint64_t threeCount1, bo
       if (y1 >= ysize)break;
       if (x1 >= xsize - 4)continue;
       if (y1 < 4)continue;
-      mystonecount[3][y1][x1]--;
+      mystonecount[3][y1][x1] += delta;
     }
   }
   else if (pla == C_OPP)
@@ -869,7 +1217,7 @@ void VCFsolver::undo(int x, int y, int64_t oppFourPos1, uint64_t threeCount1, bo
       int x1 = x - i;
       if (x1 < 0)break;
       if (x1 >= xsize - 4)continue;
-      oppstonecount[0][y][x1]--;
+      oppstonecount[0][y][x1] += delta;
     }
     //y
     for (int i = 0; i < 5; i++)
@@ -877,7 +1225,7 @@ void VCFsolver::undo(int x, int y, int64_t oppFourPos1, uint64_t threeCount1, bo
       int y1 = y - i;
       if (y1 < 0)break;
       if (y1 >= ysize - 4)continue;
-      oppstonecount[1][y1][x]--;
+      oppstonecount[1][y1][x] += delta;
     }
     //+x+y
     for (int i = 0; i < 5; i++)
@@ -888,7 +1236,7 @@ void VCFsolver::undo(int x, int y, int64_t oppFourPos1, uint64_t threeCount1, bo
       if (y1 < 0)break;
       if (x1 >= xsize - 4)continue;
       if (y1 >= ysize - 4)continue;
-      oppstonecount[2][y1][x1]--;
+      oppstonecount[2][y1][x1] += delta;
     }
     //+x+y
     for (int i = 0; i < 5; i++)
@@ -899,7 +1247,7 @@ void VCFsolver::undo(int x, int y, int64_t oppFourPos1, uint64_t threeCount1, bo
       if (y1 >= ysize)break;
       if (x1 >= xsize - 4)continue;
       if (y1 < 4)continue;
-      oppstonecount[3][y1][x1]--;
+      oppstonecount[3][y1][x1] += delta;
     }
   }
   else
@@ -909,12 +1257,27 @@ void VCFsolver::undo(int x, int y, int64_t oppFourPos1, uint64_t threeCount1, bo
 }
 
 
+bool VCFsolver::budgetExhausted()
+{
+  uint64_t numNodes = budget->numNodes.fetch_add(256, std::memory_order_relaxed) + 256;
+  if (budget->stop.load(std::memory_order_relaxed))
+    return true;
+  if (numNodes >= budget->maxNodes || budget->timer.getSeconds() >= budget->maxTime)
+  {
+    budget->stop.store(true, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
 int32_t VCFsolver::solveIter(bool isRoot)
 {
   //Look up the hash table before calculating the stonecount after the drop, it's not here
   nodenum++;
-  if (nodenum>= MAXNODE)
+  if (budget != NULL && !aborted && (nodenum & 255) == 0)aborted = budgetExhausted();
+  if (aborted || nodenum >= maxNodes)
   {
+    aborted = true;
     return -(movenum+1);
   }
 
@@ -946,8 +1309,9 @@ int32_t VCFsolver::solveIter(bool isRoot)
       if (isRoot)rootresultpos = oppFourPos;
     }
 
-    //Save hash table
-    hashtable.set(boardhash, (int64_t(solutionPos) << 32) | int64_t(result));
+    //Save hash table. After an abort, a failure may only mean the search was cut short, so it's not worth remembering
+    if (result > 0 || !aborted)
+      hashtable.set(boardhash, (int64_t(solutionPos) << 32) | int64_t(result));
 
     return result;
   }
@@ -966,6 +1330,7 @@ int32_t VCFsolver::solveIter(bool isRoot)
     int y = threeEntry / sz;
     int x = threeEntry % sz;
 
+    if (isRoot && rootSplitNum > 1 && threeID % rootSplitNum != rootSplitIdx)continue;//Searched by another worker
     if (oppstonecount[t][y][x]%6 != 0 || mystonecount[t][y][x] != 3)continue;//This sleep three has expired
 
     auto playandcalculate = [&](uint16_t posMy, uint16_t posOpp)
@@ -1011,8 +1376,12 @@ int32_t VCFsolver::solveIter(bool isRoot)
     playandcalculate(pos2, pos1);
     if (bestresult >= 10000 - movenum - 2)break;//If a double four has been found, there is no need to consider other ways to go
   }
-  hashtable.set(boardhash, (int64_t(solutionPos) << 32) | int64_t(bestresult));
+  //With the root split, this is only the result of some of the root moves, runParallel stores the combined one.
+  //After an abort, by the budget, the time limit, or another worker finding a win, a failure may be a false negative.
+  if (!(isRoot && rootSplitNum > 1) && (bestresult > 0 || !aborted))
+    hashtable.set(boardhash, (int64_t(solutionPos) << 32) | int64_t(bestresult));
   if (isRoot)rootresultpos = solutionPos;
+  if (isRoot && budget != NULL && bestresult > 0)budget->stop.store(true, std::memory_order_relaxed);
   //cout << isRoot << " " << int(solutionPos) << endl;
   return bestresult;
 
@@ -1,9 +1,11 @@
 #pragma once
 #include <iostream>
 #include <vector>
+#include <atomic>
 #include "VCFHashTable.h"
 #include "../core/hash.h"
 #include "../core/global.h"
+#include "../core/timer.h"
 #include "../game/board.h"
 #include "../game/rules.h"
 
@@ -35,6 +37,8 @@ public:
 
   //board
   int xsize, ysize;
+  uint8_t myColor; //pla of the last setBoard
+  bool hasRootBoard; //Whether rootboard and the stone counts hold a position that later calls can be applied to incrementally
   uint8_t rootboard[sz][sz]; //board[y][x]
   uint8_t board[sz][sz]; //board[y][x]
   int32_t movenum; //
@@ -55,6 +59,21 @@ public:
   uint64_t threeCount;//
 
   uint64_t nodenum;
+  uint64_t maxNodes; //Node limit of this solver, MAXNODE unless set by runParallel
+  bool aborted; //Whether the node or time limit was hit during the current solve
+
+  //Node and time limits shared by all the workers of one runParallel call
+  struct SharedBudget {
+    std::atomic<bool> stop; //Set once a worker has found a win, or any limit is hit
+    std::atomic<uint64_t> numNodes;
+    uint64_t maxNodes;
+    double maxTime;
+    ClockTimer timer;
+  };
+  SharedBudget* budget; //NULL unless this solver is a runParallel worker
+  //At the root, this solver only tries threes with (threeID % rootSplitNum == rootSplitIdx)
+  int rootSplitIdx;
+  int rootSplitNum;
 
   //result
   int32_t rootresultpos;
@@ -67,25 +86,51 @@ public:
   static uint64_t totalSolved;
   static uint64_t totalnodenum;
 
+  //Statistics of run(), bucketed by the number of stones on the board
+  static const int NUM_STATS_BUCKETS = 8;
+  static const int STATS_BUCKET_STONES = 16;
+  struct CallStats {
+    std::atomic<int64_t> numCalls;
+    std::atomic<int64_t> numFiltered; //No VCF possible at all, the root has no three to start from
+    std::atomic<int64_t> numSkipped; //Skipped because of minHitRateToSolve
+    std::atomic<int64_t> numSolved;
+    std::atomic<int64_t> numWins;
+    std::atomic<int64_t> numAborted;
+  };
+  static CallStats callStats[NUM_STATS_BUCKETS];
+  //If the proportion of solves finding a VCF in a bucket is below this, skip most solves there and report unknown. 0 to never skip.
+  static double minHitRateToSolve;
+  static std::string getStatsString();
+
   static void init();
-  VCFsolver(const Rules rules):rules(rules){ threes.resize(4 * sz * sz); }
+  VCFsolver(const Rules rules)
+    :rules(rules),hasRootBoard(false),maxNodes(MAXNODE),aborted(false),budget(NULL),rootSplitIdx(0),rootSplitNum(1)
+  { threes.resize(4 * sz * sz); }
   void solve(const Board& kataboard, uint8_t pla,uint8_t& res,uint16_t& loc);
+  //The rest of solve, after setBoard or setBoardIncremental returned result
+  void solveFromRoot(int32_t result, uint8_t& res, uint16_t& loc);
   void print();
   void printRoot();
-  static void run(const Board& board,const Rules& rules, uint8_t pla, uint8_t& res, uint16_t& loc)
-  {
-#ifndef NOVCF
-    VCFsolver solver(rules);
-    solver.solve(board, pla, res, loc);
-#else
-    res = 2;
-    loc = Board::NULL_LOC;
-#endif
-  }
+  //Uses a solver kept per thread, so consecutive calls on nearby positions only apply the stones that changed
+  static void run(const Board& board,const Rules& rules, uint8_t pla, uint8_t& res, uint16_t& loc);
+  //For single positions that are worth more than the default node limit, such as the root of a search.
+  //The moves of the root are split between numThreads workers sharing the hashtable, which stop when any of them finds a win,
+  //or after maxNodes nodes in total or maxTime seconds. The result is stored in the hashtable, so later run calls see it too.
+  static void runParallel(
+    const Board& board, const Rules& rules, uint8_t pla, uint8_t& res, uint16_t& loc,
+    int numThreads, uint64_t maxNodes, double maxTime);
+  //If the opponent of pla has a VCF, find every move of pla that refutes it, including counter fours and, in renju, moves that
+  //change which points are forbidden. Returns false if the opponent has no proven VCF or the set couldn't be worked out.
+  static bool findDefence(const Board& board, const Rules& rules, uint8_t pla, vector<Loc>& defenceLocs);
 
 //private:
 public:
   int32_t setBoard(const Board& board, uint8_t pla);//
+  //Same as setBoard, but moves from the previous root position by adding and removing the stones that differ
+  //Falls back to setBoard if there are too many of them
+  int32_t setBoardIncremental(const Board& board, uint8_t pla);
+  int32_t findRootThreats();//Threes, fours and immediate results of the root position, from the stone counts
+  void updateStoneCounts(int x, int y, uint8_t pla, int delta);//Stone counts of the windows through (x,y), delta 1 for adding a stone, -1 for removing
 
 
   uint32_t findEmptyPos(int t, int y, int x);// pos1<<16|pos2
@@ -96,6 +141,7 @@ public:
 
 
   int32_t solveIter(bool isRoot);//
+  bool budgetExhausted();//Only for runParallel workers, counts the nodes searched since the last call
   //
   int32_t play(int x, int y, uint8_t pla,bool updateHash);
   void undo(int x, int y, int64_t oppFourPos, uint64_t threeCount, bool updateHash);